@@ -0,0 +1,479 @@
+// Web 接口压力测试
+// 在进程内启动一个 WebServer，接上合成的玩家列表、命令申请与日志缓存（不需要 MC 服务器），
+// 以给定并发对 /api/logs、/api/online、/api/requests 以及投票/上传接口发起请求，
+// 输出各接口的吞吐、延迟分位数、304 比例与服务器内存占用；给出阈值时不达标返回非零
+//
+// 用法: http_bench [--port P] [--concurrency N] [--duration S] [--threads N] [--queue N]
+//                  [--logs W] [--logs-since W] [--online W] [--requests W] [--vote W] [--upload W]
+//                  [--etag 0|1] [--players N] [--online-players N] [--log-entries N] [--log-rate L]
+//                  [--pending-requests N] [--upload-bytes B] [--min-rps R] [--max-p99-ms M]
+
+#include <command_request.h>
+#include <io/program.h>
+#include <logger.h>
+#include <metrics.h>
+#include <player_list.h>
+#include <server_manager.h>
+#include <web_server.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <httplib.h>
+
+// ============================================================================
+// 参数
+// ============================================================================
+
+struct BenchOptions {
+    int port = 18080;
+    size_t concurrency = 8;          // 客户端连接数（每个连接一个线程，保持长连接）
+    double duration = 10;            // 压测时长（秒）
+    size_t threads = 8;              // 服务端工作线程数
+    size_t queue = 32;               // 服务端等待队列上限
+
+    // 各接口的请求权重
+    double logs = 30;                // 全量 /api/logs（可缓存）
+    double logs_since = 30;          // 增量 /api/logs?since=
+    double online = 20;
+    double requests = 15;
+    double vote = 4;
+    double upload = 1;
+    bool etag = true;                // 客户端是否带 If-None-Match
+
+    size_t players = 500;            // 历史玩家数
+    size_t online_players = 50;      // 在线玩家数
+    size_t log_entries = 2000;       // 预先写入的日志条数
+    double log_rate = 20;            // 压测期间每秒新增的日志条数，使缓存持续失效
+    size_t pending_requests = 20;    // 预先创建的命令申请数
+    size_t upload_bytes = 16 * 1024; // 上传图片的大小
+
+    // 回归阈值，0 表示不检查
+    double min_rps = 0;
+    double max_p99_ms = 0;
+};
+
+static bool parse_options(int argc, char* argv[], BenchOptions& opt) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::fprintf(stderr, "缺少参数值: %s\n", arg.c_str());
+            return false;
+        }
+        const char* value = argv[++i];
+        if (arg == "--port") opt.port = std::atoi(value);
+        else if (arg == "--concurrency") opt.concurrency = std::max<size_t>(1, std::strtoull(value, nullptr, 10));
+        else if (arg == "--duration") opt.duration = std::atof(value);
+        else if (arg == "--threads") opt.threads = std::strtoull(value, nullptr, 10);
+        else if (arg == "--queue") opt.queue = std::strtoull(value, nullptr, 10);
+        else if (arg == "--logs") opt.logs = std::atof(value);
+        else if (arg == "--logs-since") opt.logs_since = std::atof(value);
+        else if (arg == "--online") opt.online = std::atof(value);
+        else if (arg == "--requests") opt.requests = std::atof(value);
+        else if (arg == "--vote") opt.vote = std::atof(value);
+        else if (arg == "--upload") opt.upload = std::atof(value);
+        else if (arg == "--etag") opt.etag = std::atoi(value) != 0;
+        else if (arg == "--players") opt.players = std::max<size_t>(1, std::strtoull(value, nullptr, 10));
+        else if (arg == "--online-players") opt.online_players = std::strtoull(value, nullptr, 10);
+        else if (arg == "--log-entries") opt.log_entries = std::strtoull(value, nullptr, 10);
+        else if (arg == "--log-rate") opt.log_rate = std::atof(value);
+        else if (arg == "--pending-requests") opt.pending_requests = std::strtoull(value, nullptr, 10);
+        else if (arg == "--upload-bytes") opt.upload_bytes = std::strtoull(value, nullptr, 10);
+        else if (arg == "--min-rps") opt.min_rps = std::atof(value);
+        else if (arg == "--max-p99-ms") opt.max_p99_ms = std::atof(value);
+        else {
+            std::fprintf(stderr, "未知参数: %s\n", arg.c_str());
+            return false;
+        }
+    }
+    opt.online_players = std::min(opt.online_players, opt.players);
+    return true;
+}
+
+// ============================================================================
+// 辅助函数
+// ============================================================================
+
+// 压测的请求种类
+enum Op { OP_LOGS, OP_LOGS_SINCE, OP_ONLINE, OP_REQUESTS, OP_VOTE, OP_UPLOAD, OP_COUNT };
+
+static const char* const OP_NAMES[OP_COUNT] = {
+    "GET /api/logs", "GET /api/logs?since", "GET /api/online", "GET /api/requests",
+    "POST vote", "POST /api/requests"
+};
+
+// 每个客户端线程各自记录，结束后合并
+struct OpStats {
+    std::vector<uint64_t> latencies_ns;
+    uint64_t not_modified = 0;   // 304
+    uint64_t errors = 0;         // 连接失败或 5xx
+    uint64_t rejected = 0;       // 4xx（重复投票、限流等）
+    uint64_t bytes = 0;          // 响应体字节数
+};
+
+static std::string player_name(size_t i) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "Player%04zu", i);
+    return buf;
+}
+
+// 读取 /proc/self/status 中的内存字段（KiB），失败返回 0
+static size_t read_status_kb(const char* field) {
+    std::ifstream in("/proc/self/status");
+    std::string line;
+    size_t len = std::strlen(field);
+    while (std::getline(in, line)) {
+        if (line.compare(0, len, field) == 0 && line.size() > len && line[len] == ':') {
+            return std::strtoull(line.c_str() + len + 1, nullptr, 10);
+        }
+    }
+    return 0;
+}
+
+// 从 {"logs":[...],"next":N,"system_next":M} 中取出某个序号，不做完整解析
+static uint64_t parse_seq(const std::string& body, const std::string& key, uint64_t fallback) {
+    size_t pos = body.rfind("\"" + key + "\":");
+    if (pos == std::string::npos) return fallback;
+    return std::strtoull(body.c_str() + pos + key.size() + 3, nullptr, 10);
+}
+
+static double percentile_ms(const std::vector<uint64_t>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t index = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1));
+    return static_cast<double>(sorted[index]) / 1e6;
+}
+
+// 在临时目录中生成玩家列表与空的封禁、禁止指令列表
+static void write_fixtures(const std::filesystem::path& dir, const BenchOptions& opt) {
+    std::ofstream players(dir / "players.list");
+    for (size_t i = 0; i < opt.players; i++) {
+        players << player_name(i) << '\n';
+    }
+    std::ofstream(dir / "banned.list");
+    std::ofstream(dir / "forbidden_commands.list");
+    std::ofstream(dir / "ops.json") << "[]";
+    std::filesystem::create_directories(dir / "web");
+    std::ofstream(dir / "web" / "index.html") << "<!doctype html><title>bench</title>";
+    std::filesystem::create_directories(dir / "uploads");
+}
+
+// ============================================================================
+// 客户端
+// ============================================================================
+
+struct ClientContext {
+    const BenchOptions& opt;
+    std::atomic<bool>& stop;
+    std::atomic<uint64_t>& next_ip;
+    const std::vector<std::string>& request_ids;
+    const std::string& image;
+};
+
+static void client_thread(ClientContext ctx, uint32_t seed, std::vector<OpStats>& stats) {
+    const BenchOptions& opt = ctx.opt;
+    httplib::Client client("127.0.0.1", opt.port);
+    client.set_keep_alive(true);
+    client.set_tcp_nodelay(true);
+    client.set_connection_timeout(5);
+    client.set_read_timeout(10);
+
+    std::mt19937 rng(seed);
+    std::discrete_distribution<int> pick_op({opt.logs, opt.logs_since, opt.online, opt.requests, opt.vote, opt.upload});
+    std::uniform_int_distribution<size_t> pick_player(0, opt.players - 1);
+
+    // 每个连接记住各可缓存接口上次的 ETag 与增量日志的位置，模拟轮询的浏览器
+    std::string etags[OP_COUNT];
+    uint64_t since = 0;
+    uint64_t system_since = 0;
+
+    while (!ctx.stop.load(std::memory_order_relaxed)) {
+        int op = pick_op(rng);
+        httplib::Headers headers;
+        if (opt.etag && !etags[op].empty()) {
+            headers.emplace("If-None-Match", etags[op]);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        httplib::Result result;
+        switch (op) {
+            case OP_LOGS:
+                result = client.Get("/api/logs", headers);
+                break;
+            case OP_LOGS_SINCE:
+                result = client.Get("/api/logs?since=" + std::to_string(since) + "&system_since=" +
+                                    std::to_string(system_since) + "&limit=200", headers);
+                break;
+            case OP_ONLINE:
+                result = client.Get("/api/online", headers);
+                break;
+            case OP_REQUESTS:
+                result = client.Get("/api/requests", headers);
+                break;
+            case OP_VOTE: {
+                // 每次投票使用不同的来源 IP，避免全部落入“已投过票”
+                uint64_t n = ctx.next_ip.fetch_add(1);
+                char ip[32];
+                std::snprintf(ip, sizeof(ip), "10.%u.%u.%u",
+                              static_cast<unsigned>((n >> 16) & 0xff), static_cast<unsigned>((n >> 8) & 0xff),
+                              static_cast<unsigned>(n & 0xff));
+                headers.emplace("X-Forwarded-For", ip);
+                const std::string& id = ctx.request_ids[n % ctx.request_ids.size()];
+                result = client.Post("/api/requests/" + id + "/vote", headers, "", "text/plain");
+                break;
+            }
+            default: {
+                httplib::UploadFormDataItems items = {
+                    { "applicant", player_name(pick_player(rng)), "", "" },
+                    { "command", "give @s minecraft:bread 1", "", "" },
+                    { "reason", "load test", "", "" },
+                    { "image", ctx.image, "bench.png", "image/png" },
+                };
+                result = client.Post("/api/requests", headers, items);
+                break;
+            }
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+
+        OpStats& s = stats[op];
+        s.latencies_ns.push_back(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+        if (!result || result->status >= 500) {
+            s.errors++;
+            continue;
+        }
+        s.bytes += result->body.size();
+        if (result->status == 304) {
+            s.not_modified++;
+        } else if (result->status >= 400) {
+            s.rejected++;
+        } else {
+            if (result->has_header("ETag")) {
+                etags[op] = result->get_header_value("ETag");
+            }
+            if (op == OP_LOGS_SINCE) {
+                since = parse_seq(result->body, "next", since);
+                system_since = parse_seq(result->body, "system_next", system_since);
+            }
+        }
+    }
+}
+
+// ============================================================================
+// 主流程
+// ============================================================================
+
+int main(int argc, char* argv[]) {
+    BenchOptions opt;
+    if (!parse_options(argc, argv, opt)) return 2;
+
+    // 投票、申请等接口会逐条输出日志，压测时只保留警告
+    dl::Logger::global().set_level(dl::LogLevel::WARN);
+    dl::Logger::global().set_passthrough(false);
+
+    char tmpl[] = "/tmp/dl-http-bench-XXXXXX";
+    if (!mkdtemp(tmpl)) {
+        std::perror("mkdtemp");
+        return 2;
+    }
+    std::filesystem::path dir(tmpl);
+    write_fixtures(dir, opt);
+
+    int status = 0;
+    {
+        dl::Program program("true");  // 只用于满足接口，不会启动
+        dl::PlayerList player_list((dir / "players.list").string(), (dir / "banned.list").string(),
+                                   (dir / "forbidden_commands.list").string(), program);
+        dl::ServerManager manager(&program, (dir / "ops.json").string(), player_list, "bench");
+
+        // 日志缓存：先让部分玩家上线，再写入聊天记录
+        uint64_t line_no = 0;
+        auto feed_chat = [&manager, &opt, &line_no]() {
+            char line[160];
+            std::snprintf(line, sizeof(line), "[12:00:00 INFO]: <%s> load test message %llu",
+                          player_name(line_no % opt.players).c_str(), static_cast<unsigned long long>(line_no));
+            line_no++;
+            manager.handle_log_line(line);
+        };
+        for (size_t i = 0; i < opt.online_players; i++) {
+            manager.handle_log_line("[12:00:00 INFO]: " + player_name(i) + " joined the game");
+        }
+        for (size_t i = 0; i < opt.log_entries; i++) {
+            feed_chat();
+        }
+
+        // 阈值设为不可达，投票不会触发执行
+        dl::CommandRequestManager request_manager((dir / "requests.dat").string(), (dir / "uploads").string(),
+                                                  static_cast<size_t>(-1),
+                                                  [](const std::string&, const std::string&) {});
+        for (size_t i = 0; i < opt.pending_requests; i++) {
+            request_manager.create_request(player_name(i % opt.players), "time set day", "bench fixture");
+        }
+        std::vector<std::string> request_ids;
+        request_manager.visit_requests([&request_ids](const dl::RequestInfo& info) {
+            request_ids.push_back(info.id);
+        });
+        if (request_ids.empty()) {
+            opt.vote = 0;
+            request_ids.push_back("none");
+        }
+
+        dl::WebServerConfig config;
+        config.port = opt.port;
+        config.web_root = (dir / "web").string();
+        config.watch_web_root = false;
+        config.upload_dir = (dir / "uploads").string();
+        config.worker_threads = opt.threads;
+        config.max_queued_connections = opt.queue;
+        config.vote_rate_per_minute = 0;  // 压测本身不受投票限流影响
+        config.trust_proxy_headers = true;  // 投票的来源 IP 通过 X-Forwarded-For 模拟
+
+        dl::WebServer web_server(config, player_list, request_manager);
+        web_server.set_get_logs_callback([&manager](uint64_t since, size_t limit, const dl::LogEntryVisitor& visit) {
+            manager.visit_logs_since(since, limit, [&manager, &visit](const dl::LogView& log) {
+                dl::LogEntry entry;
+                entry.seq = log.seq;
+                entry.time = log.time;
+                entry.type = dl::log_event_type_name(log.type);
+                entry.player = log.player;
+                entry.content = log.content;
+                entry.server = manager.name();
+                visit(entry);
+            });
+        });
+        web_server.set_logs_generation_callback([&manager]() {
+            return manager.log_generation();
+        });
+        web_server.set_player_exists_callback([&player_list](const std::string& player) {
+            return player_list.has_player(player);
+        });
+        if (!web_server.start()) {
+            std::fprintf(stderr, "WebServer 启动失败，端口 %d\n", opt.port);
+            std::filesystem::remove_all(dir);
+            return 2;
+        }
+
+        size_t rss_before = read_status_kb("VmRSS");
+        std::atomic<bool> stop{false};
+        std::atomic<uint64_t> next_ip{1};
+        std::string image(opt.upload_bytes, '\x42');
+
+        // 压测期间按固定速率追加日志（代替日志线程），并采样内存占用
+        std::atomic<size_t> rss_peak{rss_before};
+        std::thread feeder([&]() {
+            auto next = std::chrono::steady_clock::now();
+            auto interval = opt.log_rate > 0
+                ? std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / opt.log_rate))
+                : std::chrono::steady_clock::duration(std::chrono::milliseconds(100));
+            auto next_sample = next;
+            while (!stop.load()) {
+                auto now = std::chrono::steady_clock::now();
+                if (opt.log_rate > 0) {
+                    while (next <= now) {
+                        feed_chat();
+                        next += interval;
+                    }
+                }
+                if (now >= next_sample) {
+                    rss_peak = std::max(rss_peak.load(), read_status_kb("VmRSS"));
+                    next_sample = now + std::chrono::milliseconds(100);
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+        });
+
+        std::vector<std::vector<OpStats>> per_client(opt.concurrency, std::vector<OpStats>(OP_COUNT));
+        std::vector<std::thread> clients;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < opt.concurrency; i++) {
+            ClientContext ctx{opt, stop, next_ip, request_ids, image};
+            clients.emplace_back(client_thread, ctx, static_cast<uint32_t>(i + 1), std::ref(per_client[i]));
+        }
+        std::this_thread::sleep_for(std::chrono::duration<double>(opt.duration));
+        stop = true;
+        for (auto& t : clients) {
+            t.join();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        feeder.join();
+        size_t rss_after = read_status_kb("VmRSS");
+
+        // 合并各客户端的结果
+        std::vector<OpStats> totals(OP_COUNT);
+        std::vector<uint64_t> all;
+        uint64_t total_errors = 0;
+        for (auto& client_stats : per_client) {
+            for (int op = 0; op < OP_COUNT; op++) {
+                OpStats& from = client_stats[op];
+                OpStats& to = totals[op];
+                to.latencies_ns.insert(to.latencies_ns.end(), from.latencies_ns.begin(), from.latencies_ns.end());
+                to.not_modified += from.not_modified;
+                to.errors += from.errors;
+                to.rejected += from.rejected;
+                to.bytes += from.bytes;
+            }
+        }
+
+        std::printf("concurrency %zu, server threads %zu, queue %zu, etag %s, log rate %.0f/s, %.1f s\n\n",
+                    opt.concurrency, opt.threads, opt.queue, opt.etag ? "on" : "off", opt.log_rate, seconds);
+        std::printf("%-22s %9s %9s %7s %7s %6s %9s %9s %9s %9s %10s\n",
+                    "endpoint", "requests", "req/s", "304%", "4xx", "err", "p50 ms", "p90 ms", "p99 ms", "max ms", "KiB/req");
+        for (int op = 0; op < OP_COUNT; op++) {
+            OpStats& s = totals[op];
+            if (s.latencies_ns.empty()) continue;
+            std::sort(s.latencies_ns.begin(), s.latencies_ns.end());
+            double count = static_cast<double>(s.latencies_ns.size());
+            std::printf("%-22s %9zu %9.0f %6.1f%% %7llu %6llu %9.3f %9.3f %9.3f %9.3f %10.2f\n",
+                        OP_NAMES[op], s.latencies_ns.size(), count / seconds,
+                        100.0 * static_cast<double>(s.not_modified) / count,
+                        static_cast<unsigned long long>(s.rejected), static_cast<unsigned long long>(s.errors),
+                        percentile_ms(s.latencies_ns, 0.50), percentile_ms(s.latencies_ns, 0.90),
+                        percentile_ms(s.latencies_ns, 0.99), percentile_ms(s.latencies_ns, 1.0),
+                        static_cast<double>(s.bytes) / count / 1024.0);
+            all.insert(all.end(), s.latencies_ns.begin(), s.latencies_ns.end());
+            total_errors += s.errors;
+        }
+        std::sort(all.begin(), all.end());
+        double rps = static_cast<double>(all.size()) / seconds;
+        double p99 = percentile_ms(all, 0.99);
+        std::printf("%-22s %9zu %9.0f %7s %7s %6llu %9.3f %9.3f %9.3f %9.3f\n\n",
+                    "total", all.size(), rps, "", "", static_cast<unsigned long long>(total_errors),
+                    percentile_ms(all, 0.50), percentile_ms(all, 0.90), p99, percentile_ms(all, 1.0));
+
+        std::printf("rss:   before %zu KiB, peak %zu KiB, after %zu KiB (VmHWM %zu KiB, includes clients)\n",
+                    rss_before, rss_peak.load(), rss_after, read_status_kb("VmHWM"));
+        std::printf("logs:  %llu cached entries\n", static_cast<unsigned long long>(manager.log_generation()));
+
+        // 服务端连接统计，来自指标注册表
+        std::istringstream metrics(dl::MetricsRegistry::global().render());
+        std::string line;
+        while (std::getline(metrics, line)) {
+            if (line.rfind("dreamland_http_connections_", 0) == 0) {
+                std::printf("server: %s\n", line.c_str());
+            }
+        }
+
+        web_server.stop();
+
+        if (opt.min_rps > 0 && rps < opt.min_rps) {
+            std::printf("FAIL: req/s %.0f < %.0f\n", rps, opt.min_rps);
+            status = 1;
+        }
+        if (opt.max_p99_ms > 0 && p99 > opt.max_p99_ms) {
+            std::printf("FAIL: p99 %.3f ms > %.3f ms\n", p99, opt.max_p99_ms);
+            status = 1;
+        }
+    }
+
+    std::filesystem::remove_all(dir);
+    return status;
+}
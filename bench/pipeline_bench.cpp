@@ -0,0 +1,336 @@
+// 日志处理流水线基准测试
+// 回放一份 latest.log（或按比例合成的日志）：
+//   Buffer -> PlayerList::process_log_line -> ServerManager::add_log_entry -> JSON 序列化
+// 输出吞吐、单行延迟分位数与每行的内存分配次数；给出阈值时不达标返回非零，可用作回归检查
+//
+// 用法: pipeline_bench [--replay <latest.log>] [--lines N] [--players N] [--forbidden N]
+//                      [--join W] [--chat W] [--command W] [--f3 W] [--noise W] [--forbidden-hit R]
+//                      [--seed N] [--min-rate L] [--max-p99-us U] [--max-allocs A]
+
+#include <io/buffer.h>
+#include <io/program.h>
+#include <json_writer.h>
+#include <logger.h>
+#include <player_list.h>
+#include <server_manager.h>
+#include <time_util.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// ============================================================================
+// 内存分配计数
+// ============================================================================
+
+static std::atomic<uint64_t> g_allocations{0};
+static std::atomic<uint64_t> g_allocated_bytes{0};
+
+void* operator new(std::size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    g_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+// ============================================================================
+// 参数
+// ============================================================================
+
+struct BenchOptions {
+    std::string replay;          // 回放文件，为空时合成
+    size_t lines = 1000000;      // 合成的行数
+    size_t players = 200;        // 历史玩家数
+    size_t forbidden = 50;       // 禁止指令数量
+    double join = 1;             // 各类行的权重（加入与离开成对出现）
+    double chat = 30;
+    double command = 10;
+    double f3 = 3;
+    double noise = 55;           // 与玩家无关的服务器输出
+    double forbidden_hit = 0;    // 指令命中禁止列表的比例
+    uint32_t seed = 1;
+
+    // 回归阈值，0 表示不检查
+    double min_rate = 0;
+    double max_p99_us = 0;
+    double max_allocs = 0;
+};
+
+static bool parse_options(int argc, char* argv[], BenchOptions& opt) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::fprintf(stderr, "缺少参数值: %s\n", arg.c_str());
+            return false;
+        }
+        const char* value = argv[++i];
+        if (arg == "--replay") opt.replay = value;
+        else if (arg == "--lines") opt.lines = std::strtoull(value, nullptr, 10);
+        else if (arg == "--players") opt.players = std::max<size_t>(1, std::strtoull(value, nullptr, 10));
+        else if (arg == "--forbidden") opt.forbidden = std::strtoull(value, nullptr, 10);
+        else if (arg == "--join") opt.join = std::atof(value);
+        else if (arg == "--chat") opt.chat = std::atof(value);
+        else if (arg == "--command") opt.command = std::atof(value);
+        else if (arg == "--f3") opt.f3 = std::atof(value);
+        else if (arg == "--noise") opt.noise = std::atof(value);
+        else if (arg == "--forbidden-hit") opt.forbidden_hit = std::atof(value);
+        else if (arg == "--seed") opt.seed = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        else if (arg == "--min-rate") opt.min_rate = std::atof(value);
+        else if (arg == "--max-p99-us") opt.max_p99_us = std::atof(value);
+        else if (arg == "--max-allocs") opt.max_allocs = std::atof(value);
+        else {
+            std::fprintf(stderr, "未知参数: %s\n", arg.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+// ============================================================================
+// 输入
+// ============================================================================
+
+static std::string player_name(size_t i) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "Player%04zu", i);
+    return buf;
+}
+
+static std::string forbidden_keyword(size_t i) {
+    return "forbidden" + std::to_string(i);
+}
+
+// 按权重随机生成日志，同一玩家的加入与离开交替出现
+static std::string synthesize(const BenchOptions& opt) {
+    static const char* COMMANDS[] = {
+        "tp @s ~ ~10 ~", "give @s minecraft:diamond 64", "gamemode creative", "time set day",
+        "weather clear", "home", "spawn", "msg Player0001 hello there", "warp mine", "back"
+    };
+    static const char* NOISE[] = {
+        "Can't keep up! Is the server overloaded? Running 2048ms or 40 ticks behind",
+        "Saving chunks for level 'ServerLevel[world]'/minecraft:overworld",
+        "ThreadedAnvilChunkStorage: All dimension are saved",
+        "Preparing spawn area: 83%",
+        "[Server] Backup completed in 12.4s"
+    };
+
+    std::mt19937 rng(opt.seed);
+    std::discrete_distribution<int> kind({opt.join, opt.chat, opt.command, opt.f3, opt.noise});
+    std::uniform_int_distribution<size_t> pick_player(0, opt.players - 1);
+    std::uniform_real_distribution<double> unit(0, 1);
+    std::vector<bool> online(opt.players, false);
+
+    std::string out;
+    out.reserve(opt.lines * 80);
+    for (size_t i = 0; i < opt.lines; i++) {
+        char stamp[32];
+        std::snprintf(stamp, sizeof(stamp), "[%02zu:%02zu:%02zu INFO]: ", (i / 3600) % 24, (i / 60) % 60, i % 60);
+        out += stamp;
+
+        size_t p = pick_player(rng);
+        std::string name = player_name(p);
+        switch (kind(rng)) {
+            case 0:
+                out += name;
+                out += online[p] ? " left the game" : " joined the game";
+                online[p] = !online[p];
+                break;
+            case 1:
+                out += "<" + name + "> hello world, message number " + std::to_string(i);
+                break;
+            case 2:
+                out += name + " issued server command: /";
+                if (opt.forbidden > 0 && unit(rng) < opt.forbidden_hit) {
+                    out += forbidden_keyword(i % opt.forbidden);
+                } else {
+                    out += COMMANDS[i % (sizeof(COMMANDS) / sizeof(COMMANDS[0]))];
+                }
+                break;
+            case 3:
+                out += "[" + name + ": Set own game mode to Spectator Mode]";
+                break;
+            default:
+                out += NOISE[i % (sizeof(NOISE) / sizeof(NOISE[0]))];
+                break;
+        }
+        out += '\n';
+    }
+    return out;
+}
+
+static bool read_file(const std::string& path, std::string& out) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    out = ss.str();
+    if (!out.empty() && out.back() != '\n') out += '\n';
+    return true;
+}
+
+// 在临时目录中生成玩家列表与禁止指令列表
+static void write_fixtures(const std::filesystem::path& dir, const BenchOptions& opt) {
+    std::ofstream players(dir / "players.list");
+    for (size_t i = 0; i < opt.players; i++) {
+        players << player_name(i) << '\n';
+    }
+    std::ofstream forbidden(dir / "forbidden_commands.list");
+    for (size_t i = 0; i < opt.forbidden; i++) {
+        forbidden << forbidden_keyword(i) << ' ' << (i % 24 + 1) << '\n';
+    }
+    std::ofstream(dir / "banned.list");
+    std::ofstream(dir / "ops.json") << "[]";
+}
+
+// ============================================================================
+// 主流程
+// ============================================================================
+
+static double percentile(const std::vector<uint32_t>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t index = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1));
+    return sorted[index] / 1000.0;
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions opt;
+    if (!parse_options(argc, argv, opt)) return 2;
+
+    // 控制台输出不计入流水线：只保留警告，不转发服务器原始输出
+    dl::Logger::global().set_level(dl::LogLevel::WARN);
+    dl::Logger::global().set_passthrough(false);
+
+    std::string input;
+    if (!opt.replay.empty()) {
+        if (!read_file(opt.replay, input)) {
+            std::fprintf(stderr, "无法读取回放文件: %s\n", opt.replay.c_str());
+            return 2;
+        }
+    } else {
+        input = synthesize(opt);
+    }
+    size_t total_lines = static_cast<size_t>(std::count(input.begin(), input.end(), '\n'));
+
+    char tmpl[] = "/tmp/dl-bench-XXXXXX";
+    if (!mkdtemp(tmpl)) {
+        std::perror("mkdtemp");
+        return 2;
+    }
+    std::filesystem::path dir(tmpl);
+    write_fixtures(dir, opt);
+
+    int status = 0;
+    {
+        dl::Program program("true");  // 只用于满足接口，不会启动
+        dl::PlayerList player_list((dir / "players.list").string(), (dir / "banned.list").string(),
+                                   (dir / "forbidden_commands.list").string(), program);
+        dl::ServerManager manager(&program, (dir / "ops.json").string(), player_list, "bench");
+
+        // 与 WebServer::publish_log 推送 /api/stream 时相同的序列化
+        size_t json_bytes = 0;
+        manager.set_log_entry_callback([&json_bytes, &manager](const dl::LogView& log) {
+            dl::JsonWriter json(128 + log.content.size());
+            char buf[dl::TIME_STRING_LENGTH];
+            std::string_view timestamp(buf, dl::format_local_time(log.time, buf));
+            json.begin_object()
+                .field("seq", log.seq)
+                .field("timestamp", timestamp)
+                .field("type", std::string_view(dl::log_event_type_name(log.type)))
+                .field("player", log.player)
+                .field("content", log.content)
+                .field("server", manager.name())
+                .end_object();
+            json_bytes += json.str().size();
+        });
+
+        std::vector<uint32_t> latencies;
+        latencies.reserve(total_lines);
+        dl::Buffer buffer;
+        constexpr size_t CHUNK = 4096;  // 与 Program 读取管道的块大小一致
+
+        uint64_t allocs_before = g_allocations.load();
+        uint64_t bytes_before = g_allocated_bytes.load();
+        auto start = std::chrono::steady_clock::now();
+
+        for (size_t offset = 0; offset < input.size(); offset += CHUNK) {
+            buffer.append(input.data() + offset, std::min(CHUNK, input.size() - offset));
+            buffer.drain_lines([&](std::string_view line) {
+                auto t0 = std::chrono::steady_clock::now();
+                manager.handle_log_line(line);
+                auto t1 = std::chrono::steady_clock::now();
+                latencies.push_back(static_cast<uint32_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count()));
+            });
+        }
+
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        uint64_t allocs = g_allocations.load() - allocs_before;
+        uint64_t alloc_bytes = g_allocated_bytes.load() - bytes_before;
+
+        double seconds = std::chrono::duration<double>(elapsed).count();
+        size_t lines = latencies.size();
+        std::sort(latencies.begin(), latencies.end());
+        double rate = seconds > 0 ? static_cast<double>(lines) / seconds : 0;
+        double per_line_allocs = lines ? static_cast<double>(allocs) / static_cast<double>(lines) : 0;
+        double p99 = percentile(latencies, 0.99);
+
+        std::printf("input:           %s\n", opt.replay.empty() ? "synthetic" : opt.replay.c_str());
+        std::printf("lines:           %zu (%zu bytes)\n", lines, input.size());
+        std::printf("cached entries:  %llu\n", static_cast<unsigned long long>(manager.log_generation()));
+        std::printf("json bytes:      %zu\n", json_bytes);
+        std::printf("elapsed:         %.3f s\n", seconds);
+        std::printf("lines/sec:       %.0f\n", rate);
+        std::printf("latency p50:     %.2f us\n", percentile(latencies, 0.50));
+        std::printf("latency p90:     %.2f us\n", percentile(latencies, 0.90));
+        std::printf("latency p99:     %.2f us\n", p99);
+        std::printf("latency max:     %.2f us\n", latencies.empty() ? 0.0 : latencies.back() / 1000.0);
+        std::printf("allocs/line:     %.3f (%.1f bytes/line)\n", per_line_allocs,
+                    lines ? static_cast<double>(alloc_bytes) / static_cast<double>(lines) : 0.0);
+
+        if (opt.min_rate > 0 && rate < opt.min_rate) {
+            std::printf("FAIL: lines/sec %.0f < %.0f\n", rate, opt.min_rate);
+            status = 1;
+        }
+        if (opt.max_p99_us > 0 && p99 > opt.max_p99_us) {
+            std::printf("FAIL: p99 %.2f us > %.2f us\n", p99, opt.max_p99_us);
+            status = 1;
+        }
+        if (opt.max_allocs > 0 && per_line_allocs > opt.max_allocs) {
+            std::printf("FAIL: allocs/line %.3f > %.3f\n", per_line_allocs, opt.max_allocs);
+            status = 1;
+        }
+    }
+
+    std::filesystem::remove_all(dir);
+    return status;
+}
@@ -0,0 +1,102 @@
+#ifndef DREAMLAND_LOGGER_INCLUDE_AHO_CORASICK_H
+#define DREAMLAND_LOGGER_INCLUDE_AHO_CORASICK_H
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace dl {
+
+// Aho-Corasick 多模式串匹配自动机
+// 用法: 先 add_pattern 添加所有模式串，再调用 build 构建失败指针，之后即可在任意线程只读地匹配
+// 匹配耗时与文本长度成线性关系（外加匹配数），与模式串数量无关
+// 根节点的转移使用稠密表，其余节点使用有序的稀疏边表，以便容纳数万个模式串
+class AhoCorasick {
+public:
+	using State = uint32_t;
+	using PatternId = uint32_t;
+
+	static constexpr State ROOT = 0;
+	static constexpr uint32_t NONE = UINT32_MAX;
+
+	AhoCorasick();
+
+	// 添加模式串，返回其编号（按添加顺序从0开始），空串不会被匹配
+	// 重复的模式串只会报告编号最小的那个
+	PatternId add_pattern(std::string_view pattern);
+
+	// 构建失败指针，必须在匹配前调用，构建后不能再添加模式串
+	void build();
+
+	// 模式串数量
+	size_t pattern_count() const {
+		return pattern_lengths_.size();
+	}
+
+	// 模式串长度
+	size_t pattern_length(PatternId id) const {
+		return pattern_lengths_[id];
+	}
+
+	// 从 state 出发读入一个字符后的状态
+	State step(State state, unsigned char c) const;
+
+	// 对以 state 结尾的每个模式串调用 f(PatternId)
+	template <typename F>
+	void for_each_match(State state, F &&f) const {
+		uint32_t node = (nodes_[state].output != NONE) ? state : nodes_[state].dict_link;
+		while (node != NONE) {
+			f(nodes_[node].output);
+			node = nodes_[node].dict_link;
+		}
+	}
+
+	// 扫描文本，对每个匹配调用 f(PatternId, size_t end_pos)，end_pos 为匹配末尾的下一个位置
+	// f 返回 false 时停止扫描
+	template <typename F>
+	void scan(std::string_view text, F &&f) const {
+		State state = ROOT;
+		for (size_t i = 0; i < text.size(); ++i) {
+			state = step(state, static_cast<unsigned char>(text[i]));
+			uint32_t node = (nodes_[state].output != NONE) ? state : nodes_[state].dict_link;
+			while (node != NONE) {
+				if (!f(nodes_[node].output, i + 1)) {
+					return;
+				}
+				node = nodes_[node].dict_link;
+			}
+		}
+	}
+
+private:
+	struct Node {
+		uint32_t fail = ROOT; // 失败指针
+		uint32_t output = NONE; // 在此结束的模式串编号
+		uint32_t dict_link = NONE; // 失败链上下一个有输出的节点
+		uint32_t edge_begin = 0; // 在 edge_labels_/edge_targets_ 中的起始位置
+		uint32_t edge_count = 0;
+	};
+
+	// 查找 node 经字符 c 的直接转移，不存在返回 NONE
+	uint32_t child(uint32_t node, unsigned char c) const;
+
+	std::vector<Node> nodes_;
+	std::vector<uint32_t> pattern_lengths_;
+
+	// 构建阶段使用的临时边表
+	std::vector<std::vector<std::pair<unsigned char, uint32_t>>> build_edges_;
+
+	// 构建完成后的扁平边表（按字符排序）
+	std::vector<unsigned char> edge_labels_;
+	std::vector<uint32_t> edge_targets_;
+	// 根节点的稠密转移表，缺失的转移指向根节点本身
+	std::array<uint32_t, 256> root_next_ {};
+
+	bool built_ = false;
+};
+
+} // namespace dl
+
+#endif // DREAMLAND_LOGGER_INCLUDE_AHO_CORASICK_H
@@ -3,14 +3,18 @@
 
 #include <atomic>
 #include <chrono>
-#include <condition_variable>
 #include <cstdint>
 #include <functional>
+#include <io/journal.h>
+#include <map>
+#include <memory>
+#include <metrics.h>
 #include <mutex>
 #include <string>
-#include <thread>
+#include <timer_queue.h>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 namespace dl {
@@ -39,6 +43,20 @@ struct RequestInfo {
 // 命令执行回调函数类型
 using CommandExecuteCallback = std::function<void(const std::string& command, const std::string& applicant)>;
 
+// 申请变化类型
+enum class RequestChange {
+    CREATE,
+    VOTE,
+    EXECUTE,
+    REMOVE
+};
+
+// 申请变化回调函数类型，在释放锁之后调用
+using RequestChangeCallback = std::function<void(RequestChange change, const std::string& request_id)>;
+
+// 申请遍历回调函数类型
+using RequestVisitor = std::function<void(const RequestInfo& info)>;
+
 // 命令申请管理器
 class CommandRequestManager {
 public:
@@ -47,10 +65,12 @@ public:
     // @param upload_dir: 图片上传目录
     // @param vote_threshold: 投票通过阈值
     // @param execute_callback: 命令执行回调
+    // @param timers: 共享的定时任务队列，为空时自行创建；需比本对象存活更久
     CommandRequestManager(const std::string& data_file,
                           const std::string& upload_dir,
                           size_t vote_threshold,
-                          CommandExecuteCallback execute_callback);
+                          CommandExecuteCallback execute_callback,
+                          TimerQueue* timers = nullptr);
     
     ~CommandRequestManager();
     
@@ -71,15 +91,30 @@ public:
                                const std::string& image_data = "",
                                const std::string& image_ext = "");
     
-    // 为申请投票
+    // 创建新申请，图片已由调用方写入上传临时目录（get_upload_temp_dir）中的临时文件（避免整张图片驻留内存）
+    // @param image_temp_path: 临时文件路径，需与上传目录在同一文件系统；为空则无图片。
+    //                         成功时重命名为 <申请ID><扩展名>，失败时删除
+    // @param image_ext: 图片扩展名（如 ".png", ".jpg"）
+    // @return: 申请ID，失败返回空字符串
+    std::string create_request_with_file(const std::string& applicant,
+                                         const std::string& command,
+                                         const std::string& reason,
+                                         const std::string& image_temp_path,
+                                         const std::string& image_ext);
+    
+    // 为申请投票，达到阈值的那一票会立即把命令交给执行线程
     // @param request_id: 申请ID
     // @param ip: 投票者IP
     // @return: 0=成功, 1=已投过票, 2=申请不存在, 3=已执行
     int vote(const std::string& request_id, const std::string& ip);
     
-    // 获取所有申请列表
+    // 获取所有申请列表（新的在前）
     std::vector<RequestInfo> list_requests() const;
     
+    // 按创建时间从新到旧遍历所有申请，不复制、不排序
+    // 回调在持有数据锁时调用，其中不得再调用本对象的方法
+    void visit_requests(const RequestVisitor& visitor) const;
+    
     // 获取单个申请
     // @param request_id: 申请ID
     // @param out: 输出参数
@@ -89,13 +124,25 @@ public:
     // 获取投票阈值
     size_t get_threshold() const { return vote_threshold_; }
     
-    // 设置投票阈值
-    void set_threshold(size_t threshold) { vote_threshold_ = threshold; }
+    // 设置投票阈值，降低阈值后已满足条件的申请会立即执行
+    void set_threshold(size_t threshold);
+    
+    // 执行上次退出前已达到阈值但尚未执行的申请
+    // 构造时不会执行（执行回调此时通常还无法把命令发给 MC 服务器），需在服务器启动后调用
+    void execute_pending();
+    
+    // 数据版本号，申请列表或阈值每次变化时递增，用于 Web 接口缓存
+    uint64_t generation() const { return generation_.load(); }
     
     // 获取上传目录
     const std::string& get_upload_dir() const { return upload_dir_; }
+    // 上传中的临时文件目录，与上传目录同级（同一文件系统，rename 仍是原子的），不对外提供访问
+    const std::string& get_upload_temp_dir() const { return upload_temp_dir_; }
     
-    // 手动保存数据
+    // 设置申请变化回调（需在接受请求前设置）
+    void set_change_callback(RequestChangeCallback callback) { change_callback_ = std::move(callback); }
+    
+    // 手动保存数据（将变更日志压缩进数据文件）
     bool save() const;
     
     // 检查是否为pardon自己的命令
@@ -105,19 +152,53 @@ private:
     // 生成唯一ID
     static std::string generate_id();
     
-    // 加载数据
-    void load_data();
-    // 保存数据
-    void save_data() const;
+    // 填充申请的公共字段
+    static RequestInfo make_request(const std::string& applicant,
+                                    const std::string& command,
+                                    const std::string& reason);
     
-    // 检查线程函数（检查阈值、清理过期申请）
-    void checker_thread_func();
+    // 登记新申请并持久化
+    std::string add_request(RequestInfo info);
     
-    // 检查并执行达到阈值的申请
-    void check_and_execute();
+    // 按创建时间排序的存储键，创建时间相同时按ID区分
+    using OrderKey = std::pair<std::chrono::system_clock::time_point, std::string>;
+    using RequestMap = std::map<OrderKey, RequestInfo>;
     
-    // 清理已执行超过24小时的申请
-    void cleanup_expired();
+    // 以下 *_locked 函数需持有 mutex_
+    RequestInfo* find_locked(const std::string& request_id);
+    const RequestInfo* find_locked(const std::string& request_id) const;
+    // ID 已存在时不覆盖
+    void insert_locked(RequestInfo info);
+    void erase_locked(const std::string& request_id);
+    
+    // 加载数据文件并重放变更日志
+    void load_data();
+    // 写出完整数据文件，由 journal 压缩时在其写线程上调用
+    bool save_data() const;
+    // 追加式变更日志: <data_file>.journal
+    std::string journal_file() const;
+    
+    // 待执行的命令，复制出来以便在锁外调用回调
+    struct ExecuteTask {
+        std::string id;
+        std::string command;
+        std::string applicant;
+    };
+    
+    // 标记为已执行并交给定时任务线程执行（需持有 mutex_）
+    void mark_executed_locked(RequestInfo& info);
+    // 在执行时间 + 24 小时登记清理定时器（需持有 mutex_）
+    void schedule_expiry_locked(const RequestInfo& info);
+    // 执行所有已达到阈值的申请，只在加载和修改阈值时扫描（需持有 mutex_）
+    void execute_ready_locked();
+    
+    // 取出并执行所有待执行的命令，在定时任务线程上调用
+    void run_pending_executions();
+    // 在锁外执行命令
+    void run_executions(const std::vector<ExecuteTask>& tasks);
+    
+    // 清理已执行超过24小时的申请，由其清理定时器调用
+    void expire(const std::string& request_id);
     
     // 删除图片文件
     void delete_image(const std::string& image_path);
@@ -125,17 +206,26 @@ private:
 private:
     std::string data_file_;                                  // 数据文件路径
     std::string upload_dir_;                                 // 上传目录
-    size_t vote_threshold_;                                  // 投票阈值
+    std::string upload_temp_dir_;                            // 上传临时文件目录
+    std::atomic<size_t> vote_threshold_;                     // 投票阈值
     CommandExecuteCallback execute_callback_;                // 命令执行回调
+    RequestChangeCallback change_callback_;                  // 申请变化回调
+    
+    RequestMap requests_;                                    // 按创建时间排序的申请
+    std::unordered_map<std::string, RequestMap::iterator> index_; // ID 索引
+    std::unique_ptr<Journal> journal_;                       // 变更日志
     
-    std::unordered_map<std::string, RequestInfo> requests_;  // 申请映射表
+    mutable TimedMutex mutex_{"command_request"};           // 数据互斥锁（记录等待时间）
+    std::atomic<uint64_t> generation_{0};                    // 数据版本号
     
-    mutable std::mutex mutex_;                               // 数据互斥锁
+    std::unique_ptr<TimerQueue> own_timers_;                 // 未传入共享队列时自行创建
+    TimerQueue* timers_;                                     // 定时任务队列
     
-    std::thread checker_thread_;                             // 检查线程
-    std::atomic<bool> stop_checker_{false};                  // 停止标志
-    std::condition_variable checker_cv_;                     // 条件变量
-    std::mutex checker_mutex_;                               // 检查线程互斥锁
+    // 以下由 mutex_ 保护
+    std::vector<ExecuteTask> pending_executions_;            // 待执行的命令
+    TimerQueue::TimerId execution_timer_ = 0;                // 已提交的执行任务，0 表示没有
+    std::unordered_map<std::string, TimerQueue::TimerId> expiry_timers_; // 申请ID -> 清理定时器
+    bool stopping_ = false;                                  // 析构中，不再登记定时器
 };
 
 } // namespace dl
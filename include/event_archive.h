@@ -0,0 +1,98 @@
+#ifndef DREAMLAND_LOGGER_INCLUDE_EVENT_ARCHIVE_H
+#define DREAMLAND_LOGGER_INCLUDE_EVENT_ARCHIVE_H
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace dl {
+
+// 归档事件类型，数值写入磁盘，不可修改
+enum class EventKind : uint8_t {
+	JOIN = 1,
+	LEAVE = 2,
+	COMMAND = 3,
+	CHAT = 4
+};
+
+// "join"/"leave"/"command"/"chat"
+const char *event_kind_name(EventKind kind);
+// 无法识别时返回 false
+bool parse_event_kind(std::string_view name, EventKind &kind);
+
+// 一条归档事件
+struct ArchivedEvent {
+	uint64_t seq = 0; // 归档序号，跨重启单调递增
+	EventKind kind = EventKind::CHAT;
+	std::chrono::system_clock::time_point time;
+	std::string player;
+	std::string content;
+};
+
+// 历史查询条件，各条件同时满足
+struct HistoryQuery {
+	std::string player; // 为空表示不限，不区分大小写
+	bool has_kind = false;
+	EventKind kind = EventKind::CHAT;
+	std::chrono::system_clock::time_point from = std::chrono::system_clock::time_point::min();
+	std::chrono::system_clock::time_point to = std::chrono::system_clock::time_point::max();
+	uint64_t before_seq = 0; // 只返回序号小于它的事件，用于翻页，0 表示不限
+	size_t limit = 200;
+};
+
+// 持久化事件归档
+// data/events 下的分段追加文件，每段预分配为固定大小并整体 mmap，追加只是一次 memcpy；
+// 段写满或跨过一天时封存（截断到实际长度）并开始新段。每段在内存中保存时间范围、
+// 按玩家和按类型的偏移倒排表，查询先按时间范围跳过整段，再只访问倒排表命中的记录
+// 启动时扫描已有段重建索引，最后一段中写了一半的记录被丢弃；超过保留期的段整段删除
+class EventArchive {
+public:
+	struct Options {
+		uint64_t segment_bytes = 16 << 20; // 单段大小
+		std::chrono::hours retention { 24 * 90 }; // 保留期
+	};
+
+	explicit EventArchive(const std::string &dir);
+	EventArchive(const std::string &dir, Options options);
+	~EventArchive();
+
+	EventArchive(const EventArchive &) = delete;
+	EventArchive &operator=(const EventArchive &) = delete;
+
+	// 追加一条事件，返回其归档序号；失败返回 0
+	uint64_t append(EventKind kind, std::chrono::system_clock::time_point time,
+		std::string_view player, std::string_view content);
+
+	// 按序号从新到旧返回满足条件的事件，最多 query.limit 条
+	std::vector<ArchivedEvent> query(const HistoryQuery &query) const;
+
+	// 已归档的事件总数（保留期内）
+	uint64_t size() const;
+
+private:
+	struct Segment;
+
+	// 打开（必要时预分配）并映射 path，读取已有记录重建索引
+	std::unique_ptr<Segment> open_segment(const std::string &path, bool writable);
+	// 新建一段作为当前写入段
+	bool roll_segment(std::chrono::system_clock::time_point time);
+	// 删除超过保留期的已封存段
+	void drop_expired(std::chrono::system_clock::time_point now);
+	// 读取 offset 处的记录
+	static ArchivedEvent read_event(const Segment &segment, uint32_t offset);
+
+	std::string dir_;
+	Options options_;
+
+	mutable std::mutex mutex_;
+	std::vector<std::unique_ptr<Segment>> segments_; // 按时间顺序，最后一个为当前写入段
+	uint64_t next_seq_ = 1;
+};
+
+} // namespace dl
+
+#endif // DREAMLAND_LOGGER_INCLUDE_EVENT_ARCHIVE_H
@@ -0,0 +1,71 @@
+#ifndef DREAMLAND_LOGGER_INCLUDE_EVENT_HUB_H
+#define DREAMLAND_LOGGER_INCLUDE_EVENT_HUB_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace dl {
+
+// 服务器推送事件（SSE）分发器
+// 每条事件只格式化一次，以共享指针投递到所有订阅者的队列，订阅者在各自的 HTTP 线程中取出并写入连接
+class EventHub {
+public:
+	// 单个订阅者（一个 /api/stream 连接）
+	class Subscriber {
+	public:
+		// 取出所有待发送的消息并拼接到 out，最多等待 timeout
+		// @return: false 表示分发器已关闭或队列溢出，连接应当断开
+		bool wait(std::string &out, std::chrono::milliseconds timeout);
+
+	private:
+		friend class EventHub;
+
+		std::mutex mutex_;
+		std::condition_variable cv_;
+		std::deque<std::shared_ptr<const std::string>> queue_;
+		bool closed_ = false;
+	};
+
+	// @param max_subscribers: 最大同时订阅数（每个订阅占用一个 HTTP 工作线程）
+	// @param max_queued: 单个订阅者最多积压的消息数，超过时断开该订阅者（客户端会自动重连并补齐）
+	EventHub(size_t max_subscribers, size_t max_queued);
+
+	EventHub(const EventHub &) = delete;
+	EventHub &operator=(const EventHub &) = delete;
+
+	// 新建订阅，达到上限或已关闭时返回 nullptr
+	// @param hello: 只发给该订阅者的第一条消息（已格式化），可为空
+	std::shared_ptr<Subscriber> subscribe(const std::string &hello = "");
+	void unsubscribe(const std::shared_ptr<Subscriber> &subscriber);
+
+	// 广播一条事件
+	// @param event: 事件名
+	// @param data: 单行 JSON
+	void publish(const std::string &event, const std::string &data);
+
+	// 唤醒并断开所有订阅者，之后不再接受新订阅
+	void close();
+
+	size_t subscriber_count() const;
+
+	// 格式化为 SSE 消息: "event: <event>\ndata: <data>\n\n"
+	static std::string format(const std::string &event, const std::string &data);
+
+private:
+	size_t max_subscribers_;
+	size_t max_queued_;
+
+	mutable std::mutex mutex_;
+	std::vector<std::shared_ptr<Subscriber>> subscribers_;
+	bool closed_ = false;
+};
+
+} // namespace dl
+
+#endif // DREAMLAND_LOGGER_INCLUDE_EVENT_HUB_H
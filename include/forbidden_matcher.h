@@ -0,0 +1,48 @@
+#ifndef DREAMLAND_LOGGER_INCLUDE_FORBIDDEN_MATCHER_H
+#define DREAMLAND_LOGGER_INCLUDE_FORBIDDEN_MATCHER_H
+
+#include <aho_corasick.h>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace dl {
+
+// 禁止指令信息
+struct ForbiddenCommand {
+	std::string command;
+	uint64_t ban_hours;
+};
+
+// 禁止指令匹配器
+// 关键词在构造时统一去掉空格并转小写，编译为一个 Aho-Corasick 自动机；
+// 匹配时边归一化边扫描，耗时只与文本长度成线性关系，与关键词数量无关
+// 构造完成后只读，可在多个线程中同时使用
+class ForbiddenCommandMatcher {
+public:
+	ForbiddenCommandMatcher();
+	explicit ForbiddenCommandMatcher(std::vector<ForbiddenCommand> commands);
+
+	// 返回文本中命中的、在列表中最靠前的规则，未命中返回 nullptr
+	const ForbiddenCommand *match(std::string_view text) const;
+
+	// 规则列表
+	const std::vector<ForbiddenCommand> &commands() const {
+		return commands_;
+	}
+
+	bool empty() const {
+		return commands_.empty();
+	}
+
+private:
+	std::vector<ForbiddenCommand> commands_;
+	AhoCorasick automaton_;
+	// 归一化后为空的关键词会匹配任意文本，记录其中编号最小的一个
+	size_t empty_keyword_ = SIZE_MAX;
+};
+
+} // namespace dl
+
+#endif // DREAMLAND_LOGGER_INCLUDE_FORBIDDEN_MATCHER_H
@@ -1,13 +1,16 @@
 #ifndef DREAMLAND_LOGGER_INCLUDE_IO_BUFFER_H
 #define DREAMLAND_LOGGER_INCLUDE_IO_BUFFER_H
 
+#include <cstdint>
+#include <io/stream_buffer.h>
 #include <mutex>
 #include <string>
+#include <string_view>
 
 namespace dl {
 
 // Thread-safe IO buffer with lazy compaction
-class Buffer {
+class Buffer : public StreamBuffer {
 public:
 	// Maximum deleted buffer size threshold to prevent frequent reallocation
 	const uint64_t MAX_DELETED_BUFFER_SIZE = 4096;
@@ -22,22 +25,32 @@ public:
 	Buffer &operator=(Buffer &&) = delete;
 
 	// Append data to the end of buffer
-	void append(const std::string &data);
-	void append(const char *data, uint64_t len);
+	void append(const std::string &data) override;
+	void append(const char *data, uint64_t len) override;
 
 	// Read all unread content and move read position to end
-	std::string read_all();
+	std::string read_all() override;
 	// Read one line ending with '\n', return empty if no complete line
-	std::string read_line();
+	std::string read_line() override;
+	// Hand every complete buffered line (without the trailing '\n') to callback.
+	// The lock is taken once to detach the lines; callback runs without it, so the
+	// producer is never blocked by line processing. Views are valid only during the
+	// callback. Must only be called from a single consumer thread.
+	// @return: number of lines delivered
+	size_t drain_lines(const LineCallback &callback) override;
 
 	// Clear the buffer and reset read position
-	void clear();
+	void clear() override;
 	// Check if buffer has unread data
-	bool empty() const;
+	bool empty() const override;
+	uint64_t buffered_bytes() const override;
 
 private:
 	std::string buffer_;
 	uint64_t buffer_ptr_ = 0;
+	// Consumer-side storage for lines detached by drain_lines, swapped with buffer_
+	// so both strings keep their capacity and steady state does not reallocate
+	std::string drain_buffer_;
 	mutable std::mutex mutex_;
 };
 
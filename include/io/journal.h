@@ -0,0 +1,91 @@
+#ifndef DREAMLAND_LOGGER_INCLUDE_IO_JOURNAL_H
+#define DREAMLAND_LOGGER_INCLUDE_IO_JOURNAL_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace dl {
+
+// Write content to path durably: write a temporary file, fsync it, then rename over path
+bool write_file_atomically(const std::string &path, std::string_view content);
+
+// Append-only record journal with a background writer thread.
+// Each record is one line (it must not contain '\n'). append() only queues the
+// record; the writer appends everything queued in one write() and issues a
+// single fdatasync() per batch, so callers never wait on disk.
+// Compaction: once the journal grows past a size threshold, or after an interval
+// with pending records, or on request, the writer invokes the owner's snapshot
+// callback which must persist the full state durably; the journal is then
+// truncated. Records must be idempotent state assignments and the owner must
+// apply a mutation before appending its record, so replaying records written
+// after a snapshot over that snapshot always converges to the latest state.
+class Journal {
+public:
+	using SnapshotCallback = std::function<bool()>;
+	using RecordCallback = std::function<void(std::string_view)>;
+
+	struct Options {
+		uint64_t compact_bytes = 1 << 20; // Compact when the journal exceeds this size
+		std::chrono::seconds compact_interval { 600 }; // Compact pending records at least this often
+	};
+
+	Journal(const std::string &path, SnapshotCallback snapshot);
+	Journal(const std::string &path, SnapshotCallback snapshot, Options options);
+	// Flushes queued records, then stops the writer thread
+	~Journal();
+
+	Journal(const Journal &) = delete;
+	Journal &operator=(const Journal &) = delete;
+
+	// Call callback for every record stored in the journal at path, return the count
+	static size_t replay(const std::string &path, const RecordCallback &callback);
+
+	// Queue a record for appending
+	void append(std::string record);
+	// Block until every record queued so far is on disk
+	void flush();
+	// Block until a compaction started after this call has finished
+	// @return: false if the snapshot callback failed
+	bool compact();
+
+	const std::string &path() const {
+		return path_;
+	}
+
+private:
+	void writer_thread_func();
+	// Write and sync a batch, called on the writer thread only
+	void write_batch(const std::vector<std::string> &batch);
+	// Snapshot the owner's state and truncate the journal, called on the writer thread only
+	bool do_compact();
+
+	std::string path_;
+	SnapshotCallback snapshot_;
+	Options options_;
+	int fd_ = -1;
+	uint64_t journal_bytes_ = 0; // Writer thread only
+
+	std::mutex mutex_;
+	std::condition_variable cv_; // Wakes the writer
+	std::condition_variable done_cv_; // Wakes flush()/compact() callers
+	std::vector<std::string> queue_;
+	uint64_t queued_seq_ = 0; // Sequence of the last queued record
+	uint64_t written_seq_ = 0; // Sequence of the last record on disk
+	uint64_t compact_requested_ = 0;
+	uint64_t compact_done_ = 0;
+	bool last_compact_ok_ = true;
+	bool stop_ = false;
+
+	std::thread writer_thread_;
+};
+
+}
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef DREAMLAND_LOGGER_INCLUDE_IO_MAPPED_FILE_H
+#define DREAMLAND_LOGGER_INCLUDE_IO_MAPPED_FILE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace dl {
+
+// Read-only mapping of a whole file. Loaders parse the mapped bytes in place
+// with string_views instead of copying the file line by line; the views are
+// valid until the mapping is closed.
+class MappedFile {
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+	MappedFile(MappedFile &&other) noexcept;
+	MappedFile &operator=(MappedFile &&other) noexcept;
+
+	// Map path for a single sequential scan, an empty file maps to an empty view
+	// @return: false if the file cannot be opened or mapped
+	bool open(const std::string &path);
+	// Unmap the file, views into it become invalid
+	void close();
+
+	std::string_view view() const {
+		return std::string_view(data_, size_);
+	}
+	size_t size() const {
+		return size_;
+	}
+
+private:
+	const char *data_ = nullptr;
+	size_t size_ = 0;
+};
+
+// Number of lines in content, counting a last line without '\n'; used to size
+// containers before parsing
+inline size_t count_lines(std::string_view content) {
+	size_t lines = static_cast<size_t>(std::count(content.begin(), content.end(), '\n'));
+	return lines + (!content.empty() && content.back() != '\n' ? 1 : 0);
+}
+
+// Strip leading and trailing spaces, tabs, '\r' and '\n'
+inline std::string_view trim_view(std::string_view s) {
+	size_t start = s.find_first_not_of(" \t\r\n");
+	if (start == std::string_view::npos) {
+		return std::string_view();
+	}
+	size_t end = s.find_last_not_of(" \t\r\n");
+	return s.substr(start, end - start + 1);
+}
+
+// Call callback(std::string_view) for every line of content without its '\n',
+// including a last line that is not terminated
+template <typename Callback>
+void for_each_line(std::string_view content, Callback &&callback) {
+	size_t begin = 0;
+	while (begin < content.size()) {
+		size_t end = content.find('\n', begin);
+		if (end == std::string_view::npos) {
+			end = content.size();
+		}
+		callback(content.substr(begin, end - begin));
+		begin = end + 1;
+	}
+}
+
+}
+
+#endif
@@ -2,10 +2,18 @@
 #define DREAMLAND_LOGGER_INCLUDE_IO_PROGRAM_H
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
 #include <io/buffer.h>
+#include <io/reactor.h>
+#include <io/ring_buffer.h>
+#include <io/stream_buffer.h>
 #include <memory>
+#include <mutex>
 #include <string>
-#include <thread>
 
 namespace dl {
 
@@ -18,8 +26,24 @@ public:
 		STDERR // Standard error stream
 	};
 
+	// Buffer backend used for one output stream
+	struct BufferOptions {
+		enum class Backend {
+			STRING, // Growable mutex-protected dl::Buffer (default)
+			RING // Fixed-capacity lock-free dl::RingBuffer
+		};
+		Backend backend = Backend::STRING;
+		uint64_t ring_capacity = RingBuffer::DEFAULT_CAPACITY;
+		RingBuffer::OverflowPolicy overflow = RingBuffer::OverflowPolicy::BLOCK;
+	};
+
+	// Bytes that may wait in the stdin queue; further sends fail instead of blocking
+	static constexpr uint64_t MAX_STDIN_QUEUE_BYTES = 1 << 20;
+
 	// Constructor with command string
-	explicit Program(const std::string &command);
+	// @param reactor: shared I/O reactor watching the pipes, must outlive the program;
+	//                 when null the program starts its own on the first run()
+	explicit Program(const std::string &command, Reactor *reactor = nullptr);
 	// Destructor
 	~Program();
 
@@ -29,16 +53,41 @@ public:
 	Program(Program &&) = delete;
 	Program &operator=(Program &&) = delete;
 
+	// Select the buffer backend of a stream, only allowed while not running
+	bool set_buffer_options(IOStreamType type, const BufferOptions &options);
+	// Bytes discarded by the stream buffer's overflow policy
+	uint64_t dropped_bytes(IOStreamType type) const;
+	// Bytes read from the pipe but not yet consumed
+	uint64_t buffered_bytes(IOStreamType type) const;
+
 	// Start the program, return false if already running or failed to start
 	bool run();
-	// Send string to program's stdin
+	// Queue data for the program's stdin without blocking; the reactor
+	// writes everything queued with one writev() as soon as the pipe accepts it
+	// @return: false if the program is not running or the queue is full
 	bool send_string(const std::string &data);
+	// Same as send_string, the future becomes true once all of data is in the pipe,
+	// false if it was rejected or the program exited first
+	std::future<bool> send_string_async(std::string data);
 	// Read string from program's output
 	// @param read_by_line: if true, read one line; otherwise read all available
 	// @param type: specify which stream to read from
 	std::string read_string(bool read_by_line = false,
 		IOStreamType type = IOStreamType::STDOUT);
 
+	// Hand every complete line currently buffered on the stream to callback
+	// (see StreamBuffer::drain_lines), return the number of lines delivered
+	size_t drain_lines(const StreamBuffer::LineCallback &callback,
+		IOStreamType type = IOStreamType::STDOUT);
+
+	// Monotonic counter bumped whenever new output arrives or the process exits
+	uint64_t output_sequence() const;
+	// Block until output_sequence() differs from last_sequence or the timeout expires
+	// @return: true if the sequence changed
+	bool wait_for_output(uint64_t last_sequence, std::chrono::milliseconds timeout);
+	// Wake every thread blocked in wait_for_output (used on shutdown)
+	void wake_output_waiters();
+
 	// Gracefully stop the program (SIGTERM)
 	bool stop();
 	// Forcefully kill the program (SIGKILL)
@@ -50,8 +99,30 @@ public:
 	int get_exit_code() const;
 
 private:
-	// Reader thread function for capturing child process output
-	void reader_thread_func();
+	// Register the pipes, wake fd and child exit notification with the reactor
+	bool watch_all();
+	// Unregister everything watch_all() added, waits for running handlers off the reactor thread
+	void unwatch_all();
+	// Reactor handlers
+	void handle_output(int fd, StreamBuffer *buffer);
+	void handle_wake();
+	void handle_child_event(int fd);
+	// Read everything currently available on fd into buffer
+	// @return: false once the write end has been closed (EOF)
+	bool drain_fd(int fd, StreamBuffer *buffer);
+	// Buffer backing the given stream
+	StreamBuffer *buffer_of(IOStreamType type) const;
+	// Reap the child if it has exited, return true when it has
+	bool try_reap_child();
+	// Bump the output sequence and wake consumers
+	void notify_output();
+	// Make the reactor call flush_stdin
+	void wake_reactor();
+	// Write queued stdin data until the queue is empty or the pipe is full,
+	// watching the pipe for EPOLLOUT while data is left over (reactor thread only)
+	void flush_stdin();
+	// Resolve every queued and in-flight stdin write with false
+	void fail_pending_writes();
 	// Close all pipe file descriptors
 	void close_pipes();
 	// Cleanup resources after process termination
@@ -60,7 +131,6 @@ private:
 	std::string command_;
 	pid_t child_pid_ = -1;
 	std::atomic<bool> running_ { false };
-	std::atomic<bool> stop_reader_ { false };
 	int exit_code_ = -1;
 
 	// Pipe file descriptors: [0] for read, [1] for write
@@ -68,12 +138,40 @@ private:
 	int stdout_pipe_[2] = { -1, -1 };
 	int stderr_pipe_[2] = { -1, -1 };
 
-	// Buffers for stdout and stderr
-	std::unique_ptr<Buffer> stdout_buffer_;
-	std::unique_ptr<Buffer> stderr_buffer_;
+	// eventfd used to request a stdin flush, pidfd used to detect child exit;
+	// without pidfd support a timerfd polls waitpid instead
+	int wake_fd_ = -1;
+	int pid_fd_ = -1;
+	int poll_fd_ = -1;
+
+	// Reactor watching this program, own_reactor_ when none was passed in
+	Reactor *reactor_;
+	std::unique_ptr<Reactor> own_reactor_;
 
-	// Reader thread for capturing output
-	std::thread reader_thread_;
+	// Output notification for consumers
+	std::atomic<uint64_t> output_seq_ { 0 };
+	std::atomic<int> output_waiters_ { 0 };
+	std::mutex output_mutex_;
+	std::condition_variable output_cv_;
+
+	// A queued stdin write, done is fulfilled once data is fully written or dropped
+	struct PendingWrite {
+		std::string data;
+		size_t offset = 0;
+		std::promise<bool> done;
+	};
+
+	// stdin queue: producers append under stdin_mutex_, the reactor moves the
+	// whole queue to stdin_inflight_ and writes from there without the lock
+	std::mutex stdin_mutex_;
+	std::deque<PendingWrite> stdin_queue_;
+	std::deque<PendingWrite> stdin_inflight_; // Reactor thread only
+	uint64_t stdin_queued_bytes_ = 0; // Queued plus in-flight, guarded by stdin_mutex_
+	bool stdin_watched_ = false; // Reactor thread only: stdin registered for EPOLLOUT
+
+	// Buffers for stdout and stderr
+	std::unique_ptr<StreamBuffer> stdout_buffer_;
+	std::unique_ptr<StreamBuffer> stderr_buffer_;
 };
 
 }
@@ -0,0 +1,74 @@
+#ifndef DREAMLAND_LOGGER_INCLUDE_IO_REACTOR_H
+#define DREAMLAND_LOGGER_INCLUDE_IO_REACTOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace dl {
+
+// Single-threaded epoll loop that can be shared by any number of child programs.
+// Handlers run one at a time on the reactor thread, SIGPIPE is blocked there so
+// writes to a closed pipe fail with EPIPE. A handler that blocks (e.g. on a full
+// BLOCK ring buffer) stalls every descriptor on the reactor until it returns.
+class Reactor {
+public:
+	// Called with the epoll event mask that fired
+	using Handler = std::function<void(uint32_t events)>;
+
+	Reactor();
+	~Reactor();
+
+	// Disable copy and move operations
+	Reactor(const Reactor &) = delete;
+	Reactor &operator=(const Reactor &) = delete;
+	Reactor(Reactor &&) = delete;
+	Reactor &operator=(Reactor &&) = delete;
+
+	// Watch fd for events (level triggered), handler runs on the reactor thread
+	// @return: false if fd is already watched or epoll_ctl failed
+	bool add(int fd, uint32_t events, Handler handler);
+	// Stop watching fd, a no-op if it is not watched. Off the reactor thread this
+	// waits for a handler that may be running to return, so the caller may free
+	// whatever the handler uses (and close fd) right afterwards
+	void remove(int fd);
+
+	// Check if the calling thread is the reactor thread
+	bool in_reactor_thread() const;
+	// Number of watched descriptors
+	size_t size() const;
+
+private:
+	struct Registration {
+		int fd = -1;
+		std::shared_ptr<Handler> handler;
+	};
+
+	// Event loop
+	void thread_func();
+
+	int epoll_fd_ = -1;
+	int wake_fd_ = -1; // eventfd used to interrupt epoll_wait on shutdown
+	std::atomic<bool> stop_ { false };
+
+	mutable std::mutex mutex_;
+	std::condition_variable round_cv_;
+	// epoll data carries a registration id rather than the fd, so an event that was
+	// already collected for a removed fd never reaches a later owner of the same number
+	std::unordered_map<uint64_t, Registration> registrations_;
+	std::unordered_map<int, uint64_t> ids_; // fd -> registration id
+	uint64_t next_id_ = 1; // 0 is the wake fd
+	bool dispatching_ = false; // Handlers of the current round are being called
+	uint64_t rounds_ = 0; // Completed dispatch rounds
+
+	std::thread thread_;
+};
+
+}
+
+#endif
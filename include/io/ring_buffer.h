@@ -0,0 +1,101 @@
+#ifndef DREAMLAND_LOGGER_INCLUDE_IO_RING_BUFFER_H
+#define DREAMLAND_LOGGER_INCLUDE_IO_RING_BUFFER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <io/stream_buffer.h>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace dl {
+
+// Fixed-capacity lock-free single-producer/single-consumer byte ring.
+// Exactly one thread may append and exactly one thread may read; the data path
+// only touches two atomic positions, the mutex is used solely to park a
+// producer waiting for space under the BLOCK policy.
+class RingBuffer : public StreamBuffer {
+public:
+	// What append does when the ring has no room for the incoming data
+	enum class OverflowPolicy {
+		BLOCK, // Wait until the consumer frees enough space
+		DROP_OLDEST // Discard the oldest complete lines to make room
+	};
+
+	// Default capacity (rounded up to a power of two)
+	static constexpr uint64_t DEFAULT_CAPACITY = 1 << 20;
+
+	explicit RingBuffer(uint64_t capacity = DEFAULT_CAPACITY,
+		OverflowPolicy policy = OverflowPolicy::BLOCK);
+	// Constructors that be banned.
+	RingBuffer(const RingBuffer &) = delete;
+	RingBuffer &operator=(const RingBuffer &) = delete;
+	RingBuffer(RingBuffer &&) = delete;
+	RingBuffer &operator=(RingBuffer &&) = delete;
+
+	// Producer side
+	void append(const std::string &data) override;
+	void append(const char *data, uint64_t len) override;
+
+	// Consumer side
+	std::string read_all() override;
+	std::string read_line() override;
+	// Lines are copied once into consumer-owned storage, views stay valid until
+	// the next call from the consumer thread
+	size_t drain_lines(const LineCallback &callback) override;
+
+	// Consumer side: discard everything currently buffered
+	void clear() override;
+	bool empty() const override;
+	uint64_t buffered_bytes() const override;
+
+	uint64_t dropped_bytes() const override;
+	void set_closed(bool closed) override;
+
+	uint64_t capacity() const {
+		return capacity_;
+	}
+	OverflowPolicy policy() const {
+		return policy_;
+	}
+	// Number of times the producer had to drop data or wait for space
+	uint64_t overflow_count() const;
+
+private:
+	// Copy [from, to) (absolute positions) out of the ring into out
+	void copy_out(uint64_t from, uint64_t to, std::string &out) const;
+	// Find '\n' in [from, to), return absolute position or to if not found
+	uint64_t find_newline(uint64_t from, uint64_t to) const;
+	// Find the last '\n' in [from, to), return absolute position or to if not found
+	uint64_t rfind_newline(uint64_t from, uint64_t to) const;
+	// Try to publish a new read position, fails if the producer dropped data meanwhile
+	bool commit_read(uint64_t expected_tail, uint64_t new_tail);
+	// Make room for len bytes according to the policy, return false if closed
+	bool reserve(uint64_t head, uint64_t len);
+
+	const uint64_t capacity_;
+	const uint64_t mask_;
+	const OverflowPolicy policy_;
+	std::unique_ptr<char[]> data_;
+
+	// Absolute write/read positions, they only ever grow
+	alignas(64) std::atomic<uint64_t> head_ { 0 };
+	alignas(64) std::atomic<uint64_t> tail_ { 0 };
+
+	alignas(64) std::atomic<uint64_t> dropped_bytes_ { 0 };
+	std::atomic<uint64_t> overflow_count_ { 0 };
+
+	// Slow path for BLOCK: producer parks here until the consumer frees space
+	std::atomic<bool> producer_waiting_ { false };
+	std::atomic<bool> closed_ { false };
+	std::mutex space_mutex_;
+	std::condition_variable space_cv_;
+
+	// Consumer-owned scratch storage for drain_lines
+	std::string drain_buffer_;
+};
+
+}
+
+#endif
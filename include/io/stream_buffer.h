@@ -0,0 +1,54 @@
+#ifndef DREAMLAND_LOGGER_INCLUDE_IO_STREAM_BUFFER_H
+#define DREAMLAND_LOGGER_INCLUDE_IO_STREAM_BUFFER_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace dl {
+
+// Common interface of the byte buffers sitting between a child process pipe
+// (single producer) and its log consumer (single consumer)
+class StreamBuffer {
+public:
+	using LineCallback = std::function<void(std::string_view)>;
+
+	StreamBuffer() = default;
+	virtual ~StreamBuffer() = default;
+	// Constructors that be banned.
+	StreamBuffer(const StreamBuffer &) = delete;
+	StreamBuffer &operator=(const StreamBuffer &) = delete;
+
+	// Append data to the end of buffer
+	virtual void append(const std::string &data) = 0;
+	virtual void append(const char *data, uint64_t len) = 0;
+
+	// Read all unread content and move read position to end
+	virtual std::string read_all() = 0;
+	// Read one line ending with '\n', return empty if no complete line
+	virtual std::string read_line() = 0;
+	// Hand every complete buffered line (without the trailing '\n') to callback,
+	// return the number of lines delivered
+	virtual size_t drain_lines(const LineCallback &callback) = 0;
+
+	// Clear the buffer and reset read position
+	virtual void clear() = 0;
+	// Check if buffer has unread data
+	virtual bool empty() const = 0;
+	// Number of unread bytes
+	virtual uint64_t buffered_bytes() const = 0;
+
+	// Total bytes discarded because of the overflow policy
+	virtual uint64_t dropped_bytes() const {
+		return 0;
+	}
+	// While closed, a producer waiting for free space gives up instead of blocking
+	virtual void set_closed(bool closed) {
+		(void)closed;
+	}
+};
+
+}
+
+#endif
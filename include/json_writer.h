@@ -0,0 +1,142 @@
+#ifndef DREAMLAND_LOGGER_INCLUDE_JSON_WRITER_H
+#define DREAMLAND_LOGGER_INCLUDE_JSON_WRITER_H
+
+#include <charconv>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace dl {
+
+// 流式 JSON 写入器
+// 直接追加到一个预留好容量的 std::string，逗号由写入器自动处理；
+// 字符串转义按 8 字节一组检查（SWAR），不含需转义字符的片段整段拷贝
+// 不校验调用顺序，由调用方保证 key/value 成对出现
+class JsonWriter {
+public:
+	explicit JsonWriter(size_t reserve = 256) {
+		out_.reserve(reserve);
+	}
+
+	JsonWriter &begin_object() {
+		separator();
+		out_ += '{';
+		need_comma_ = false;
+		return *this;
+	}
+
+	JsonWriter &end_object() {
+		out_ += '}';
+		need_comma_ = true;
+		return *this;
+	}
+
+	JsonWriter &begin_array() {
+		separator();
+		out_ += '[';
+		need_comma_ = false;
+		return *this;
+	}
+
+	JsonWriter &end_array() {
+		out_ += ']';
+		need_comma_ = true;
+		return *this;
+	}
+
+	// 写入键名，之后必须紧跟一个值
+	JsonWriter &key(std::string_view name) {
+		separator();
+		out_ += '"';
+		escape_to(out_, name);
+		out_ += "\":";
+		need_comma_ = false;
+		return *this;
+	}
+
+	JsonWriter &value(std::string_view s) {
+		separator();
+		out_ += '"';
+		escape_to(out_, s);
+		out_ += '"';
+		need_comma_ = true;
+		return *this;
+	}
+
+	JsonWriter &value(const std::string &s) {
+		return value(std::string_view(s));
+	}
+
+	JsonWriter &value(const char *s) {
+		return value(std::string_view(s));
+	}
+
+	JsonWriter &value(bool b) {
+		separator();
+		out_ += b ? "true" : "false";
+		need_comma_ = true;
+		return *this;
+	}
+
+	template <typename T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>, int> = 0>
+	JsonWriter &value(T n) {
+		separator();
+		char buf[24];
+		auto result = std::to_chars(buf, buf + sizeof(buf), n);
+		out_.append(buf, result.ptr);
+		need_comma_ = true;
+		return *this;
+	}
+
+	JsonWriter &null() {
+		separator();
+		out_ += "null";
+		need_comma_ = true;
+		return *this;
+	}
+
+	// 写入已经序列化好的 JSON 片段
+	JsonWriter &raw(std::string_view json) {
+		separator();
+		out_ += json;
+		need_comma_ = true;
+		return *this;
+	}
+
+	// key(name).value(v) 的简写
+	template <typename T>
+	JsonWriter &field(std::string_view name, const T &v) {
+		key(name);
+		return value(v);
+	}
+
+	const std::string &str() const {
+		return out_;
+	}
+
+	// 取走结果，写入器随后可以重新使用
+	std::string take() {
+		std::string result = std::move(out_);
+		out_.clear();
+		need_comma_ = false;
+		return result;
+	}
+
+	// 将 s 转义后追加到 out（不含两侧引号）
+	static void escape_to(std::string &out, std::string_view s);
+
+private:
+	void separator() {
+		if (need_comma_) {
+			out_ += ',';
+		}
+	}
+
+	std::string out_;
+	bool need_comma_ = false;
+};
+
+} // namespace dl
+
+#endif // DREAMLAND_LOGGER_INCLUDE_JSON_WRITER_H
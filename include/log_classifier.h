@@ -0,0 +1,51 @@
+#ifndef DREAMLAND_LOGGER_INCLUDE_LOG_CLASSIFIER_H
+#define DREAMLAND_LOGGER_INCLUDE_LOG_CLASSIFIER_H
+
+#include <aho_corasick.h>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace dl {
+
+// 日志事件类型
+enum class LogEventType : uint8_t {
+	NONE,
+	PLAYER_JOIN,
+	PLAYER_LEAVE,
+	PLAYER_COMMAND,
+	PLAYER_CHAT
+};
+
+// "join"/"leave"/"command"/"chat"，NONE 返回空字符串
+const char *log_event_type_name(LogEventType type);
+
+// 单行日志的分类结果
+// 所有字段都是指向 classify 的 scratch 参数的视图，scratch 被修改或销毁后失效
+struct LogLineView {
+	LogEventType type = LogEventType::NONE;
+	// PLAYER_COMMAND 中 [xxx: ...] 形式的玩家操作行（F3+F4等）为 true，/指令为 false
+	bool is_operation = false;
+	std::string_view line; // 去除 ANSI 转义序列后的整行
+	std::string_view content; // "]: " 之后的正文
+	std::string_view player; // 玩家名（操作行需要调用方自行在 content 中查找）
+	std::string_view detail; // 加入: 客户端信息; 指令: '/'之后的指令; 操作: 方括号内的内容; 聊天: 消息内容
+};
+
+// 日志行分类器
+// 在一次遍历中同时完成 ANSI 转义序列的去除和所有关键字的定位，绝大多数与玩家无关的行在这一遍之后即可直接排除
+class LogClassifier {
+public:
+	LogClassifier();
+
+	// @param raw_line: 原始日志行（可以带结尾的 \r\n）
+	// @param scratch: 用于存放去除 ANSI 后内容的缓冲区，可在多次调用间复用
+	LogLineView classify(std::string_view raw_line, std::string &scratch) const;
+
+private:
+	AhoCorasick patterns_;
+};
+
+} // namespace dl
+
+#endif // DREAMLAND_LOGGER_INCLUDE_LOG_CLASSIFIER_H
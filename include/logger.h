@@ -0,0 +1,177 @@
+#ifndef DREAMLAND_LOGGER_INCLUDE_LOGGER_H
+#define DREAMLAND_LOGGER_INCLUDE_LOGGER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <metrics.h>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace dl {
+
+// 日志级别，DEBUG/INFO 写到标准输出，WARN/ERROR 写到标准错误
+enum class LogLevel : uint8_t {
+	DEBUG,
+	INFO,
+	WARN,
+	ERROR
+};
+
+// "debug"/"info"/"warn"/"error"
+// @return: 是否解析成功
+bool parse_log_level(std::string_view text, LogLevel &out);
+
+// 异步控制台日志
+// 任意线程提交的日志进入无锁的多生产者单消费者队列，由后台线程成批写出，提交方从不等待终端或 journald；
+// 积压超过 MAX_PENDING 条时直接丢弃新日志并计数，而不是阻塞或无限占用内存
+class Logger {
+public:
+	// 积压上限
+	static constexpr size_t MAX_PENDING = 1 << 16;
+	// 单次 write 的最大字节数
+	static constexpr size_t MAX_BATCH_BYTES = 64 << 10;
+
+	// 进程内共享的日志器，进程退出时写完剩余日志
+	static Logger &global();
+
+	Logger();
+	// 写完已提交的日志后停止写线程
+	~Logger();
+
+	Logger(const Logger &) = delete;
+	Logger &operator=(const Logger &) = delete;
+
+	void set_level(LogLevel level) {
+		level_.store(level, std::memory_order_relaxed);
+	}
+	bool enabled(LogLevel level) const {
+		return level >= level_.load(std::memory_order_relaxed);
+	}
+
+	// 是否输出 MC 服务器中与玩家无关的原始输出行（默认输出）
+	void set_passthrough(bool enabled) {
+		passthrough_.store(enabled, std::memory_order_relaxed);
+	}
+	bool passthrough_enabled() const {
+		return passthrough_.load(std::memory_order_relaxed);
+	}
+
+	// 提交一条日志（不含换行），不阻塞
+	void log(LogLevel level, std::string text);
+	// 提交一行 MC 服务器原始输出，关闭转发时直接返回
+	void passthrough(std::string_view line);
+
+	// 等待此前提交的日志全部写出
+	void flush();
+
+	// 因积压被丢弃的日志条数
+	uint64_t dropped() const {
+		return dropped_.value();
+	}
+
+private:
+	struct Node {
+		std::atomic<Node *> next { nullptr };
+		LogLevel level = LogLevel::INFO;
+		std::string text;
+	};
+
+	// Vyukov 无锁队列：生产者只交换 head_，消费者独占 tail_，stub_ 用于队列为空时占位
+	void push(Node *node);
+	// 只能由写线程调用，队列为空或生产者尚未完成链接时返回 nullptr
+	Node *pop();
+
+	void writer_func();
+	// 写出一批，返回写出的条数
+	size_t write_batch();
+
+	std::atomic<LogLevel> level_ { LogLevel::INFO };
+	std::atomic<bool> passthrough_ { true };
+
+	alignas(64) std::atomic<Node *> head_;
+	alignas(64) Node *tail_;
+	Node stub_;
+
+	std::atomic<size_t> pending_ { 0 };
+	std::atomic<uint64_t> submitted_ { 0 }; // 已入队的条数
+	std::atomic<uint64_t> written_ { 0 }; // 已写出（或丢弃）的条数
+
+	// 写线程空闲时在 wake_cv_ 上睡眠，生产者只在它睡眠时才加锁唤醒
+	std::mutex wake_mutex_;
+	std::condition_variable wake_cv_;
+	std::atomic<bool> writer_waiting_ { false };
+	std::condition_variable flushed_cv_;
+	std::atomic<bool> stop_ { false };
+
+	std::string out_batch_;
+	std::string err_batch_;
+
+	Counter &lines_;
+	Counter &dropped_;
+
+	std::thread writer_;
+};
+
+// 流式拼接一条日志，析构时提交；级别未启用时不做任何拼接
+//   log_info() << "[WebServer] 启动在端口 " << port;
+class LogLine {
+public:
+	explicit LogLine(LogLevel level)
+		: level_(level)
+		, enabled_(Logger::global().enabled(level)) {
+	}
+	~LogLine() {
+		if (enabled_) {
+			Logger::global().log(level_, std::move(text_));
+		}
+	}
+	LogLine(const LogLine &) = delete;
+	LogLine &operator=(const LogLine &) = delete;
+
+	template <typename T>
+	LogLine &operator<<(const T &value) {
+		if (!enabled_) {
+			return *this;
+		}
+		if constexpr (std::is_same_v<T, char>) {
+			text_ += value;
+		} else if constexpr (std::is_convertible_v<const T &, std::string_view>) {
+			text_ += std::string_view(value);
+		} else if constexpr (std::is_integral_v<T> || std::is_floating_point_v<T>) {
+			text_ += std::to_string(value);
+		} else {
+			std::ostringstream stream;
+			stream << value;
+			text_ += stream.str();
+		}
+		return *this;
+	}
+
+private:
+	LogLevel level_;
+	bool enabled_;
+	std::string text_;
+};
+
+inline LogLine log_debug() {
+	return LogLine(LogLevel::DEBUG);
+}
+inline LogLine log_info() {
+	return LogLine(LogLevel::INFO);
+}
+inline LogLine log_warn() {
+	return LogLine(LogLevel::WARN);
+}
+inline LogLine log_error() {
+	return LogLine(LogLevel::ERROR);
+}
+
+}
+
+#endif
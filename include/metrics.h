@@ -0,0 +1,189 @@
+#ifndef DREAMLAND_LOGGER_INCLUDE_METRICS_H
+#define DREAMLAND_LOGGER_INCLUDE_METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace dl {
+
+// 指标的标签，按给定顺序输出
+using MetricLabels = std::vector<std::pair<std::string, std::string>>;
+
+// 计数器和直方图按线程分片：每个线程固定写自己的分片（独占缓存行），
+// 热路径上只有一次无竞争的 relaxed 原子加，抓取时再把所有分片加总
+constexpr size_t METRIC_SHARDS = 16;
+
+// 当前线程使用的分片下标
+size_t metric_shard();
+
+// 单调递增的计数器
+class Counter {
+public:
+	Counter() = default;
+	Counter(const Counter &) = delete;
+	Counter &operator=(const Counter &) = delete;
+
+	void inc(uint64_t n = 1) {
+		shards_[metric_shard()].value.fetch_add(n, std::memory_order_relaxed);
+	}
+	uint64_t value() const;
+
+private:
+	struct alignas(64) Shard {
+		std::atomic<uint64_t> value { 0 };
+	};
+	Shard shards_[METRIC_SHARDS];
+};
+
+// 耗时直方图，以纳秒记录，输出时换算为秒
+class Histogram {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	// 默认桶上界：1us 到 10s，按 1-2.5-5 递增
+	static const std::vector<double> &default_bounds();
+
+	// @param bounds: 升序排列的桶上界（秒），最后隐含 +Inf
+	explicit Histogram(const std::vector<double> &bounds = default_bounds());
+	Histogram(const Histogram &) = delete;
+	Histogram &operator=(const Histogram &) = delete;
+
+	void observe(Clock::duration elapsed);
+	void observe_seconds(double seconds);
+
+	struct Snapshot {
+		std::vector<double> bounds;
+		std::vector<uint64_t> cumulative; // 与 bounds 对应，末尾多一个 +Inf
+		uint64_t count = 0;
+		double sum = 0; // 秒
+	};
+	Snapshot snapshot() const;
+
+private:
+	void observe_ns(uint64_t ns);
+
+	struct alignas(64) Shard {
+		std::unique_ptr<std::atomic<uint64_t>[]> buckets; // bounds_ns_.size() + 1 个
+		std::atomic<uint64_t> sum_ns { 0 };
+	};
+
+	std::vector<double> bounds_;
+	std::vector<uint64_t> bounds_ns_;
+	Shard shards_[METRIC_SHARDS];
+};
+
+// 作用域计时：析构时把存活时间记入直方图
+class ScopedTimer {
+public:
+	explicit ScopedTimer(Histogram &histogram)
+		: histogram_(histogram)
+		, start_(Histogram::Clock::now()) {
+	}
+	~ScopedTimer() {
+		histogram_.observe(Histogram::Clock::now() - start_);
+	}
+	ScopedTimer(const ScopedTimer &) = delete;
+	ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+	Histogram &histogram_;
+	Histogram::Clock::time_point start_;
+};
+
+// 记录加锁等待时间的互斥锁，可直接用于 std::lock_guard
+// 无竞争时 try_lock 立即成功，只记一次 0 等待，不读时钟
+class TimedMutex {
+public:
+	// 等待时间记入全局注册表的 dreamland_lock_wait_seconds{lock="<name>"}
+	explicit TimedMutex(const std::string &name);
+	TimedMutex(const TimedMutex &) = delete;
+	TimedMutex &operator=(const TimedMutex &) = delete;
+
+	void lock() {
+		if (mutex_.try_lock()) {
+			wait_.observe(Histogram::Clock::duration::zero());
+			return;
+		}
+		auto start = Histogram::Clock::now();
+		mutex_.lock();
+		wait_.observe(Histogram::Clock::now() - start);
+	}
+	bool try_lock() {
+		return mutex_.try_lock();
+	}
+	void unlock() {
+		mutex_.unlock();
+	}
+
+private:
+	std::mutex mutex_;
+	Histogram &wait_;
+};
+
+// 指标注册表，输出 Prometheus 文本格式
+// 计数器和直方图注册后一直存在，返回的引用可以长期保存（通常在首次使用时存入静态变量或成员）；
+// 同名同标签重复注册返回同一个对象
+// 回调指标在抓取时求值，所有者销毁前必须 remove_callback；回调在注册表锁内执行，不能再访问注册表
+class MetricsRegistry {
+public:
+	using CallbackId = uint64_t;
+
+	enum class Type {
+		COUNTER,
+		GAUGE,
+		HISTOGRAM
+	};
+
+	// 进程内共享的注册表
+	static MetricsRegistry &global();
+
+	MetricsRegistry() = default;
+	MetricsRegistry(const MetricsRegistry &) = delete;
+	MetricsRegistry &operator=(const MetricsRegistry &) = delete;
+
+	Counter &counter(const std::string &name, const std::string &help, const MetricLabels &labels = {});
+	Histogram &histogram(const std::string &name, const std::string &help, const MetricLabels &labels = {},
+		const std::vector<double> &bounds = Histogram::default_bounds());
+
+	// 注册抓取时求值的计数器或仪表
+	// @return: 注销用的 ID，从 1 开始
+	CallbackId add_callback(Type type, const std::string &name, const std::string &help,
+		const MetricLabels &labels, std::function<double()> value);
+	void remove_callback(CallbackId id);
+
+	// 按指标名排序输出所有指标
+	std::string render() const;
+
+private:
+	struct Series {
+		std::string labels; // 已格式化的 k="v",... 不含花括号
+		std::unique_ptr<Counter> counter;
+		std::unique_ptr<Histogram> histogram;
+		CallbackId callback_id = 0;
+		std::function<double()> callback;
+	};
+
+	struct Family {
+		Type type = Type::COUNTER;
+		std::string help;
+		std::vector<Series> series;
+	};
+
+	Family &family_locked(const std::string &name, const std::string &help, Type type);
+
+	mutable std::mutex mutex_;
+	std::map<std::string, Family> families_;
+	CallbackId next_callback_id_ = 1;
+};
+
+}
+
+#endif
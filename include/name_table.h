@@ -0,0 +1,51 @@
+#ifndef DREAMLAND_LOGGER_INCLUDE_NAME_TABLE_H
+#define DREAMLAND_LOGGER_INCLUDE_NAME_TABLE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace dl {
+
+// 名字驻留表：每个不同的名字只保存一份，以 32 位编号引用
+// 编号从 1 开始连续分配且永不回收，0 表示空名字；名字按固定大小的块存放，
+// 已分配的名字地址不变，name() 只做原子读取，不加锁，可与 intern() 并发调用
+class NameTable {
+public:
+	using Id = uint32_t;
+
+	NameTable();
+	~NameTable();
+
+	NameTable(const NameTable &) = delete;
+	NameTable &operator=(const NameTable &) = delete;
+
+	// 返回名字的编号，首次出现时分配新编号；空名字或表已满返回 0
+	Id intern(std::string_view name);
+
+	// 编号对应的名字，未知编号返回空视图；视图在本对象销毁前一直有效
+	std::string_view name(Id id) const;
+
+	// 已分配的名字数量
+	size_t size() const {
+		return size_.load(std::memory_order_acquire);
+	}
+
+private:
+	static constexpr size_t CHUNK_SIZE = 4096;
+	static constexpr size_t MAX_CHUNKS = 4096;
+
+	std::unique_ptr<std::string[]> chunks_[MAX_CHUNKS];
+	std::atomic<size_t> size_ { 0 };
+
+	std::mutex mutex_; // 串行化 intern
+	std::unordered_map<std::string_view, Id> ids_; // 视图指向 chunks_ 中的名字
+};
+
+} // namespace dl
+
+#endif // DREAMLAND_LOGGER_INCLUDE_NAME_TABLE_H
@@ -0,0 +1,75 @@
+#ifndef DREAMLAND_LOGGER_INCLUDE_PLAYER_INDEX_H
+#define DREAMLAND_LOGGER_INCLUDE_PLAYER_INDEX_H
+
+#include <aho_corasick.h>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace dl {
+
+// 玩家名索引，用于在一行文本中找出最早出现的已知玩家名
+// 所有玩家名编译为一个 Aho-Corasick 自动机，一次扫描即可得到结果
+// 读操作通过原子地获取不可变快照完成（RCU 风格），不需要任何锁，也不会被写操作阻塞
+// 新玩家先放入快照的增量列表，增量积累到一定数量后由调用方在不持有自身锁时调用 rebuild() 合并进自动机
+class PlayerNameIndex {
+public:
+	// 自动机部分，构建后不再修改
+	struct Base {
+		std::vector<std::string> names;
+		AhoCorasick automaton;
+		// 哈希集合，用于 O(1) 判断玩家是否存在（视图指向 names）
+		std::unordered_set<std::string_view> name_set;
+		std::unordered_set<std::string> lower_name_set; // ASCII 小写形式
+	};
+
+	// 某一时刻的索引快照
+	struct Snapshot {
+		std::shared_ptr<const Base> base;
+		std::vector<std::string> recent; // 上次重建后新增的玩家
+		uint64_t version = 0; // 每次发布新快照递增
+	};
+
+	// 增量列表达到该长度时需要重建自动机
+	static constexpr size_t REBUILD_THRESHOLD = 64;
+
+	PlayerNameIndex();
+
+	PlayerNameIndex(const PlayerNameIndex &) = delete;
+	PlayerNameIndex &operator=(const PlayerNameIndex &) = delete;
+
+	// 用给定的玩家名重建整个索引
+	void reset(std::vector<std::string> names);
+
+	// 添加一个新玩家，调用方需保证该玩家之前不在索引中；只追加到增量列表，不会重建自动机
+	// @return: 增量列表已达到 REBUILD_THRESHOLD 且尚无重建在进行，调用方应随后调用 rebuild()
+	bool insert(const std::string &name);
+
+	// 把增量列表合并进自动机，构建期间不持有写锁，其间的 insert 照常进行并保留在新快照的增量列表中
+	// 构建耗时与玩家总数成正比，不要在持有其他锁时调用
+	void rebuild();
+
+	// 判断玩家是否存在，case_insensitive 为 true 时忽略 ASCII 大小写
+	bool contains(std::string_view name, bool case_insensitive = false) const;
+
+	// 查找文本中最早出现的玩家名（位置相同时取较长者），没有则返回空串
+	std::string find_earliest(std::string_view text) const;
+
+	// 获取当前快照
+	std::shared_ptr<const Snapshot> snapshot() const;
+
+private:
+	static std::shared_ptr<const Base> build_base(std::vector<std::string> names);
+
+	std::shared_ptr<const Snapshot> current_; // 只通过 std::atomic_load/atomic_store 访问
+	std::mutex write_mutex_; // 串行化写操作
+	bool rebuilding_ = false; // 是否已有 rebuild() 在进行，由 write_mutex_ 保护
+};
+
+} // namespace dl
+
+#endif // DREAMLAND_LOGGER_INCLUDE_PLAYER_INDEX_H
@@ -3,12 +3,20 @@
 
 #include <atomic>
 #include <chrono>
-#include <condition_variable>
 #include <cstdint>
+#include <forbidden_matcher.h>
+#include <functional>
+#include <io/journal.h>
 #include <io/program.h>
+#include <log_classifier.h>
+#include <memory>
+#include <metrics.h>
 #include <mutex>
+#include <name_table.h>
+#include <player_index.h>
 #include <string>
-#include <thread>
+#include <string_view>
+#include <timer_queue.h>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -20,6 +28,7 @@ struct OnlinePlayerInfo {
 	std::string name;
 	std::chrono::system_clock::time_point join_time;
 	std::string client_info;
+	std::string server; // 所在的服务器实例
 };
 
 // 被封禁玩家信息
@@ -33,21 +42,6 @@ struct BannedPlayerInfo {
 	std::string get_unban_time_string() const;
 };
 
-// 禁止指令信息
-struct ForbiddenCommand {
-	std::string command;
-	uint64_t ban_hours;
-};
-
-// 日志事件类型
-enum class LogEventType {
-	NONE,
-	PLAYER_JOIN,
-	PLAYER_LEAVE,
-	PLAYER_COMMAND,
-	PLAYER_CHAT
-};
-
 // 日志事件
 struct LogEvent {
 	LogEventType type = LogEventType::NONE;
@@ -57,18 +51,45 @@ struct LogEvent {
 	std::chrono::system_clock::time_point timestamp;
 };
 
+// 玩家状态变化类型
+enum class PlayerChange {
+	JOIN,
+	LEAVE,
+	BAN,
+	PARDON
+};
+
+// 玩家状态变化回调，在修改完成并释放锁之后调用
+// @param detail: JOIN 时为客户端信息，BAN 时为封禁原因，其他为空
+using PlayerChangeCallback = std::function<void(PlayerChange change, const std::string &player, const std::string &detail)>;
+
+// 在线玩家快照（不可变，读取时无需加锁）
+struct OnlineSnapshot {
+	uint64_t version = 0; // 每次变化递增
+	std::unordered_map<std::string, OnlinePlayerInfo> players;
+};
+
+// 被封禁玩家快照（不可变，读取时无需加锁）
+struct BannedSnapshot {
+	uint64_t version = 0; // 每次变化递增
+	std::unordered_map<std::string, BannedPlayerInfo> players;
+};
+
 class PlayerList {
 public:
+	// @param timers: 共享的定时任务队列（限时封禁到期解封），为空时自行创建；需比本对象存活更久
 	PlayerList(const std::string &player_file,
 		const std::string &banned_file,
 		const std::string &forbidden_cmd_file,
-		const Program &program);
+		const Program &program,
+		TimerQueue *timers = nullptr);
 	~PlayerList();
 
 	PlayerList(const PlayerList &) = delete;
 	PlayerList &operator=(const PlayerList &) = delete;
 
-	LogEvent process_log_line(const std::string &log_line);
+	// @param server: 日志所属的服务器实例；玩家在实例间切换时，只有当前所在实例的离开事件才会使其下线
+	LogEvent process_log_line(std::string_view log_line, std::string_view server = {});
 
 	bool ban(const std::string &player, const std::string &reason, uint64_t banned_hours);
 	bool pardon(const std::string &player);
@@ -77,35 +98,93 @@ public:
 	std::vector<std::string> list_banned_player() const;
 	std::vector<OnlinePlayerInfo> list_online_player() const;
 
+	// 哈希判断玩家是否出现过，耗时与历史玩家数量无关
+	bool has_player(const std::string &player, bool case_insensitive = false) const;
 	bool is_banned(const std::string &player) const;
 	bool is_online(const std::string &player) const;
+	// 将当前状态压缩写入 players.list/banned.list 并清空日志
 	bool save() const;
 
 	// 在 PlayerList 类中添加:
 	std::vector<BannedPlayerInfo> list_banned_player_info() const;
 
-	void set_program(const Program &program);
+	// 获取当前的不可变快照，不加锁、不拷贝容器，适合 Web 接口等高频读取
+	// 封禁名单在变更后首次读取时才发布新快照（此时短暂加锁并复制一次），连续多次封禁只复制一次
+	std::shared_ptr<const OnlineSnapshot> online_snapshot() const;
+	std::shared_ptr<const BannedSnapshot> banned_snapshot() const;
+	std::shared_ptr<const PlayerNameIndex::Snapshot> player_snapshot() const;
+
+	// 添加一个服务器实例，封禁/解封指令会发送到所有实例（需在开始处理日志前调用）
+	void add_program(const Program &program);
+
+	// 玩家名驻留表，日志缓存等以编号引用玩家名，编号在进程内稳定
+	NameTable &names() {
+		return names_;
+	}
+	const NameTable &names() const {
+		return names_;
+	}
+
+	// 设置玩家状态变化回调（需在开始处理日志前设置）
+	void set_change_callback(PlayerChangeCallback callback);
 
 private:
 	void load_files();
-	void save_files() const;
-	void ban_checker_thread_func();
+	// 写出完整快照文件，由 journal 压缩时在其写线程上调用
+	bool save_files() const;
+	// 用 banned_players_ 发布新的封禁快照（需持有 mutex_）
+	void publish_banned_locked() const;
+	// 追加式变更日志: <player_file>.journal
+	std::string journal_file() const;
+	// 所有 MC 服务器都未运行时自动解封的重试间隔
+	static constexpr std::chrono::seconds UNBAN_RETRY_INTERVAL { 30 };
+
+	// 在 unban_time 登记解封定时器，替换该玩家原有的定时器（需持有 mutex_）
+	void schedule_unban_locked(const BannedPlayerInfo &info);
+	// 解封定时器到期时调用，due 为该定时器登记的到期时间
+	// 定时器已被替换（出队后才被取消）或封禁尚未到期时不做任何事
+	void auto_unban(const std::string &player, std::chrono::system_clock::time_point due);
+	// 从封禁名单删除玩家、写变更日志并取消解封定时器，未被封禁时返回 false（需持有 mutex_）
+	bool remove_ban_locked(const std::string &player);
+	// 向所有服务器实例发送指令
+	void broadcast_command(const std::string &command);
 
 	std::string player_file_;
 	std::string banned_file_;
 	std::string forbidden_file_;
-	const Program &program_;
+	std::vector<const Program *> programs_; // 构造时传入的实例与 add_program 添加的实例
 
 	std::unordered_set<std::string> all_players_;
-	std::unordered_map<std::string, OnlinePlayerInfo> online_players_;
-	std::unordered_map<std::string, BannedPlayerInfo> banned_players_;
-	std::vector<ForbiddenCommand> forbidden_commands_;
-
-	mutable std::mutex mutex_;
-	std::thread checker_thread_;
-	std::atomic<bool> stop_checker_ { false };
-	std::condition_variable checker_cv_;
-	std::mutex checker_mutex_;
+	// 玩家名索引，与 all_players_ 同步更新，读取时无需持有 mutex_
+	PlayerNameIndex name_index_;
+	NameTable names_;
+	// 在线/封禁玩家以不可变快照保存，写入方在 mutex_ 下复制并原子替换，读取方直接原子获取
+	// 封禁快照延迟到下次读取时发布，见 banned_snapshot()
+	std::shared_ptr<const OnlineSnapshot> online_;
+	mutable std::shared_ptr<const BannedSnapshot> banned_;
+	mutable std::atomic<bool> banned_dirty_ { false }; // banned_players_ 有尚未发布的修改
+	// 禁止指令匹配器，在 load_files 中编译，之后只读，匹配时无需加锁
+	ForbiddenCommandMatcher forbidden_matcher_;
+
+	LogClassifier classifier_;
+
+	PlayerChangeCallback change_callback_;
+
+	// 玩家加入、封禁、解封只追加一条记录，由后台线程批量 fsync 并定期压缩回快照文件
+	std::unique_ptr<Journal> journal_;
+
+	std::unique_ptr<TimerQueue> own_timers_; // 未传入共享队列时自行创建
+	TimerQueue *timers_;
+
+	mutable TimedMutex mutex_ { "player_list" };
+	// 以下由 mutex_ 保护
+	struct UnbanTimer {
+		TimerQueue::TimerId id;
+		std::chrono::system_clock::time_point due; // 用于识别过时的定时器回调
+	};
+	std::unordered_map<std::string, UnbanTimer> unban_timers_; // 限时封禁的玩家 -> 解封定时器
+	std::unordered_map<std::string, BannedPlayerInfo> banned_players_; // 封禁名单，banned_ 是它的已发布副本
+	bool stopping_ = false; // 析构中，不再登记定时器
 };
 
 } // namespace dl
@@ -0,0 +1,63 @@
+#ifndef DREAMLAND_LOGGER_INCLUDE_RATE_LIMITER_H
+#define DREAMLAND_LOGGER_INCLUDE_RATE_LIMITER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace dl {
+
+// 按键（客户端 IP）限流的令牌桶
+// 每个键最多积攒 burst 个令牌，每分钟恢复 per_minute 个；令牌已满的键没有状态可言，
+// 表过大时将其删除，因此内存只与最近活跃的键数有关
+class RateLimiter {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	// @param per_minute: 每分钟恢复的令牌数，0 表示不限流
+	// @param burst: 令牌上限，至少为 1
+	RateLimiter(double per_minute, double burst);
+
+	RateLimiter(const RateLimiter &) = delete;
+	RateLimiter &operator=(const RateLimiter &) = delete;
+
+	// 消耗 key 的一个令牌
+	// @param retry_after: 拒绝时写入需要等待的秒数（向上取整）
+	// @return: 是否允许
+	bool allow(std::string_view key, int *retry_after = nullptr);
+
+	bool enabled() const { return per_second_ > 0; }
+	double per_minute() const { return per_second_ * 60; }
+	double burst() const { return burst_; }
+	// 当前记录的键数
+	size_t tracked() const;
+	// 被拒绝的总次数
+	uint64_t rejected() const { return rejected_.load(std::memory_order_relaxed); }
+
+private:
+	struct Bucket {
+		double tokens = 0;
+		Clock::time_point updated;
+	};
+
+	// 删除令牌已恢复满的键
+	void prune_locked(Clock::time_point now);
+
+	const double per_second_;
+	const double burst_;
+
+	mutable std::mutex mutex_;
+	std::unordered_map<std::string, Bucket> buckets_;
+	size_t prune_at_ = MIN_PRUNE_SIZE; // 表达到该大小时清理一次
+	std::atomic<uint64_t> rejected_ { 0 };
+
+	static constexpr size_t MIN_PRUNE_SIZE = 1024;
+};
+
+}
+
+#endif
@@ -3,25 +3,47 @@
 
 #include <atomic>
 #include <chrono>
-#include <deque>
+#include <cstdint>
+#include <functional>
 #include <io/program.h>
+#include <log_classifier.h>
+#include <memory>
+#include <metrics.h>
 #include <mutex>
+#include <name_table.h>
 #include <player_list.h>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <vector>
 
 namespace dl {
 
-// 日志条目（用于缓存）
+// 日志条目（用于缓存），只保存定长字段，字符串在序列化时才生成
+// 玩家名以 PlayerList::names() 的编号保存，正文保存在日志正文区中
 struct ServerLogEntry {
-	std::string timestamp;
-	std::string type; // "join", "leave", "command", "chat"
-	std::string player;
-	std::string content;
-	std::chrono::system_clock::time_point time_point;
+	std::chrono::system_clock::time_point time; // 日志行中的时间
+	uint64_t content_offset = 0; // 正文在正文区中的逻辑偏移，单调递增
+	uint32_t content_len = 0;
+	NameTable::Id player_id = 0;
+	LogEventType type = LogEventType::NONE;
 };
 
+// 日志条目的只读视图，player/content 只在回调期间有效
+struct LogView {
+	uint64_t seq = 0; // 单调递增的序号，从 1 开始
+	LogEventType type = LogEventType::NONE;
+	std::chrono::system_clock::time_point time;
+	std::string_view player;
+	std::string_view content;
+};
+
+// 遍历日志的回调类型
+using LogVisitor = std::function<void(const LogView &log)>;
+
+// 新日志回调类型，在日志线程上调用
+using LogEntryCallback = std::function<void(const LogView &log)>;
+
 // OP 信息
 struct OpInfo {
 	std::string uuid;
@@ -36,10 +58,12 @@ public:
 	// 构造函数
 	// @param program: MC服务器
 	// @param ops_file: ops.json 文件路径
-	// @param player_list: 玩家列表管理器引用
+	// @param player_list: 玩家列表管理器引用，多个实例共用同一个
+	// @param name: 实例名称，用于区分玩家所在的实例
 	ServerManager(Program *program,
 		const std::string &ops_file,
-		PlayerList &player_list);
+		PlayerList &player_list,
+		const std::string &name = "");
 
 	~ServerManager();
 
@@ -47,7 +71,7 @@ public:
 	ServerManager(const ServerManager &) = delete;
 	ServerManager &operator=(const ServerManager &) = delete;
 
-	// 启动服务器
+	// 启动服务器并开始读取日志；program 已由调用方启动时只开始读取日志
 	bool start();
 
 	// 停止服务器
@@ -58,13 +82,24 @@ public:
 		return running_.load();
 	}
 
+	// 实例名称
+	const std::string &name() const {
+		return name_;
+	}
+
 	// 执行命令
 	// @param command: 命令内容（不需要以/开头）
 	void execute_command(const std::string &command);
 
-	// 获取日志缓存
-	// @param limit: 最大返回数量，0表示全部
-	std::vector<ServerLogEntry> get_logs(size_t limit = 0) const;
+	// 按序号升序访问序号大于 since 的日志，在日志锁内调用 visitor，返回访问的条数
+	// @param since: 客户端已有的最大序号，0表示从最早的缓存开始
+	// @param limit: 最大访问数量，0表示不限；超出时只访问最新的 limit 条
+	size_t visit_logs_since(uint64_t since, size_t limit, const LogVisitor &visitor) const;
+
+	// 日志缓存版本号，即最新一条日志的序号
+	uint64_t log_generation() const {
+		return last_log_seq_.load();
+	}
 
 	// 获取 OP 列表
 	std::vector<std::string> get_ops() const;
@@ -72,9 +107,21 @@ public:
 	// 获取 OP 详细信息
 	std::vector<OpInfo> get_ops_info() const;
 
+	// OP 列表版本号，每次加载 ops.json 递增
+	uint64_t ops_generation() const {
+		return ops_generation_.load();
+	}
+
 	// 重新加载 ops.json
 	void reload_ops();
 
+	// 设置新日志回调（需在 start 之前设置）
+	void set_log_entry_callback(LogEntryCallback callback);
+
+	// 处理单行日志（解析、缓存、输出），由日志线程调用；
+	// 未 start 时也可直接调用以回放日志（基准测试），但不能与日志线程并发
+	void handle_log_line(std::string_view line);
+
 private:
 	// 日志读取线程函数
 	void log_reader_thread_func();
@@ -83,31 +130,49 @@ private:
 	void load_ops();
 
 	// 解析 JSON 简单实现（仅用于解析 ops.json）
-	static std::vector<OpInfo> parse_ops_json(const std::string &json_content);
+	static std::vector<OpInfo> parse_ops_json(std::string_view json_content);
+
+	// 添加日志到缓存，正文复制到正文区，返回分配的序号
+	uint64_t add_log_entry(LogEventType type, std::chrono::system_clock::time_point time,
+		NameTable::Id player_id, std::string_view content);
 
-	// 添加日志到缓存
-	void add_log_entry(const ServerLogEntry &entry);
+	// 缓存中的日志视图（需持有 log_mutex_）
+	LogView view_locked(uint64_t seq) const;
 
 private:
-	std::string server_command_;
+	std::string name_;
 	std::string ops_file_;
 	PlayerList &player_list_;
 
 	Program *program_;
 	std::atomic<bool> running_ { false };
 
-	// 日志缓存
-	std::deque<ServerLogEntry> log_cache_;
+	// 日志缓存：固定大小的环形缓冲，序号为 seq 的日志位于 log_ring_[seq % MAX_LOG_CACHE]
+	// 正文依次追加到同样环形使用的 log_arena_ 中，单条正文不跨越末尾（放不下时从头开始）；
+	// 正文被后来的日志覆盖的条目不再返回，first_log_seq_ 为仍然有效的最早序号
+	static constexpr size_t MAX_LOG_CACHE = 100000;
+	static constexpr uint64_t LOG_ARENA_BYTES = 8 << 20;
+	static constexpr uint32_t MAX_LOG_CONTENT = 64 << 10; // 单条正文的最大长度，超出部分截断
+	std::vector<ServerLogEntry> log_ring_;
+	std::unique_ptr<char[]> log_arena_;
+	uint64_t log_arena_end_ = 0; // 正文区已写入的逻辑长度
+	uint64_t first_log_seq_ = 1;
 	mutable std::mutex log_mutex_;
-	static constexpr size_t MAX_LOG_CACHE = 1000;
+	std::atomic<uint64_t> last_log_seq_ { 0 };
+	LogEntryCallback log_entry_callback_;
 
 	// OP 列表
 	std::vector<OpInfo> ops_;
 	mutable std::mutex ops_mutex_;
+	std::atomic<uint64_t> ops_generation_ { 0 };
 
 	// 日志读取线程
 	std::thread log_thread_;
 	std::atomic<bool> stop_log_thread_ { false };
+
+	// 指标：本实例读取的行数，以及抓取时读取缓冲区状态的回调（析构时注销）
+	Counter &lines_read_;
+	std::vector<MetricsRegistry::CallbackId> metric_callbacks_;
 };
 
 } // namespace dl
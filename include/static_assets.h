@@ -0,0 +1,65 @@
+#ifndef DREAMLAND_LOGGER_INCLUDE_STATIC_ASSETS_H
+#define DREAMLAND_LOGGER_INCLUDE_STATIC_ASSETS_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+namespace dl {
+
+// 根据扩展名返回 Content-Type
+std::string mime_type_for(const std::string &path);
+
+// 单个静态资源，加载后不可变
+struct StaticAsset {
+	std::string content_type;
+	std::string cache_control;
+	std::string etag; // 原始内容的 ETag，压缩版本在此基础上加后缀
+	std::string identity; // 原始内容
+	std::string gzip; // gzip 压缩版本，为空表示不提供
+	std::string brotli; // brotli 压缩版本，为空表示不提供（未启用 brotli 时总是为空）
+};
+
+// 静态资源表
+// 启动时把 web_root 下的文件一次性读入内存并预先压缩，之后请求不再访问磁盘；
+// 资源表整体以不可变快照保存，重新加载时原子替换，读取无需加锁
+class StaticAssetTable {
+public:
+	explicit StaticAssetTable(const std::string &root);
+	~StaticAssetTable();
+
+	StaticAssetTable(const StaticAssetTable &) = delete;
+	StaticAssetTable &operator=(const StaticAssetTable &) = delete;
+
+	// 重新扫描目录并替换资源表
+	// @return: 加载的文件数
+	size_t reload();
+
+	// 按 URL 路径查找（如 "/script.js"），不存在返回 nullptr
+	std::shared_ptr<const StaticAsset> find(std::string_view url_path) const;
+
+	// 用 inotify 监控目录，文件变化时自动重新加载
+	bool start_watching();
+	void stop_watching();
+
+	// 是否编译了 brotli 支持
+	static bool has_brotli();
+
+private:
+	using Table = std::unordered_map<std::string, std::shared_ptr<const StaticAsset>>;
+
+	void watch_thread_func(int inotify_fd);
+
+	std::string root_;
+	std::shared_ptr<const Table> table_;
+
+	std::thread watch_thread_;
+	std::atomic<bool> stop_watch_ { false };
+};
+
+} // namespace dl
+
+#endif // DREAMLAND_LOGGER_INCLUDE_STATIC_ASSETS_H
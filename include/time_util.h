@@ -0,0 +1,35 @@
+#ifndef DREAMLAND_LOGGER_INCLUDE_TIME_UTIL_H
+#define DREAMLAND_LOGGER_INCLUDE_TIME_UTIL_H
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace dl {
+
+// 本地时间的格式化与解析，统一使用 "YYYY-MM-DD HH:MM:SS" 格式
+// 每个线程缓存当前本地日期（当天零点、日期前缀）和最近一次格式化的秒，
+// 同一天内的格式化只是几次 memcpy，不调用 localtime_r；当天有夏令时切换时退回 libc
+
+// 格式化结果的长度
+constexpr size_t TIME_STRING_LENGTH = 19;
+
+// 将 tp 格式化写入 out（至少 TIME_STRING_LENGTH 字节），返回写入的长度
+size_t format_local_time(std::chrono::system_clock::time_point tp, char *out);
+
+// 同上，返回字符串
+std::string format_local_time(std::chrono::system_clock::time_point tp);
+
+// 当前时间的格式化结果
+std::string current_time_string();
+
+// 解析 "YYYY-MM-DD HH:MM:SS"（本地时间），格式错误返回 false 且不修改 out
+bool parse_local_time(std::string_view s, std::chrono::system_clock::time_point &out);
+
+// 今天（本地日期）hour:minute:second 对应的时间点
+std::chrono::system_clock::time_point local_time_today(int hour, int minute, int second);
+
+} // namespace dl
+
+#endif // DREAMLAND_LOGGER_INCLUDE_TIME_UTIL_H
@@ -0,0 +1,68 @@
+#ifndef DREAMLAND_LOGGER_INCLUDE_TIMER_QUEUE_H
+#define DREAMLAND_LOGGER_INCLUDE_TIMER_QUEUE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace dl {
+
+// 定时任务队列
+// 所有定时器按到期时间排成小顶堆，由一个线程精确睡眠到最早的到期时间，新定时器更早到期时立即唤醒；
+// 没有定时器时线程一直睡眠。任务在该线程上、不持有内部锁时执行，应尽快返回
+// 可由多个模块共享，取消只是从表中删除，堆中的过时条目在到期时跳过
+class TimerQueue {
+public:
+	using Clock = std::chrono::system_clock;
+	using TimerId = uint64_t;
+	using Task = std::function<void()>;
+
+	TimerQueue();
+	// 停止线程，未到期的任务不再执行
+	~TimerQueue();
+
+	TimerQueue(const TimerQueue &) = delete;
+	TimerQueue &operator=(const TimerQueue &) = delete;
+
+	// 在 when 时执行 task，when 已过去时尽快执行
+	// @return: 定时器ID，从 1 开始
+	TimerId schedule_at(Clock::time_point when, Task task);
+
+	// 取消尚未开始执行的定时器，不会等待正在执行的任务
+	// @return: 是否取消成功
+	bool cancel(TimerId id);
+
+	// 等待当前正在执行的任务返回，用于定时器所有者析构前确认没有任务仍在使用它
+	// 不能在任务内调用，调用时不能持有任务会获取的锁
+	void wait_idle();
+
+	// 尚未执行的定时器数量
+	size_t size() const;
+
+private:
+	using Entry = std::pair<Clock::time_point, TimerId>;
+
+	void thread_func();
+
+	mutable std::mutex mutex_;
+	std::condition_variable cv_; // 唤醒定时线程
+	std::condition_variable idle_cv_; // 唤醒 wait_idle()
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap_;
+	std::unordered_map<TimerId, Task> tasks_;
+	TimerId next_id_ = 1;
+	bool running_task_ = false;
+	bool stop_ = false;
+
+	std::thread thread_;
+};
+
+} // namespace dl
+
+#endif // DREAMLAND_LOGGER_INCLUDE_TIMER_QUEUE_H
@@ -2,46 +2,86 @@
 #define DREAMLAND_LOGGER_INCLUDE_WEB_SERVER_H
 
 #include <atomic>
+#include <chrono>
+#include <event_archive.h>
+#include <event_hub.h>
+#include <metrics.h>
+#include <rate_limiter.h>
+#include <static_assets.h>
+#include <worker_pool.h>
 #include <functional>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <vector>
 #include <httplib.h>
 
-// Forward declaration
-namespace httplib {
-class Server;
-}
-
 namespace dl {
 
 class PlayerList;
 class CommandRequestManager;
+class JsonWriter;
+enum class PlayerChange;
+enum class RequestChange;
 
-// 日志条目
+// 日志条目的只读视图，字符串视图只在回调期间有效，时间在序列化时才格式化
 struct LogEntry {
-    std::string timestamp;
-    std::string type;      // "join", "leave", "command", "chat", "system"
-    std::string player;
-    std::string content;
+    uint64_t seq = 0;      // 单调递增的序号（游戏日志与系统日志各自独立编号）
+    std::chrono::system_clock::time_point time;
+    std::string_view type; // "join", "leave", "command", "chat", "system"
+    std::string_view player;
+    std::string_view content;
+    std::string_view server; // 所属的服务器实例，系统日志为空
 };
 
-// 获取日志回调类型
-using GetLogsCallback = std::function<std::vector<LogEntry>()>;
+// 遍历日志的回调类型
+using LogEntryVisitor = std::function<void(const LogEntry& entry)>;
+// 获取日志回调类型，按序号升序访问序号大于 since 的日志（limit 为 0 表示不限，超出时只访问最新的 limit 条）
+using GetLogsCallback = std::function<void(uint64_t since, size_t limit, const LogEntryVisitor& visit)>;
 // 获取OP列表回调类型
 using GetOpsCallback = std::function<std::vector<std::string>()>;
 // 执行命令回调类型
 using ExecuteCommandCallback = std::function<void(const std::string& command)>;
 // 检查玩家是否存在回调类型
 using PlayerExistsCallback = std::function<bool(const std::string& player)>;
+// 获取数据版本号回调类型（数据每次变化版本号都必须变化）
+using GenerationCallback = std::function<uint64_t()>;
+// 查询历史事件回调类型，按序号从新到旧返回
+using HistoryCallback = std::function<std::vector<ArchivedEvent>(const HistoryQuery& query)>;
+
+// 单个 MC 服务器实例的接口回调
+struct ServerEndpoints {
+    GetLogsCallback get_logs;
+    GenerationCallback logs_generation;  // 必须是最新一条日志的序号，未设置时日志接口不缓存
+    GetOpsCallback get_ops;
+    GenerationCallback ops_generation;   // 未设置时 OP 接口不缓存
+    std::function<bool()> is_running;
+};
 
 // Web服务器配置
 struct WebServerConfig {
     int port = 8080;                              // 监听端口
     std::string web_root = "web";                 // 静态文件目录
+    bool watch_web_root = true;                   // 静态文件变化时自动重新加载（inotify）
     std::string upload_dir = "data/uploads";      // 上传文件目录
+    size_t max_stream_clients = 4;                // /api/stream 最大连接数（每个连接占用一个工作线程）
+    
+    // 工作线程池：每个连接在其 keep-alive 期间独占一个线程，线程数至少为 max_stream_clients + 2
+    size_t worker_threads = 8;                    // 工作线程数
+    size_t max_queued_connections = 32;           // 等待工作线程的连接上限，超出时直接关闭新连接（0 表示不限）
+    size_t keep_alive_max_count = 20;             // 单个连接最多处理的请求数
+    int keep_alive_timeout_sec = 2;               // 连接空闲多久后关闭，空闲连接同样占用工作线程
+    int read_timeout_sec = 5;                     // 读取请求的超时
+    int write_timeout_sec = 5;                    // 写出响应的超时
+    
+    // 投票接口按 IP 限流（令牌桶）
+    double vote_rate_per_minute = 6;              // 每分钟恢复的次数，0 表示不限流
+    double vote_rate_burst = 3;                   // 允许连续投票的次数
+    // 部署在反向代理之后时开启，按代理添加的 X-Forwarded-For / X-Real-IP 识别客户端；
+    // 关闭时这两个头可由客户端任意伪造，投票限流与一 IP 一票只使用连接的对端地址
+    bool trust_proxy_headers = false;
 };
 
 // Web服务器
@@ -63,6 +103,15 @@ public:
     void set_get_ops_callback(GetOpsCallback callback);
     void set_execute_command_callback(ExecuteCommandCallback callback);
     void set_player_exists_callback(PlayerExistsCallback callback);
+    // 设置日志/OP 列表的版本号回调，未设置时对应接口不缓存
+    // 日志的版本号必须是最新一条日志的序号
+    void set_logs_generation_callback(GenerationCallback callback);
+    void set_ops_generation_callback(GenerationCallback callback);
+    // 设置历史事件查询回调，未设置时 /api/history 返回 503
+    void set_history_callback(HistoryCallback callback);
+    // 添加一个服务器实例，提供 /api/servers/<name>/logs 与 /api/servers/<name>/ops（需在 start 之前调用）
+    // 以上 set_*_callback 设置的是 /api/logs 与 /api/ops 使用的默认实例
+    void add_server(const std::string& name, ServerEndpoints endpoints);
     
     // 启动服务器（非阻塞，在新线程中运行）
     bool start();
@@ -75,26 +124,85 @@ public:
     
     // 添加系统日志（如命令执行日志）
     void add_system_log(const std::string& message);
+    
+    // 向 /api/stream 推送事件
+    // publish_log 只应传入 /api/logs 对应实例的日志，前端按同一个序号续接两者
+    void publish_log(const LogEntry& entry);
+    void publish_player_change(PlayerChange change, const std::string& player, const std::string& detail);
+    void publish_request_change(RequestChange change, const std::string& request_id);
 
 private:
+    // 已序列化的响应体及其对应的数据版本号
+    struct CachedResponse {
+        uint64_t generation = 0;
+        std::string etag;
+        std::string body;
+    };
+    
+    // 单个接口的响应缓存，读取方原子获取，锁仅用于避免并发重复序列化
+    struct ResponseCache {
+        std::shared_ptr<const CachedResponse> current;
+        std::mutex build_mutex;
+    };
+    
+    // 一个服务器实例的回调及其日志/OP 接口的响应缓存
+    struct ServerRoute {
+        std::string name;
+        ServerEndpoints endpoints;
+        ResponseCache logs_cache;
+        ResponseCache ops_cache;
+    };
+    
+    // 系统日志条目，序列化时转换为 LogEntry 视图
+    struct SystemLogEntry {
+        uint64_t seq = 0;
+        std::chrono::system_clock::time_point time;
+        std::string message;
+    };
+    
     // 设置路由
     void setup_routes();
+    // 向全局指标注册表登记配置与运行状态，析构时注销
+    void register_metrics();
+    
+    // 包装路由处理函数，按方法和路由记录处理耗时
+    static httplib::Server::Handler timed(const char* method, const char* route,
+                                          httplib::Server::Handler handler);
+    static httplib::Server::HandlerWithContentReader timed(const char* method, const char* route,
+                                                           httplib::Server::HandlerWithContentReader handler);
+    
+    // 发送内存中的静态资源，支持预压缩版本与 304
+    void serve_asset(const httplib::Request& req, httplib::Response& res,
+                     const std::shared_ptr<const StaticAsset>& asset);
+    
+    // 发送缓存的 JSON 响应：版本号变化时调用 build 重新序列化，
+    // 客户端 If-None-Match 与当前 ETag 一致时只返回 304 头
+    void send_cached(const httplib::Request& req, httplib::Response& res,
+                     ResponseCache& cache, uint64_t generation,
+                     const std::function<std::string()>& build);
     
     // API 处理函数
-    void handle_get_logs(const httplib::Request& req, httplib::Response& res);
+    void handle_get_logs(const httplib::Request& req, httplib::Response& res, ServerRoute& server);
     void handle_get_online(const httplib::Request& req, httplib::Response& res);
-    void handle_get_ops(const httplib::Request& req, httplib::Response& res);
+    void handle_get_ops(const httplib::Request& req, httplib::Response& res, ServerRoute& server);
+    void handle_get_servers(const httplib::Request& req, httplib::Response& res);
+    void handle_get_server(const httplib::Request& req, httplib::Response& res);
     void handle_get_banned(const httplib::Request& req, httplib::Response& res);
     void handle_get_players(const httplib::Request& req, httplib::Response& res);
     void handle_get_requests(const httplib::Request& req, httplib::Response& res);
-    void handle_post_request(const httplib::Request& req, httplib::Response& res);
+    void handle_post_request(const httplib::Request& req, httplib::Response& res,
+                             const httplib::ContentReader& content_reader);
     void handle_post_vote(const httplib::Request& req, httplib::Response& res);
+    void handle_get_stream(const httplib::Request& req, httplib::Response& res);
+    void handle_get_history(const httplib::Request& req, httplib::Response& res);
+    void handle_get_metrics(const httplib::Request& req, httplib::Response& res);
     
-    // 获取客户端IP
-    static std::string get_client_ip(const httplib::Request& req);
+    // 获取客户端IP，只有 trust_proxy_headers 开启时才读取代理头
+    std::string get_client_ip(const httplib::Request& req) const;
     
     // JSON 辅助函数
-    static std::string escape_json(const std::string& s);
+    static void write_log_entry(JsonWriter& json, const LogEntry& log);
+    static LogEntry to_log_entry(const SystemLogEntry& log);
 
 private:
     WebServerConfig config_;
@@ -106,15 +214,42 @@ private:
     std::atomic<bool> running_{false};
     
     // 回调函数
-    GetLogsCallback get_logs_callback_;
-    GetOpsCallback get_ops_callback_;
     ExecuteCommandCallback execute_command_callback_;
     PlayerExistsCallback player_exists_callback_;
+    HistoryCallback history_callback_;
+    
+    // 服务器实例：默认实例对应 /api/logs 与 /api/ops，servers_ 按添加顺序，start 之后只读
+    ServerRoute default_server_;
+    std::vector<std::unique_ptr<ServerRoute>> servers_;
     
     // 系统日志
-    std::vector<LogEntry> system_logs_;
+    std::vector<SystemLogEntry> system_logs_;
     mutable std::mutex system_logs_mutex_;
+    std::atomic<uint64_t> system_logs_generation_{0};  // 最新一条系统日志的序号
     static constexpr size_t MAX_SYSTEM_LOGS = 100;
+    static constexpr size_t MAX_LOG_RESPONSE = 1000;           // /api/logs 单次返回的最大游戏日志条数
+    static constexpr size_t MAX_FORM_FIELD_SIZE = 64 * 1024;  // 申请表单单个文本字段的最大长度
+    static constexpr size_t MAX_HISTORY_LIMIT = 1000;          // /api/history 单页最大条数
+    
+    // 各接口的响应缓存
+    std::string etag_prefix_;  // 进程启动标识，避免重启后版本号重复导致错误的 304
+    ResponseCache online_cache_;
+    ResponseCache banned_cache_;
+    ResponseCache players_cache_;
+    ResponseCache requests_cache_;
+    
+    // 推送通道
+    EventHub event_hub_;
+    
+    // 工作线程池统计（线程池由 httplib 在 listen 期间创建和销毁）与投票限流
+    WorkerPoolStats worker_stats_;
+    RateLimiter vote_limiter_;
+    std::vector<MetricsRegistry::CallbackId> metric_callbacks_;
+    
+    // 静态资源表
+    StaticAssetTable assets_;
+    static constexpr size_t MAX_STREAM_QUEUE = 1024;                       // 单个连接最多积压的事件数
+    static constexpr std::chrono::seconds STREAM_KEEPALIVE{15};            // 空闲时发送心跳的间隔
 };
 
 } // namespace dl
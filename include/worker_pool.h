@@ -0,0 +1,57 @@
+#ifndef DREAMLAND_LOGGER_INCLUDE_WORKER_POOL_H
+#define DREAMLAND_LOGGER_INCLUDE_WORKER_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <httplib.h>
+
+namespace dl {
+
+// 工作线程池的运行统计，由池的所有者持有，生命周期长于池本身
+struct WorkerPoolStats {
+	std::atomic<size_t> threads { 0 }; // 当前池的线程数，池关闭后为 0
+	std::atomic<size_t> active { 0 }; // 正在处理连接的线程数
+	std::atomic<size_t> queued { 0 }; // 等待处理的连接数
+	std::atomic<uint64_t> completed { 0 }; // 处理完成的连接总数
+	std::atomic<uint64_t> rejected { 0 }; // 因队列已满被直接关闭的连接总数
+};
+
+// httplib 的连接任务队列：固定数量的工作线程，等待队列有上限
+// 队列满时 enqueue 返回 false，httplib 随即关闭该连接，而不是无限堆积
+// 每个任务处理一个连接上的全部 keep-alive 请求
+class WorkerPool final : public httplib::TaskQueue {
+public:
+	// @param threads: 工作线程数，至少为 1
+	// @param max_queued: 等待队列上限，0 表示不限
+	WorkerPool(size_t threads, size_t max_queued, WorkerPoolStats &stats);
+	~WorkerPool() override;
+
+	WorkerPool(const WorkerPool &) = delete;
+	WorkerPool &operator=(const WorkerPool &) = delete;
+
+	bool enqueue(std::function<void()> fn) override;
+	// 停止接收任务，处理完已排队的连接后等待所有线程退出
+	void shutdown() override;
+
+private:
+	void worker_func();
+
+	const size_t max_queued_;
+	WorkerPoolStats &stats_;
+
+	std::mutex mutex_;
+	std::condition_variable cv_;
+	std::deque<std::function<void()>> jobs_;
+	bool shutdown_ = false;
+	std::vector<std::thread> threads_;
+};
+
+}
+
+#endif
@@ -0,0 +1,133 @@
+#include <aho_corasick.h>
+#include <algorithm>
+#include <queue>
+
+namespace dl {
+
+AhoCorasick::AhoCorasick() {
+	nodes_.emplace_back();
+	build_edges_.emplace_back();
+}
+
+AhoCorasick::PatternId AhoCorasick::add_pattern(std::string_view pattern) {
+	PatternId id = static_cast<PatternId>(pattern_lengths_.size());
+	pattern_lengths_.push_back(static_cast<uint32_t>(pattern.size()));
+	if (pattern.empty() || built_) {
+		return id;
+	}
+
+	uint32_t node = ROOT;
+	for (char ch : pattern) {
+		unsigned char c = static_cast<unsigned char>(ch);
+		uint32_t next = NONE;
+		for (const auto &edge : build_edges_[node]) {
+			if (edge.first == c) {
+				next = edge.second;
+				break;
+			}
+		}
+		if (next == NONE) {
+			next = static_cast<uint32_t>(nodes_.size());
+			nodes_.emplace_back();
+			build_edges_.emplace_back();
+			build_edges_[node].emplace_back(c, next);
+		}
+		node = next;
+	}
+
+	if (nodes_[node].output == NONE) {
+		nodes_[node].output = id;
+	}
+	return id;
+}
+
+void AhoCorasick::build() {
+	if (built_) {
+		return;
+	}
+
+	// 扁平化边表
+	size_t total_edges = 0;
+	for (const auto &edges : build_edges_) {
+		total_edges += edges.size();
+	}
+	edge_labels_.reserve(total_edges);
+	edge_targets_.reserve(total_edges);
+
+	for (size_t i = 0; i < build_edges_.size(); ++i) {
+		auto &edges = build_edges_[i];
+		std::sort(edges.begin(), edges.end());
+		nodes_[i].edge_begin = static_cast<uint32_t>(edge_labels_.size());
+		nodes_[i].edge_count = static_cast<uint32_t>(edges.size());
+		for (const auto &edge : edges) {
+			edge_labels_.push_back(edge.first);
+			edge_targets_.push_back(edge.second);
+		}
+	}
+	build_edges_.clear();
+	build_edges_.shrink_to_fit();
+
+	root_next_.fill(ROOT);
+	for (uint32_t e = 0; e < nodes_[ROOT].edge_count; ++e) {
+		root_next_[edge_labels_[e]] = edge_targets_[e];
+	}
+
+	// BFS 计算失败指针和输出链接
+	std::queue<uint32_t> queue;
+	for (uint32_t e = 0; e < nodes_[ROOT].edge_count; ++e) {
+		uint32_t target = edge_targets_[e];
+		nodes_[target].fail = ROOT;
+		queue.push(target);
+	}
+
+	built_ = true;
+	while (!queue.empty()) {
+		uint32_t node = queue.front();
+		queue.pop();
+
+		const Node &current = nodes_[node];
+		for (uint32_t e = current.edge_begin; e < current.edge_begin + current.edge_count; ++e) {
+			unsigned char c = edge_labels_[e];
+			uint32_t target = edge_targets_[e];
+
+			uint32_t fail = step(nodes_[node].fail, c);
+			nodes_[target].fail = fail;
+			nodes_[target].dict_link = (nodes_[fail].output != NONE) ? fail : nodes_[fail].dict_link;
+			queue.push(target);
+		}
+	}
+}
+
+uint32_t AhoCorasick::child(uint32_t node, unsigned char c) const {
+	const Node &n = nodes_[node];
+	const unsigned char *begin = edge_labels_.data() + n.edge_begin;
+	const unsigned char *end = begin + n.edge_count;
+
+	if (n.edge_count <= 8) {
+		for (const unsigned char *p = begin; p != end; ++p) {
+			if (*p == c) {
+				return edge_targets_[p - edge_labels_.data()];
+			}
+		}
+		return NONE;
+	}
+
+	const unsigned char *p = std::lower_bound(begin, end, c);
+	if (p != end && *p == c) {
+		return edge_targets_[p - edge_labels_.data()];
+	}
+	return NONE;
+}
+
+AhoCorasick::State AhoCorasick::step(State state, unsigned char c) const {
+	while (state != ROOT) {
+		uint32_t next = child(state, c);
+		if (next != NONE) {
+			return next;
+		}
+		state = nodes_[state].fail;
+	}
+	return root_next_[c];
+}
+
+} // namespace dl
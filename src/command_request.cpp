@@ -2,13 +2,14 @@
 #include <algorithm>
 #include <chrono>
 #include <cstdio>
-#include <ctime>
+#include <cstdlib>
 #include <filesystem>
 #include <fstream>
-#include <iomanip>
-#include <iostream>
+#include <io/mapped_file.h>
+#include <logger.h>
 #include <random>
 #include <sstream>
+#include <time_util.h>
 
 namespace dl {
 
@@ -16,23 +17,11 @@ namespace dl {
 // 辅助函数
 // ============================================================================
 
-static std::string time_to_string(const std::chrono::system_clock::time_point& tp) {
-    auto t = std::chrono::system_clock::to_time_t(tp);
-    std::tm tm{};
-    localtime_r(&t, &tm);
-    std::ostringstream oss;
-    oss << std::put_time(&tm, "%Y-%m-%d %H:%M:%S");
-    return oss.str();
-}
-
-static std::chrono::system_clock::time_point string_to_time(const std::string& s) {
-    std::tm tm{};
-    std::istringstream iss(s);
-    iss >> std::get_time(&tm, "%Y-%m-%d %H:%M:%S");
-    if (iss.fail()) {
-        return std::chrono::system_clock::now();
-    }
-    return std::chrono::system_clock::from_time_t(mktime(&tm));
+// 无法解析的时间按当前时间处理
+static std::chrono::system_clock::time_point string_to_time(std::string_view s) {
+    auto tp = std::chrono::system_clock::now();
+    parse_local_time(s, tp);
+    return tp;
 }
 
 static std::string trim(const std::string& s) {
@@ -59,17 +48,70 @@ static std::string remove_spaces(const std::string& s) {
     return result;
 }
 
+// ============================================================================
+// 日志记录（journal）编码
+// ============================================================================
+// C|id|created|applicant|command|reason|image  创建（时间为 Unix 秒）
+// V|id|ip                                    投票
+// X|id|executed                              执行
+// R|id                                       删除
+// 字段中的 '\\'、'|' 和换行符转义，保证一条记录一行
+
+static void append_field(std::string& record, const std::string& value) {
+    record += '|';
+    for (char c : value) {
+        switch (c) {
+        case '\\': record += "\\\\"; break;
+        case '|':  record += "\\p"; break;
+        case '\n': record += "\\n"; break;
+        case '\r': record += "\\r"; break;
+        default:   record += c; break;
+        }
+    }
+}
+
+static std::vector<std::string> split_record(std::string_view record) {
+    std::vector<std::string> fields(1);
+    for (size_t i = 0; i < record.size(); ++i) {
+        char c = record[i];
+        if (c == '|') {
+            fields.emplace_back();
+        } else if (c == '\\' && i + 1 < record.size()) {
+            char e = record[++i];
+            fields.back() += (e == 'p') ? '|' : (e == 'n') ? '\n' : (e == 'r') ? '\r' : e;
+        } else {
+            fields.back() += c;
+        }
+    }
+    return fields;
+}
+
+// 数据文件按行解析，字段内的换行符替换为空格
+static std::string single_line(const std::string& s) {
+    std::string result = s;
+    std::replace_if(result.begin(), result.end(), [](char c) { return c == '\n' || c == '\r'; }, ' ');
+    return result;
+}
+
+static std::string to_epoch_string(const std::chrono::system_clock::time_point& tp) {
+    return std::to_string(std::chrono::system_clock::to_time_t(tp));
+}
+
+static std::chrono::system_clock::time_point from_epoch_string(const std::string& s) {
+    return std::chrono::system_clock::from_time_t(std::strtoll(s.c_str(), nullptr, 10));
+}
+
 // ============================================================================
 // RequestInfo 实现
 // ============================================================================
 
 std::string RequestInfo::get_created_time_string() const {
-    return time_to_string(created_at);
+    return format_local_time(created_at);
 }
 
 std::string RequestInfo::get_executed_time_string() const {
     if (!executed) return "";
-    return time_to_string(executed_at);
+    return format_local_time(executed_at);
 }
 
 // ============================================================================
@@ -79,36 +121,61 @@ std::string RequestInfo::get_executed_time_string() const {
 CommandRequestManager::CommandRequestManager(const std::string& data_file,
                                              const std::string& upload_dir,
                                              size_t vote_threshold,
-                                             CommandExecuteCallback execute_callback)
+                                             CommandExecuteCallback execute_callback,
+                                             TimerQueue* timers)
     : data_file_(data_file)
     , upload_dir_(upload_dir)
     , vote_threshold_(vote_threshold)
-    , execute_callback_(std::move(execute_callback)) {
+    , execute_callback_(std::move(execute_callback))
+    , own_timers_(timers ? nullptr : std::make_unique<TimerQueue>())
+    , timers_(timers ? timers : own_timers_.get()) {
     
     // 确保上传目录存在
     std::filesystem::create_directories(upload_dir_);
     
+    // 临时文件放在上传目录之外，避免通过 /uploads/ 读到未完成的上传；上次异常退出遗留的临时文件直接清理
+    std::filesystem::path upload_path = std::filesystem::path(upload_dir_).lexically_normal();
+    if (!upload_path.has_filename()) upload_path = upload_path.parent_path();
+    upload_temp_dir_ = upload_path.string() + ".tmp";
+    std::error_code ec;
+    std::filesystem::remove_all(upload_temp_dir_, ec);
+    std::filesystem::create_directories(upload_temp_dir_);
+    
     // 加载数据
     load_data();
     
-    // 启动检查线程
-    checker_thread_ = std::thread(&CommandRequestManager::checker_thread_func, this);
+    // 之后的每次变更只追加一条记录，由 journal 的写线程批量落盘并定期压缩回数据文件
+    journal_ = std::make_unique<Journal>(journal_file(), [this] {
+        return save_data();
+    });
+    
+    {
+        std::lock_guard<TimedMutex> lock(mutex_);
+        for (const auto& pair : requests_) {
+            if (pair.second.executed) schedule_expiry_locked(pair.second);
+        }
+    }
 }
 
 CommandRequestManager::~CommandRequestManager() {
-    // 停止检查线程
+    // 取消所有定时器，并等待可能正在执行的任务返回
     {
-        std::lock_guard<std::mutex> lock(checker_mutex_);
-        stop_checker_ = true;
+        std::lock_guard<TimedMutex> lock(mutex_);
+        stopping_ = true;
+        if (execution_timer_ != 0) timers_->cancel(execution_timer_);
+        for (const auto& pair : expiry_timers_) {
+            timers_->cancel(pair.second);
+        }
+        expiry_timers_.clear();
     }
-    checker_cv_.notify_all();
+    timers_->wait_idle();
     
-    if (checker_thread_.joinable()) {
-        checker_thread_.join();
-    }
+    // 已排队但还没来得及执行的命令在这里执行完
+    run_pending_executions();
     
-    // 保存数据
-    save_data();
+    // 退出时压缩一次，数据文件即为最终状态
+    journal_->compact();
+    journal_.reset();
 }
 
 std::string CommandRequestManager::generate_id() {
@@ -147,11 +214,9 @@ bool CommandRequestManager::is_self_pardon(const std::string& applicant, const s
     return false;
 }
 
-std::string CommandRequestManager::create_request(const std::string& applicant,
-                                                  const std::string& command,
-                                                  const std::string& reason,
-                                                  const std::string& image_data,
-                                                  const std::string& image_ext) {
+RequestInfo CommandRequestManager::make_request(const std::string& applicant,
+                                                const std::string& command,
+                                                const std::string& reason) {
     RequestInfo info;
     info.id = generate_id();
     info.applicant = trim(applicant);
@@ -159,6 +224,15 @@ std::string CommandRequestManager::create_request(const std::string& applicant,
     info.reason = trim(reason);
     info.created_at = std::chrono::system_clock::now();
     info.executed = false;
+    return info;
+}
+
+std::string CommandRequestManager::create_request(const std::string& applicant,
+                                                  const std::string& command,
+                                                  const std::string& reason,
+                                                  const std::string& image_data,
+                                                  const std::string& image_ext) {
+    RequestInfo info = make_request(applicant, command, reason);
     
     // 保存图片（如果有）
     if (!image_data.empty()) {
@@ -173,75 +247,152 @@ std::string CommandRequestManager::create_request(const std::string& applicant,
         }
     }
     
-    {
-        std::lock_guard<std::mutex> lock(mutex_);
-        requests_[info.id] = info;
-    }
-    
-    save_data();
-    
-    return info.id;
+    return add_request(std::move(info));
 }
 
-int CommandRequestManager::vote(const std::string& request_id, const std::string& ip) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    auto it = requests_.find(request_id);
-    if (it == requests_.end()) {
-        return 2; // 申请不存在
+std::string CommandRequestManager::create_request_with_file(const std::string& applicant,
+                                                            const std::string& command,
+                                                            const std::string& reason,
+                                                            const std::string& image_temp_path,
+                                                            const std::string& image_ext) {
+    RequestInfo info = make_request(applicant, command, reason);
+    
+    // 同一文件系统内 rename 是原子的，不会出现写了一半的图片
+    if (!image_temp_path.empty()) {
+        std::string filename = info.id + image_ext;
+        std::string filepath = upload_dir_ + "/" + filename;
+        if (std::rename(image_temp_path.c_str(), filepath.c_str()) == 0) {
+            info.image_path = filename; // 只存储文件名
+        } else {
+            log_error() << "[CommandRequest] 保存图片失败: " << filepath;
+            std::remove(image_temp_path.c_str());
+        }
     }
     
-    if (it->second.executed) {
-        return 3; // 已执行
+    return add_request(std::move(info));
+}
+
+std::string CommandRequestManager::add_request(RequestInfo info) {
+    std::string id = info.id;
+    {
+        std::lock_guard<TimedMutex> lock(mutex_);
+        std::string record = "C|" + info.id + "|" + to_epoch_string(info.created_at);
+        append_field(record, info.applicant);
+        append_field(record, info.command);
+        append_field(record, info.reason);
+        append_field(record, info.image_path);
+        insert_locked(std::move(info));
+        generation_++;
+        journal_->append(std::move(record));
     }
     
-    if (it->second.voted_ips.count(ip) > 0) {
-        return 1; // 已投过票
+    if (change_callback_) change_callback_(RequestChange::CREATE, id);
+    return id;
+}
+
+int CommandRequestManager::vote(const std::string& request_id, const std::string& ip) {
+    {
+        std::lock_guard<TimedMutex> lock(mutex_);
+        
+        RequestInfo* info = find_locked(request_id);
+        if (!info) {
+            return 2; // 申请不存在
+        }
+        
+        if (info->executed) {
+            return 3; // 已执行
+        }
+        
+        if (!info->voted_ips.insert(ip).second) {
+            return 1; // 已投过票
+        }
+        
+        generation_++;
+        std::string record = "V|" + request_id;
+        append_field(record, ip);
+        journal_->append(std::move(record));
+        
+        // 达到阈值的这一票直接交给执行线程，回调不在锁内调用
+        if (info->vote_count() >= vote_threshold_) {
+            mark_executed_locked(*info);
+        }
     }
     
-    it->second.voted_ips.insert(ip);
-    
-    // 不在这里执行，让 checker 线程来处理
-    // 这样可以避免在锁内执行回调
+    if (change_callback_) change_callback_(RequestChange::VOTE, request_id);
     
     return 0; // 成功
 }
 
+void CommandRequestManager::execute_pending() {
+    std::lock_guard<TimedMutex> lock(mutex_);
+    execute_ready_locked();
+}
+
+void CommandRequestManager::set_threshold(size_t threshold) {
+    std::lock_guard<TimedMutex> lock(mutex_);
+    vote_threshold_ = threshold;
+    generation_++;
+    execute_ready_locked();
+}
+
 std::vector<RequestInfo> CommandRequestManager::list_requests() const {
-    std::lock_guard<std::mutex> lock(mutex_);
+    std::lock_guard<TimedMutex> lock(mutex_);
     
+    // requests_ 已按创建时间排序，逆序即新的在前
     std::vector<RequestInfo> result;
     result.reserve(requests_.size());
-    
-    for (const auto& pair : requests_) {
-        result.push_back(pair.second);
+    for (auto it = requests_.rbegin(); it != requests_.rend(); ++it) {
+        result.push_back(it->second);
     }
-    
-    // 按创建时间排序（新的在前）
-    std::sort(result.begin(), result.end(), 
-        [](const RequestInfo& a, const RequestInfo& b) {
-            return a.created_at > b.created_at;
-        });
-    
     return result;
 }
 
+void CommandRequestManager::visit_requests(const RequestVisitor& visitor) const {
+    std::lock_guard<TimedMutex> lock(mutex_);
+    for (auto it = requests_.rbegin(); it != requests_.rend(); ++it) {
+        visitor(it->second);
+    }
+}
+
 bool CommandRequestManager::get_request(const std::string& request_id, RequestInfo& out) const {
-    std::lock_guard<std::mutex> lock(mutex_);
+    std::lock_guard<TimedMutex> lock(mutex_);
     
-    auto it = requests_.find(request_id);
-    if (it == requests_.end()) {
+    const RequestInfo* info = find_locked(request_id);
+    if (!info) {
         return false;
     }
     
-    out = it->second;
+    out = *info;
     return true;
 }
 
 bool CommandRequestManager::save() const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    save_data();
-    return true;
+    // 由 journal 写线程完成压缩，不持有 mutex_
+    return journal_->compact();
+}
+
+RequestInfo* CommandRequestManager::find_locked(const std::string& request_id) {
+    auto it = index_.find(request_id);
+    return it == index_.end() ? nullptr : &it->second->second;
+}
+
+const RequestInfo* CommandRequestManager::find_locked(const std::string& request_id) const {
+    auto it = index_.find(request_id);
+    return it == index_.end() ? nullptr : &it->second->second;
+}
+
+void CommandRequestManager::insert_locked(RequestInfo info) {
+    if (index_.count(info.id) > 0) return;
+    OrderKey key(info.created_at, info.id);
+    auto it = requests_.emplace(std::move(key), std::move(info)).first;
+    index_.emplace(it->second.id, it);
+}
+
+void CommandRequestManager::erase_locked(const std::string& request_id) {
+    auto it = index_.find(request_id);
+    if (it == index_.end()) return;
+    requests_.erase(it->second);
+    index_.erase(it);
 }
 
 // ============================================================================
@@ -249,13 +400,9 @@ bool CommandRequestManager::save() const {
 // ============================================================================
 
 void CommandRequestManager::load_data() {
-    std::ifstream file(data_file_);
-    if (!file) {
-        return; // 文件不存在，跳过
-    }
-    
-    std::lock_guard<std::mutex> lock(mutex_);
+    std::lock_guard<TimedMutex> lock(mutex_);
     requests_.clear();
+    index_.clear();
     
     /*
      * 文件格式（简单文本格式，每个申请多行）:
@@ -272,45 +419,58 @@ void CommandRequestManager::load_data() {
      * === END ===
      */
     
-    std::string line;
+    // 文件不存在时映射为空，按没有申请处理
+    MappedFile file;
+    file.open(data_file_);
+    std::string_view content = file.view();
+    
+    // 每个申请以一行 "=== REQUEST ===" 开始，按出现次数预留索引
+    static constexpr std::string_view REQUEST_BEGIN = "=== REQUEST ===";
+    size_t expected = 0;
+    for (size_t pos = content.find(REQUEST_BEGIN); pos != std::string_view::npos;
+         pos = content.find(REQUEST_BEGIN, pos + REQUEST_BEGIN.size())) {
+        expected++;
+    }
+    index_.reserve(expected);
+    
     RequestInfo current;
     bool in_request = false;
     
-    while (std::getline(file, line)) {
-        line = trim(line);
+    for_each_line(content, [&](std::string_view line) {
+        line = trim_view(line);
         
-        if (line == "=== REQUEST ===") {
+        if (line == REQUEST_BEGIN) {
             in_request = true;
             current = RequestInfo();
-            continue;
+            return;
         }
         
         if (line == "=== END ===") {
             if (in_request && !current.id.empty()) {
-                requests_[current.id] = current;
+                insert_locked(std::move(current));
             }
             in_request = false;
-            continue;
+            return;
         }
         
-        if (!in_request) continue;
+        if (!in_request) return;
         
         size_t sep = line.find('|');
-        if (sep == std::string::npos) continue;
+        if (sep == std::string_view::npos) return;
         
-        std::string key = line.substr(0, sep);
-        std::string value = line.substr(sep + 1);
+        std::string_view key = line.substr(0, sep);
+        std::string_view value = line.substr(sep + 1);
         
         if (key == "id") {
-            current.id = value;
+            current.id = std::string(value);
         } else if (key == "applicant") {
-            current.applicant = value;
+            current.applicant = std::string(value);
         } else if (key == "command") {
-            current.command = value;
+            current.command = std::string(value);
         } else if (key == "reason") {
-            current.reason = value;
+            current.reason = std::string(value);
         } else if (key == "image") {
-            current.image_path = value;
+            current.image_path = std::string(value);
         } else if (key == "created") {
             current.created_at = string_to_time(value);
         } else if (key == "executed") {
@@ -321,141 +481,188 @@ void CommandRequestManager::load_data() {
             }
         } else if (key == "votes") {
             // 解析IP列表
-            if (!value.empty()) {
-                std::istringstream iss(value);
-                std::string ip;
-                while (std::getline(iss, ip, ',')) {
-                    ip = trim(ip);
-                    if (!ip.empty()) {
-                        current.voted_ips.insert(ip);
-                    }
+            for (size_t begin = 0; begin < value.size();) {
+                size_t comma = value.find(',', begin);
+                if (comma == std::string_view::npos) comma = value.size();
+                std::string_view ip = trim_view(value.substr(begin, comma - begin));
+                if (!ip.empty()) {
+                    current.voted_ips.emplace(ip);
                 }
+                begin = comma + 1;
+            }
+        }
+    });
+    
+    // 重放上次压缩之后追加的记录，记录都是幂等的赋值，重复应用也不影响结果
+    size_t replayed = Journal::replay(journal_file(), [this](std::string_view record) {
+        std::vector<std::string> fields = split_record(record);
+        if (fields.size() < 2 || fields[0].size() != 1) return;
+        switch (fields[0][0]) {
+        case 'C': {
+            if (fields.size() < 7) return;
+            RequestInfo info;
+            info.id = fields[1];
+            info.created_at = from_epoch_string(fields[2]);
+            info.applicant = std::move(fields[3]);
+            info.command = std::move(fields[4]);
+            info.reason = std::move(fields[5]);
+            info.image_path = std::move(fields[6]);
+            insert_locked(std::move(info));
+            break;
+        }
+        case 'V':
+            if (fields.size() < 3) return;
+            if (RequestInfo* info = find_locked(fields[1])) info->voted_ips.insert(std::move(fields[2]));
+            break;
+        case 'X':
+            if (fields.size() < 3) return;
+            if (RequestInfo* info = find_locked(fields[1])) {
+                info->executed = true;
+                info->executed_at = from_epoch_string(fields[2]);
             }
+            break;
+        case 'R':
+            erase_locked(fields[1]);
+            break;
+        default:
+            break;
         }
+    });
+    if (replayed > 0) {
+        log_info() << "[CommandRequest] 从日志恢复 " << replayed << " 条记录";
     }
 }
 
-void CommandRequestManager::save_data() const {
-    std::ofstream file(data_file_);
-    if (!file) {
-        std::cerr << "[CommandRequest] 无法保存数据文件: " << data_file_ << std::endl;
-        return;
-    }
+std::string CommandRequestManager::journal_file() const {
+    return data_file_ + ".journal";
+}
+
+bool CommandRequestManager::save_data() const {
+    static Histogram& save_time = MetricsRegistry::global().histogram("dreamland_save_seconds",
+        "Time spent writing a data file.", {{"file", "requests"}});
+    ScopedTimer timer(save_time);
     
-    for (const auto& pair : requests_) {
-        const auto& req = pair.second;
-        
-        file << "=== REQUEST ===" << "\n";
-        file << "id|" << req.id << "\n";
-        file << "applicant|" << req.applicant << "\n";
-        file << "command|" << req.command << "\n";
-        file << "reason|" << req.reason << "\n";
-        file << "image|" << req.image_path << "\n";
-        file << "created|" << time_to_string(req.created_at) << "\n";
-        file << "executed|" << (req.executed ? "1" : "0") << "\n";
-        file << "executed_at|" << (req.executed ? time_to_string(req.executed_at) : "") << "\n";
-        
-        // 保存投票IP列表
-        file << "votes|";
-        bool first = true;
-        for (const auto& ip : req.voted_ips) {
-            if (!first) file << ",";
-            file << ip;
-            first = false;
+    // 锁内只做序列化，写文件在锁外；先写临时文件再 rename，中途崩溃不会留下半个文件
+    std::string content;
+    {
+        std::lock_guard<TimedMutex> lock(mutex_);
+        for (const auto& pair : requests_) {
+            const auto& req = pair.second;
+            
+            content += "=== REQUEST ===\n";
+            content += "id|" + req.id + "\n";
+            content += "applicant|" + req.applicant + "\n";
+            content += "command|" + single_line(req.command) + "\n";
+            content += "reason|" + single_line(req.reason) + "\n";
+            content += "image|" + req.image_path + "\n";
+            content += "created|" + format_local_time(req.created_at) + "\n";
+            content += std::string("executed|") + (req.executed ? "1" : "0") + "\n";
+            content += "executed_at|" + (req.executed ? format_local_time(req.executed_at) : "") + "\n";
+            
+            // 保存投票IP列表
+            content += "votes|";
+            bool first = true;
+            for (const auto& ip : req.voted_ips) {
+                if (!first) content += ',';
+                content += ip;
+                first = false;
+            }
+            content += "\n";
+            
+            content += "=== END ===\n";
         }
-        file << "\n";
-        
-        file << "=== END ===" << "\n";
     }
+    
+    if (!write_file_atomically(data_file_, content)) {
+        log_error() << "[CommandRequest] 无法保存数据文件: " << data_file_;
+        return false;
+    }
+    return true;
 }
 
 // ============================================================================
-// 检查线程
+// 定时任务
 // ============================================================================
 
-void CommandRequestManager::checker_thread_func() {
-    while (true) {
-        std::unique_lock<std::mutex> lock(checker_mutex_);
-        
-        // 每10秒检查一次
-        checker_cv_.wait_for(lock, std::chrono::seconds(10), [this] {
-            return stop_checker_.load();
+void CommandRequestManager::mark_executed_locked(RequestInfo& info) {
+    info.executed = true;
+    info.executed_at = std::chrono::system_clock::now();
+    journal_->append("X|" + info.id + "|" + to_epoch_string(info.executed_at));
+    schedule_expiry_locked(info);
+    pending_executions_.push_back({info.id, info.command, info.applicant});
+    generation_++;
+    
+    // 同一批待执行的命令只提交一次任务
+    if (execution_timer_ == 0 && !stopping_) {
+        execution_timer_ = timers_->schedule_at(TimerQueue::Clock::now(), [this] {
+            run_pending_executions();
         });
-        
-        if (stop_checker_) break;
-        
-        // 检查并执行达到阈值的申请
-        check_and_execute();
-        
-        // 清理过期申请
-        cleanup_expired();
     }
 }
 
-void CommandRequestManager::check_and_execute() {
-    std::vector<RequestInfo> to_execute;
-    
-    {
-        std::lock_guard<std::mutex> lock(mutex_);
-        for (auto& pair : requests_) {
-            auto& req = pair.second;
-            if (!req.executed && req.vote_count() >= vote_threshold_) {
-                req.executed = true;
-                req.executed_at = std::chrono::system_clock::now();
-                to_execute.push_back(req);
-            }
+void CommandRequestManager::schedule_expiry_locked(const RequestInfo& info) {
+    if (stopping_) return;
+    auto it = expiry_timers_.find(info.id);
+    if (it != expiry_timers_.end()) {
+        timers_->cancel(it->second);
+    }
+    std::string id = info.id;
+    expiry_timers_[id] = timers_->schedule_at(info.executed_at + std::chrono::hours(24), [this, id] {
+        expire(id);
+    });
+}
+
+void CommandRequestManager::execute_ready_locked() {
+    for (auto& pair : requests_) {
+        auto& req = pair.second;
+        if (!req.executed && req.vote_count() >= vote_threshold_) {
+            mark_executed_locked(req);
         }
     }
-    
-    // 在锁外执行回调
-    for (const auto& req : to_execute) {
+}
+
+void CommandRequestManager::run_pending_executions() {
+    std::vector<ExecuteTask> tasks;
+    {
+        std::lock_guard<TimedMutex> lock(mutex_);
+        tasks.swap(pending_executions_);
+        execution_timer_ = 0;
+    }
+    run_executions(tasks);
+}
+
+void CommandRequestManager::run_executions(const std::vector<ExecuteTask>& tasks) {
+    for (const auto& task : tasks) {
         if (execute_callback_) {
-            execute_callback_(req.command, req.applicant);
+            execute_callback_(task.command, task.applicant);
         }
-        std::cout << "[CommandRequest] 命令申请已执行: " << req.command 
-                  << " (申请人: " << req.applicant << ")" << std::endl;
-    }
-    
-    if (!to_execute.empty()) {
-        save_data();
+        log_info() << "[CommandRequest] 命令申请已执行: " << task.command 
+                  << " (申请人: " << task.applicant << ")";
+        if (change_callback_) change_callback_(RequestChange::EXECUTE, task.id);
     }
 }
 
-void CommandRequestManager::cleanup_expired() {
-    auto now = std::chrono::system_clock::now();
-    std::vector<std::string> to_remove;
-    std::vector<std::string> images_to_delete;
-    
+void CommandRequestManager::expire(const std::string& request_id) {
+    std::string image_path;
     {
-        std::lock_guard<std::mutex> lock(mutex_);
-        for (const auto& pair : requests_) {
-            const auto& req = pair.second;
-            if (req.executed) {
-                auto elapsed = std::chrono::duration_cast<std::chrono::hours>(
-                    now - req.executed_at).count();
-                if (elapsed >= 24) {
-                    to_remove.push_back(req.id);
-                    if (!req.image_path.empty()) {
-                        images_to_delete.push_back(req.image_path);
-                    }
-                }
-            }
-        }
+        std::lock_guard<TimedMutex> lock(mutex_);
+        expiry_timers_.erase(request_id);
         
-        for (const auto& id : to_remove) {
-            requests_.erase(id);
-        }
+        const RequestInfo* req = find_locked(request_id);
+        if (!req || !req->executed) return;
+        
+        image_path = req->image_path;
+        erase_locked(request_id);
+        journal_->append("R|" + request_id);
+        generation_++;
     }
     
     // 删除图片文件
-    for (const auto& img : images_to_delete) {
-        delete_image(img);
-    }
+    delete_image(image_path);
     
-    if (!to_remove.empty()) {
-        save_data();
-        std::cout << "[CommandRequest] 清理了 " << to_remove.size() << " 个过期申请" << std::endl;
-    }
+    if (change_callback_) change_callback_(RequestChange::REMOVE, request_id);
+    
+    log_info() << "[CommandRequest] 清理过期申请: " << request_id;
 }
 
 void CommandRequestManager::delete_image(const std::string& image_path) {
@@ -465,7 +672,7 @@ void CommandRequestManager::delete_image(const std::string& image_path) {
     std::error_code ec;
     std::filesystem::remove(full_path, ec);
     if (ec) {
-        std::cerr << "[CommandRequest] 删除图片失败: " << full_path << std::endl;
+        log_error() << "[CommandRequest] 删除图片失败: " << full_path;
     }
 }
 
@@ -0,0 +1,411 @@
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <event_archive.h>
+#include <fcntl.h>
+#include <logger.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace dl {
+
+// ============================================================================
+// 磁盘格式
+// ============================================================================
+// 段文件: <dir>/events-<首条记录序号, 16 位十六进制>.seg，由连续的记录组成，每条记录按 8 字节对齐:
+//   RecordHeader | player | content | 填充
+// 预分配部分全为 0，扫描时遇到魔数不符、长度越界或序号不递增即视为段的末尾
+
+static constexpr uint32_t RECORD_MAGIC = 0x31564544; // "DEV1"
+
+struct RecordHeader {
+	uint32_t magic;
+	uint32_t size; // 含头部与填充
+	uint64_t seq;
+	int64_t time_ms; // Unix 毫秒
+	uint16_t player_len;
+	uint8_t kind;
+	uint8_t reserved;
+	uint32_t content_len;
+};
+static_assert(sizeof(RecordHeader) == 32, "RecordHeader 布局必须固定");
+
+static constexpr size_t MAX_PLAYER_LEN = 64;
+static constexpr size_t MAX_CONTENT_LEN = 16 << 10;
+
+static uint32_t record_size(size_t player_len, size_t content_len) {
+	return static_cast<uint32_t>((sizeof(RecordHeader) + player_len + content_len + 7) & ~size_t(7));
+}
+
+static int64_t to_ms(std::chrono::system_clock::time_point tp) {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(tp.time_since_epoch()).count();
+}
+
+static std::chrono::system_clock::time_point from_ms(int64_t ms) {
+	return std::chrono::system_clock::time_point(std::chrono::milliseconds(ms));
+}
+
+// 按 UTC 日期分段
+static int64_t day_of(std::chrono::system_clock::time_point tp) {
+	return std::chrono::duration_cast<std::chrono::hours>(tp.time_since_epoch()).count() / 24;
+}
+
+static std::string lower(std::string_view s) {
+	std::string result(s);
+	for (char &c : result) {
+		c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+	}
+	return result;
+}
+
+const char *event_kind_name(EventKind kind) {
+	switch (kind) {
+	case EventKind::JOIN:
+		return "join";
+	case EventKind::LEAVE:
+		return "leave";
+	case EventKind::COMMAND:
+		return "command";
+	case EventKind::CHAT:
+		return "chat";
+	}
+	return "unknown";
+}
+
+bool parse_event_kind(std::string_view name, EventKind &kind) {
+	if (name == "join") {
+		kind = EventKind::JOIN;
+	} else if (name == "leave") {
+		kind = EventKind::LEAVE;
+	} else if (name == "command") {
+		kind = EventKind::COMMAND;
+	} else if (name == "chat") {
+		kind = EventKind::CHAT;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+// ============================================================================
+// Segment
+// ============================================================================
+
+struct EventArchive::Segment {
+	std::string path;
+	int fd = -1;
+	char *data = nullptr;
+	uint64_t mapped = 0; // 映射长度
+	uint64_t used = 0; // 有效记录的总长度
+	bool writable = false;
+
+	uint64_t first_seq = 0;
+	uint64_t last_seq = 0;
+	std::chrono::system_clock::time_point min_time = std::chrono::system_clock::time_point::max();
+	std::chrono::system_clock::time_point max_time = std::chrono::system_clock::time_point::min();
+	int64_t day = -1; // 首条记录的 UTC 日期
+
+	// 倒排表，元素为记录在段内的偏移，按序号升序
+	std::vector<uint32_t> offsets;
+	std::vector<uint32_t> by_kind[5];
+	std::unordered_map<std::string, std::vector<uint32_t>> by_player; // 键为小写玩家名
+
+	const RecordHeader &header_at(uint32_t offset) const {
+		return *reinterpret_cast<const RecordHeader *>(data + offset);
+	}
+
+	void index(uint32_t offset) {
+		const RecordHeader &header = header_at(offset);
+		auto time = from_ms(header.time_ms);
+		if (offsets.empty()) {
+			first_seq = header.seq;
+			day = day_of(time);
+		}
+		last_seq = header.seq;
+		min_time = std::min(min_time, time);
+		max_time = std::max(max_time, time);
+		offsets.push_back(offset);
+		if (header.kind < 5) {
+			by_kind[header.kind].push_back(offset);
+		}
+		if (header.player_len > 0) {
+			std::string_view player(data + offset + sizeof(RecordHeader), header.player_len);
+			by_player[lower(player)].push_back(offset);
+		}
+	}
+
+	~Segment() {
+		if (data) {
+			munmap(data, mapped);
+		}
+		if (fd != -1) {
+			close(fd);
+		}
+	}
+};
+
+// ============================================================================
+// EventArchive 实现
+// ============================================================================
+
+EventArchive::EventArchive(const std::string &dir) : EventArchive(dir, Options()) {
+}
+
+EventArchive::EventArchive(const std::string &dir, Options options) : dir_(dir)
+																	, options_(options) {
+	mkdir(dir_.c_str(), 0755);
+
+	std::vector<std::string> names;
+	if (DIR *d = opendir(dir_.c_str())) {
+		while (dirent *entry = readdir(d)) {
+			std::string name = entry->d_name;
+			if (name.size() == 27 && name.compare(0, 7, "events-") == 0 && name.compare(23, 4, ".seg") == 0) {
+				names.push_back(name);
+			}
+		}
+		closedir(d);
+	}
+	// 文件名中的序号定长，字典序即时间顺序
+	std::sort(names.begin(), names.end());
+
+	for (size_t i = 0; i < names.size(); ++i) {
+		bool last = (i + 1 == names.size());
+		auto segment = open_segment(dir_ + "/" + names[i], last);
+		if (!segment) {
+			continue;
+		}
+		if (segment->offsets.empty() && !last) {
+			unlink(segment->path.c_str());
+			continue;
+		}
+		if (!segment->offsets.empty()) {
+			next_seq_ = std::max(next_seq_, segment->last_seq + 1);
+		}
+		segments_.push_back(std::move(segment));
+	}
+
+	drop_expired(std::chrono::system_clock::now());
+
+	uint64_t count = 0;
+	for (const auto &segment : segments_) {
+		count += segment->offsets.size();
+	}
+	if (count > 0) {
+		log_info() << "[EventArchive] 已加载 " << segments_.size() << " 个分段，共 " << count << " 条事件";
+	}
+}
+
+EventArchive::~EventArchive() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (!segments_.empty() && segments_.back()->writable) {
+		Segment &segment = *segments_.back();
+		msync(segment.data, segment.mapped, MS_SYNC);
+	}
+}
+
+std::unique_ptr<EventArchive::Segment> EventArchive::open_segment(const std::string &path, bool writable) {
+	auto segment = std::make_unique<Segment>();
+	segment->path = path;
+	segment->writable = writable;
+	segment->fd = open(path.c_str(), (writable ? O_RDWR | O_CREAT : O_RDONLY) | O_CLOEXEC, 0644);
+	if (segment->fd == -1) {
+		log_error() << "[EventArchive] 无法打开分段: " << path;
+		return nullptr;
+	}
+
+	struct stat st {};
+	fstat(segment->fd, &st);
+	uint64_t file_size = static_cast<uint64_t>(st.st_size);
+	// 写入段预分配到固定大小（稀疏文件，不占用实际磁盘空间），之后追加只需 memcpy
+	if (writable && file_size < options_.segment_bytes) {
+		if (ftruncate(segment->fd, static_cast<off_t>(options_.segment_bytes)) != 0) {
+			log_error() << "[EventArchive] 无法预分配分段: " << path;
+			return nullptr;
+		}
+		file_size = options_.segment_bytes;
+	}
+	if (file_size == 0) {
+		return segment;
+	}
+
+	void *data = mmap(nullptr, file_size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, segment->fd, 0);
+	if (data == MAP_FAILED) {
+		log_error() << "[EventArchive] 无法映射分段: " << path;
+		return nullptr;
+	}
+	segment->data = static_cast<char *>(data);
+	segment->mapped = file_size;
+
+	// 扫描有效记录，重建索引
+	uint64_t offset = 0;
+	uint64_t prev_seq = 0;
+	while (offset + sizeof(RecordHeader) <= file_size) {
+		const RecordHeader &header = segment->header_at(static_cast<uint32_t>(offset));
+		if (header.magic != RECORD_MAGIC || header.size < sizeof(RecordHeader) || header.size % 8 != 0 ||
+			offset + header.size > file_size || record_size(header.player_len, header.content_len) != header.size ||
+			header.seq <= prev_seq) {
+			break;
+		}
+		segment->index(static_cast<uint32_t>(offset));
+		prev_seq = header.seq;
+		offset += header.size;
+	}
+	segment->used = offset;
+	return segment;
+}
+
+bool EventArchive::roll_segment(std::chrono::system_clock::time_point time) {
+	// 封存当前段：截断到实际长度，之后只读
+	if (!segments_.empty() && segments_.back()->writable) {
+		Segment &current = *segments_.back();
+		msync(current.data, current.mapped, MS_ASYNC);
+		if (ftruncate(current.fd, static_cast<off_t>(current.used)) != 0) {
+			log_error() << "[EventArchive] 无法截断分段: " << current.path;
+		}
+		current.writable = false;
+		if (current.offsets.empty()) {
+			unlink(current.path.c_str());
+			segments_.pop_back();
+		}
+	}
+
+	char name[32];
+	std::snprintf(name, sizeof(name), "events-%016" PRIx64 ".seg", next_seq_);
+	auto segment = open_segment(dir_ + "/" + name, true);
+	if (!segment || !segment->data) {
+		return false;
+	}
+	segments_.push_back(std::move(segment));
+	drop_expired(time);
+	return true;
+}
+
+void EventArchive::drop_expired(std::chrono::system_clock::time_point now) {
+	auto cutoff = now - options_.retention;
+	auto expired = [cutoff](const std::unique_ptr<Segment> &segment) {
+		if (segment->writable || segment->max_time >= cutoff) {
+			return false;
+		}
+		unlink(segment->path.c_str());
+		return true;
+	};
+	segments_.erase(std::remove_if(segments_.begin(), segments_.end(), expired), segments_.end());
+}
+
+uint64_t EventArchive::append(EventKind kind, std::chrono::system_clock::time_point time,
+	std::string_view player, std::string_view content) {
+	player = player.substr(0, MAX_PLAYER_LEN);
+	content = content.substr(0, MAX_CONTENT_LEN);
+	uint32_t size = record_size(player.size(), content.size());
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	Segment *segment = segments_.empty() ? nullptr : segments_.back().get();
+	bool need_roll = !segment || !segment->writable || !segment->data ||
+		segment->used + size > segment->mapped ||
+		(!segment->offsets.empty() && day_of(time) > segment->day);
+	if (need_roll) {
+		if (!roll_segment(time)) {
+			return 0;
+		}
+		segment = segments_.back().get();
+		if (segment->used + size > segment->mapped) {
+			return 0;
+		}
+	}
+
+	uint32_t offset = static_cast<uint32_t>(segment->used);
+	char *record = segment->data + offset;
+	RecordHeader header {};
+	header.magic = RECORD_MAGIC;
+	header.size = size;
+	header.seq = next_seq_;
+	header.time_ms = to_ms(time);
+	header.player_len = static_cast<uint16_t>(player.size());
+	header.kind = static_cast<uint8_t>(kind);
+	header.content_len = static_cast<uint32_t>(content.size());
+	// 先写内容再写头部，头部写入后记录才被扫描视为有效
+	std::memcpy(record + sizeof(RecordHeader), player.data(), player.size());
+	std::memcpy(record + sizeof(RecordHeader) + player.size(), content.data(), content.size());
+	std::memcpy(record, &header, sizeof(header));
+
+	segment->used += size;
+	segment->index(offset);
+	return next_seq_++;
+}
+
+ArchivedEvent EventArchive::read_event(const Segment &segment, uint32_t offset) {
+	const RecordHeader &header = segment.header_at(offset);
+	const char *payload = segment.data + offset + sizeof(RecordHeader);
+	ArchivedEvent event;
+	event.seq = header.seq;
+	event.kind = static_cast<EventKind>(header.kind);
+	event.time = from_ms(header.time_ms);
+	event.player.assign(payload, header.player_len);
+	event.content.assign(payload + header.player_len, header.content_len);
+	return event;
+}
+
+std::vector<ArchivedEvent> EventArchive::query(const HistoryQuery &query) const {
+	std::vector<ArchivedEvent> result;
+	if (query.limit == 0) {
+		return result;
+	}
+
+	std::string player = lower(query.player);
+	int64_t from_ms_value = query.from == std::chrono::system_clock::time_point::min() ? INT64_MIN : to_ms(query.from);
+	int64_t to_ms_value = query.to == std::chrono::system_clock::time_point::max() ? INT64_MAX : to_ms(query.to);
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	for (auto it = segments_.rbegin(); it != segments_.rend() && result.size() < query.limit; ++it) {
+		const Segment &segment = **it;
+		// 时间范围或序号范围不相交的段整段跳过
+		if (segment.offsets.empty() || segment.max_time < query.from || segment.min_time > query.to ||
+			(query.before_seq != 0 && segment.first_seq >= query.before_seq)) {
+			continue;
+		}
+
+		// 选择最窄的倒排表
+		const std::vector<uint32_t> *postings = &segment.offsets;
+		if (!player.empty()) {
+			auto found = segment.by_player.find(player);
+			if (found == segment.by_player.end()) {
+				continue;
+			}
+			postings = &found->second;
+		} else if (query.has_kind) {
+			postings = &segment.by_kind[static_cast<uint8_t>(query.kind) % 5];
+		}
+
+		for (auto p = postings->rbegin(); p != postings->rend() && result.size() < query.limit; ++p) {
+			const RecordHeader &header = segment.header_at(*p);
+			if (query.before_seq != 0 && header.seq >= query.before_seq) {
+				continue;
+			}
+			if (query.has_kind && header.kind != static_cast<uint8_t>(query.kind)) {
+				continue;
+			}
+			if (header.time_ms < from_ms_value || header.time_ms > to_ms_value) {
+				continue;
+			}
+			result.push_back(read_event(segment, *p));
+		}
+	}
+	return result;
+}
+
+uint64_t EventArchive::size() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	uint64_t count = 0;
+	for (const auto &segment : segments_) {
+		count += segment->offsets.size();
+	}
+	return count;
+}
+
+} // namespace dl
@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <event_hub.h>
+
+namespace dl {
+
+// ============================================================================
+// Subscriber 实现
+// ============================================================================
+
+bool EventHub::Subscriber::wait(std::string &out, std::chrono::milliseconds timeout) {
+	std::unique_lock<std::mutex> lock(mutex_);
+	cv_.wait_for(lock, timeout, [this] {
+		return !queue_.empty() || closed_;
+	});
+	if (closed_) {
+		return false;
+	}
+
+	for (const auto &message : queue_) {
+		out += *message;
+	}
+	queue_.clear();
+	return true;
+}
+
+// ============================================================================
+// EventHub 实现
+// ============================================================================
+
+EventHub::EventHub(size_t max_subscribers, size_t max_queued) : max_subscribers_(max_subscribers)
+															  , max_queued_(max_queued) {
+}
+
+std::shared_ptr<EventHub::Subscriber> EventHub::subscribe(const std::string &hello) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (closed_ || subscribers_.size() >= max_subscribers_) {
+		return nullptr;
+	}
+
+	auto subscriber = std::make_shared<Subscriber>();
+	if (!hello.empty()) {
+		subscriber->queue_.push_back(std::make_shared<const std::string>(hello));
+	}
+	subscribers_.push_back(subscriber);
+	return subscriber;
+}
+
+void EventHub::unsubscribe(const std::shared_ptr<Subscriber> &subscriber) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	subscribers_.erase(std::remove(subscribers_.begin(), subscribers_.end(), subscriber), subscribers_.end());
+}
+
+void EventHub::publish(const std::string &event, const std::string &data) {
+	auto message = std::make_shared<const std::string>(format(event, data));
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	for (const auto &subscriber : subscribers_) {
+		{
+			std::lock_guard<std::mutex> sub_lock(subscriber->mutex_);
+			if (subscriber->closed_) {
+				continue;
+			}
+			if (subscriber->queue_.size() >= max_queued_) {
+				// 客户端读得太慢，断开它而不是无限积压
+				subscriber->closed_ = true;
+				subscriber->queue_.clear();
+			} else {
+				subscriber->queue_.push_back(message);
+			}
+		}
+		subscriber->cv_.notify_one();
+	}
+}
+
+void EventHub::close() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	closed_ = true;
+	for (const auto &subscriber : subscribers_) {
+		{
+			std::lock_guard<std::mutex> sub_lock(subscriber->mutex_);
+			subscriber->closed_ = true;
+		}
+		subscriber->cv_.notify_one();
+	}
+}
+
+size_t EventHub::subscriber_count() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return subscribers_.size();
+}
+
+std::string EventHub::format(const std::string &event, const std::string &data) {
+	std::string message;
+	message.reserve(event.size() + data.size() + 16);
+	message += "event: ";
+	message += event;
+	message += "\ndata: ";
+	message += data;
+	message += "\n\n";
+	return message;
+}
+
+} // namespace dl
@@ -0,0 +1,83 @@
+#include <forbidden_matcher.h>
+#include <metrics.h>
+
+namespace dl {
+
+// ============================================================================
+// 辅助函数
+// ============================================================================
+
+// 归一化规则: 忽略空格和制表符，ASCII 字母转小写
+static bool normalize_char(char c, unsigned char &out) {
+	if (c == ' ' || c == '\t') {
+		return false;
+	}
+	if (c >= 'A' && c <= 'Z') {
+		c = static_cast<char>(c - 'A' + 'a');
+	}
+	out = static_cast<unsigned char>(c);
+	return true;
+}
+
+static std::string normalize(std::string_view s) {
+	std::string result;
+	result.reserve(s.size());
+	for (char c : s) {
+		unsigned char n;
+		if (normalize_char(c, n)) {
+			result += static_cast<char>(n);
+		}
+	}
+	return result;
+}
+
+// ============================================================================
+// ForbiddenCommandMatcher 实现
+// ============================================================================
+
+ForbiddenCommandMatcher::ForbiddenCommandMatcher() {
+	automaton_.build();
+}
+
+ForbiddenCommandMatcher::ForbiddenCommandMatcher(std::vector<ForbiddenCommand> commands) : commands_(std::move(commands)) {
+	for (size_t i = 0; i < commands_.size(); ++i) {
+		std::string keyword = normalize(commands_[i].command);
+		if (keyword.empty() && empty_keyword_ == SIZE_MAX) {
+			empty_keyword_ = i;
+		}
+		automaton_.add_pattern(keyword);
+	}
+	automaton_.build();
+}
+
+const ForbiddenCommand *ForbiddenCommandMatcher::match(std::string_view text) const {
+	if (commands_.empty()) {
+		return nullptr;
+	}
+
+	static Histogram &match_time = MetricsRegistry::global().histogram("dreamland_forbidden_match_seconds",
+		"Time spent matching a command against the forbidden list.");
+	ScopedTimer timer(match_time);
+
+	size_t best = empty_keyword_;
+	AhoCorasick::State state = AhoCorasick::ROOT;
+	for (char c : text) {
+		if (best == 0) {
+			break;
+		}
+		unsigned char n;
+		if (!normalize_char(c, n)) {
+			continue;
+		}
+		state = automaton_.step(state, n);
+		automaton_.for_each_match(state, [&best](AhoCorasick::PatternId id) {
+			if (id < best) {
+				best = id;
+			}
+		});
+	}
+
+	return best == SIZE_MAX ? nullptr : &commands_[best];
+}
+
+} // namespace dl
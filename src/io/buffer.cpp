@@ -1,4 +1,5 @@
 #include <io/buffer.h>
+#include <metrics.h>
 
 // 字符串缓冲区类，采用std::string对数据进行缓存
 // append实现思路为直接调用string的append函数以实现追加字符串
@@ -15,6 +16,13 @@
 
 namespace dl {
 
+// 压缩(丢弃已读部分)的次数，read_line 的原地压缩与 drain_lines 的交换都计入
+static Counter &compaction_counter() {
+	static Counter &counter = MetricsRegistry::global().counter("dreamland_buffer_compactions_total",
+		"Times a string buffer discarded its consumed prefix.");
+	return counter;
+}
+
 // 构造函数
 Buffer::Buffer(uint64_t max_deleted_buffer_size) : MAX_DELETED_BUFFER_SIZE(max_deleted_buffer_size) {
 }
@@ -51,14 +59,52 @@ std::string Buffer::read_line() {
 	// 更新buffer_ptr_指向位置
 	buffer_ptr_ = newline_pos + 1;
 
-	// 重分配
+	// 原地压缩(erase内部为memmove，不会重新分配内存)
 	if (buffer_ptr_ >= MAX_DELETED_BUFFER_SIZE) { // 已读取部分大于阈值
-		buffer_ = buffer_.substr(buffer_ptr_);
+		buffer_.erase(0, buffer_ptr_);
 		buffer_ptr_ = 0;
+		compaction_counter().inc();
 	}
 
 	return result;
 }
+
+// 批量读取所有完整行
+// 加锁期间只做一件事：把包含所有完整行的buffer_整体交换到消费者侧的drain_buffer_，再把末尾不完整的半行拷回buffer_
+// 这样只需拷贝残余的半行(通常很短)，回调在锁外执行，生产者(读取线程)不会被日志处理阻塞
+// 两个string交替使用，容量都会被保留，稳定运行后不再发生内存分配
+size_t Buffer::drain_lines(const LineCallback &callback) {
+	uint64_t begin;
+	uint64_t end;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (buffer_ptr_ >= buffer_.size()) {
+			return 0;
+		}
+		uint64_t last_newline = buffer_.rfind('\n');
+		if (last_newline == std::string::npos || last_newline < buffer_ptr_) {
+			return 0;
+		}
+
+		begin = buffer_ptr_;
+		end = last_newline + 1;
+		drain_buffer_.swap(buffer_);
+		buffer_.assign(drain_buffer_, end, std::string::npos);
+		buffer_ptr_ = 0;
+	}
+	compaction_counter().inc();
+
+	size_t count = 0;
+	std::string_view data(drain_buffer_);
+	while (begin < end) {
+		uint64_t newline_pos = data.find('\n', begin);
+		callback(data.substr(begin, newline_pos - begin));
+		begin = newline_pos + 1;
+		++count;
+	}
+	return count;
+}
+
 std::string Buffer::read_all() {
 	std::lock_guard<std::mutex> lock(mutex_);
 	// 检查缓冲区指针指向的位置是否越界
@@ -69,8 +115,9 @@ std::string Buffer::read_all() {
 	// 存储结果
 	std::string result = buffer_.substr(buffer_ptr_);
 
-	// 直接清除buffer_
-	clear();
+	// 直接清除buffer_(已持有锁，不能再调用clear())
+	buffer_.clear();
+	buffer_ptr_ = 0;
 
 	return result;
 }
@@ -86,4 +133,9 @@ bool Buffer::empty() const {
 	return buffer_ptr_ >= buffer_.size();
 }
 
+uint64_t Buffer::buffered_bytes() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return buffer_ptr_ >= buffer_.size() ? 0 : buffer_.size() - buffer_ptr_;
+}
+
 }
@@ -0,0 +1,236 @@
+#include <io/journal.h>
+#include <io/mapped_file.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <logger.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// 追加式日志(journal)
+// 每次数据变更只在内存队列中追加一行记录，由后台写线程批量写入文件，并且每批只调用一次fdatasync，
+// 这样调用方(例如日志线程)永远不需要等待磁盘IO。
+// 当journal积累到一定大小(或距离上次压缩超过一定时间)时，写线程调用所有者提供的快照回调，
+// 将完整状态写入快照文件，成功后截断journal。
+// 记录必须是幂等的状态赋值(如"玩家X被封禁，信息为..."、"玩家X被解封")，并且所有者必须先修改内存状态再追加记录，
+// 这样即使压缩之后又写入了一些已经包含在快照里的记录，重放时也只是重复赋值，结果仍然是最新状态。
+
+namespace dl {
+
+// ============================================================================
+// 辅助函数
+// ============================================================================
+
+static bool write_all(int fd, const char *data, size_t len) {
+	while (len > 0) {
+		ssize_t written = write(fd, data, len);
+		if (written == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		data += written;
+		len -= static_cast<size_t>(written);
+	}
+	return true;
+}
+
+bool write_file_atomically(const std::string &path, std::string_view content) {
+	std::string tmp_path = path + ".tmp";
+	int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd == -1) {
+		return false;
+	}
+
+	bool ok = write_all(fd, content.data(), content.size()) && fsync(fd) == 0;
+	ok = (close(fd) == 0) && ok;
+	if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0) {
+		unlink(tmp_path.c_str());
+		return false;
+	}
+	return true;
+}
+
+// ============================================================================
+// Journal 实现
+// ============================================================================
+
+Journal::Journal(const std::string &path, SnapshotCallback snapshot) : Journal(path, std::move(snapshot), Options()) {
+}
+
+Journal::Journal(const std::string &path, SnapshotCallback snapshot, Options options) : path_(path)
+	, snapshot_(std::move(snapshot))
+	, options_(options) {
+	fd_ = open(path_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	if (fd_ == -1) {
+		log_error() << "[Journal] 无法打开日志文件: " << path_;
+	} else {
+		struct stat st {};
+		if (fstat(fd_, &st) == 0) {
+			journal_bytes_ = static_cast<uint64_t>(st.st_size);
+		}
+	}
+
+	writer_thread_ = std::thread(&Journal::writer_thread_func, this);
+}
+
+Journal::~Journal() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+	}
+	cv_.notify_all();
+	if (writer_thread_.joinable()) {
+		writer_thread_.join();
+	}
+	if (fd_ != -1) {
+		close(fd_);
+	}
+}
+
+size_t Journal::replay(const std::string &path, const RecordCallback &callback) {
+	MappedFile file;
+	if (!file.open(path)) {
+		return 0;
+	}
+	std::string_view content = file.view();
+
+	// 最后一行如果没有换行符，说明写入时被中断，直接丢弃
+	size_t count = 0;
+	size_t begin = 0;
+	while (true) {
+		size_t end = content.find('\n', begin);
+		if (end == std::string_view::npos) {
+			break;
+		}
+		if (end > begin) {
+			callback(content.substr(begin, end - begin));
+			++count;
+		}
+		begin = end + 1;
+	}
+	return count;
+}
+
+void Journal::append(std::string record) {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		queue_.push_back(std::move(record));
+		++queued_seq_;
+	}
+	cv_.notify_one();
+}
+
+void Journal::flush() {
+	std::unique_lock<std::mutex> lock(mutex_);
+	uint64_t target = queued_seq_;
+	cv_.notify_one();
+	done_cv_.wait(lock, [&] {
+		return written_seq_ >= target || stop_;
+	});
+}
+
+bool Journal::compact() {
+	std::unique_lock<std::mutex> lock(mutex_);
+	uint64_t target = ++compact_requested_;
+	cv_.notify_one();
+	done_cv_.wait(lock, [&] {
+		return compact_done_ >= target || stop_;
+	});
+	return last_compact_ok_;
+}
+
+void Journal::writer_thread_func() {
+	auto last_compact = std::chrono::steady_clock::now();
+	std::vector<std::string> batch;
+
+	while (true) {
+		uint64_t batch_seq;
+		uint64_t compact_target;
+		bool stopping;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			cv_.wait_for(lock, options_.compact_interval, [this] {
+				return !queue_.empty() || stop_ || compact_requested_ > compact_done_;
+			});
+			batch.swap(queue_);
+			batch_seq = queued_seq_;
+			compact_target = compact_requested_;
+			stopping = stop_;
+		}
+
+		if (!batch.empty()) {
+			write_batch(batch);
+			batch.clear();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			written_seq_ = batch_seq;
+		}
+		done_cv_.notify_all();
+
+		// 压缩条件: 被请求、超过大小阈值、或距上次压缩超过间隔且有待压缩记录
+		auto now = std::chrono::steady_clock::now();
+		bool wanted = compact_target > compact_done_
+			|| journal_bytes_ >= options_.compact_bytes
+			|| (journal_bytes_ > 0 && now - last_compact >= options_.compact_interval);
+		if (wanted) {
+			bool ok = do_compact();
+			last_compact = now;
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				last_compact_ok_ = ok;
+				compact_done_ = compact_target;
+			}
+			done_cv_.notify_all();
+		}
+
+		if (stopping) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (queue_.empty()) {
+				break;
+			}
+		}
+	}
+}
+
+void Journal::write_batch(const std::vector<std::string> &batch) {
+	if (fd_ == -1) {
+		return;
+	}
+
+	std::string data;
+	size_t total = 0;
+	for (const auto &record : batch) {
+		total += record.size() + 1;
+	}
+	data.reserve(total);
+	for (const auto &record : batch) {
+		data += record;
+		data += '\n';
+	}
+
+	if (!write_all(fd_, data.data(), data.size())) {
+		log_error() << "[Journal] 写入失败: " << path_;
+		return;
+	}
+	fdatasync(fd_);
+	journal_bytes_ += data.size();
+}
+
+bool Journal::do_compact() {
+	if (!snapshot_ || !snapshot_()) {
+		log_error() << "[Journal] 快照写入失败，保留日志: " << path_;
+		return false;
+	}
+	if (fd_ != -1) {
+		if (ftruncate(fd_, 0) == 0) {
+			fdatasync(fd_);
+			journal_bytes_ = 0;
+		}
+	}
+	return true;
+}
+
+}
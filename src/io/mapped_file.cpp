@@ -0,0 +1,67 @@
+#include <io/mapped_file.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+namespace dl {
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+	: data_(std::exchange(other.data_, nullptr))
+	, size_(std::exchange(other.size_, 0)) {
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+	if (this != &other) {
+		close();
+		data_ = std::exchange(other.data_, nullptr);
+		size_ = std::exchange(other.size_, 0);
+	}
+	return *this;
+}
+
+bool MappedFile::open(const std::string &path) {
+	close();
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd == -1) {
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) == -1) {
+		::close(fd);
+		return false;
+	}
+	// mmap rejects a zero length, an empty file is simply an empty view
+	if (st.st_size == 0) {
+		::close(fd);
+		return true;
+	}
+
+	size_t size = static_cast<size_t>(st.st_size);
+	void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// The mapping keeps its own reference to the file
+	::close(fd);
+	if (data == MAP_FAILED) {
+		return false;
+	}
+	// Loaders read the file once from start to end
+	madvise(data, size, MADV_SEQUENTIAL);
+	data_ = static_cast<const char *>(data);
+	size_ = size;
+	return true;
+}
+
+void MappedFile::close() {
+	if (data_) {
+		munmap(const_cast<char *>(data_), size_);
+		data_ = nullptr;
+		size_ = 0;
+	}
+}
+
+}
@@ -1,19 +1,88 @@
 #include <io/program.h>
+#include <metrics.h>
 #include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <sys/uio.h>
 #include <sys/wait.h>
 #include <signal.h>
 #include <fcntl.h>
+#include <cerrno>
+#include <climits>
 #include <cstring>
 #include <vector>
 
 namespace dl {
 
-Program::Program(const std::string& command)
+Program::Program(const std::string& command, Reactor* reactor)
     : command_(command),
+      reactor_(reactor),
       stdout_buffer_(std::make_unique<Buffer>()),
       stderr_buffer_(std::make_unique<Buffer>()) {
 }
 
+// Open a pidfd for the child so the reactor can wait on its exit.
+// Returns -1 on kernels without pidfd_open, the program then falls back to timed waitpid.
+static int open_pidfd(pid_t pid) {
+#ifdef SYS_pidfd_open
+    int fd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+    if (fd >= 0) {
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+    return fd;
+#else
+    (void)pid;
+    return -1;
+#endif
+}
+
+// Make fd the child's target descriptor (called between fork and exec).
+// dup2 clears O_CLOEXEC on the copy; when the pipe already landed on the target
+// number dup2 is a no-op, so the flag has to be cleared by hand instead.
+static void redirect_fd(int fd, int target) {
+    if (fd == target) {
+        fcntl(fd, F_SETFD, 0);
+        return;
+    }
+    dup2(fd, target);
+    close(fd);
+}
+
+bool Program::set_buffer_options(IOStreamType type, const BufferOptions& options) {
+    if (running_) {
+        return false;
+    }
+
+    std::unique_ptr<StreamBuffer> buffer;
+    if (options.backend == BufferOptions::Backend::RING) {
+        buffer = std::make_unique<RingBuffer>(options.ring_capacity, options.overflow);
+    } else {
+        buffer = std::make_unique<Buffer>();
+    }
+
+    if (type == IOStreamType::STDOUT) {
+        stdout_buffer_ = std::move(buffer);
+    } else {
+        stderr_buffer_ = std::move(buffer);
+    }
+    return true;
+}
+
+uint64_t Program::dropped_bytes(IOStreamType type) const {
+    return buffer_of(type)->dropped_bytes();
+}
+
+uint64_t Program::buffered_bytes(IOStreamType type) const {
+    return buffer_of(type)->buffered_bytes();
+}
+
+StreamBuffer* Program::buffer_of(IOStreamType type) const {
+    return (type == IOStreamType::STDOUT) ? stdout_buffer_.get()
+                                          : stderr_buffer_.get();
+}
+
 Program::~Program() {
     if (running_) {
         kill();
@@ -27,18 +96,27 @@ bool Program::run() {
         return false;
     }
 
-    // Create pipes for stdin, stdout, stderr
-    if (pipe(stdin_pipe_) == -1 ||
-        pipe(stdout_pipe_) == -1 ||
-        pipe(stderr_pipe_) == -1) {
-        close_pipes();
+    // Release resources left over from a previous run
+    cleanup();
+
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ == -1) {
+        return false;
+    }
+
+    // Create pipes for stdin, stdout, stderr; close-on-exec so that instances
+    // started later from this process do not inherit this instance's pipe ends
+    if (pipe2(stdin_pipe_, O_CLOEXEC) == -1 ||
+        pipe2(stdout_pipe_, O_CLOEXEC) == -1 ||
+        pipe2(stderr_pipe_, O_CLOEXEC) == -1) {
+        cleanup();
         return false;
     }
 
     // Fork child process
     child_pid_ = fork();
     if (child_pid_ == -1) {
-        close_pipes();
+        cleanup();
         return false;
     }
 
@@ -46,18 +124,15 @@ bool Program::run() {
         // Child process
         // Redirect stdin
         close(stdin_pipe_[1]);
-        dup2(stdin_pipe_[0], STDIN_FILENO);
-        close(stdin_pipe_[0]);
+        redirect_fd(stdin_pipe_[0], STDIN_FILENO);
 
         // Redirect stdout
         close(stdout_pipe_[0]);
-        dup2(stdout_pipe_[1], STDOUT_FILENO);
-        close(stdout_pipe_[1]);
+        redirect_fd(stdout_pipe_[1], STDOUT_FILENO);
 
         // Redirect stderr
         close(stderr_pipe_[0]);
-        dup2(stderr_pipe_[1], STDERR_FILENO);
-        close(stderr_pipe_[1]);
+        redirect_fd(stderr_pipe_[1], STDERR_FILENO);
 
         // Execute command using shell
         execl("/bin/sh", "sh", "-c", command_.c_str(), nullptr);
@@ -75,97 +150,310 @@ bool Program::run() {
     close(stderr_pipe_[1]);
     stderr_pipe_[1] = -1;
 
-    // Set stdout and stderr pipes to non-blocking mode
+    // Set stdout and stderr pipes to non-blocking mode; stdin too, a full pipe
+    // must never stall the reactor
     fcntl(stdout_pipe_[0], F_SETFL, O_NONBLOCK);
     fcntl(stderr_pipe_[0], F_SETFL, O_NONBLOCK);
+    fcntl(stdin_pipe_[1], F_SETFL, O_NONBLOCK);
+
+    pid_fd_ = open_pidfd(child_pid_);
+    if (pid_fd_ == -1) {
+        // Without a pidfd the child exit can only be noticed by polling waitpid
+        poll_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        itimerspec interval {};
+        interval.it_interval.tv_nsec = 100 * 1000 * 1000;
+        interval.it_value = interval.it_interval;
+        timerfd_settime(poll_fd_, 0, &interval, nullptr);
+    }
 
-    running_ = true;
-    stop_reader_ = false;
+    stdout_buffer_->set_closed(false);
+    stderr_buffer_->set_closed(false);
+    {
+        std::lock_guard<std::mutex> lock(stdin_mutex_);
+        running_ = true;
+    }
 
-    // Start reader thread
-    reader_thread_ = std::thread(&Program::reader_thread_func, this);
-    reader_thread_.detach();
+    if (!reactor_) {
+        own_reactor_ = std::make_unique<Reactor>();
+        reactor_ = own_reactor_.get();
+    }
+    // Commands queued before this point are flushed as soon as the wake fd is
+    // watched, it stays readable until drained
+    if (!watch_all()) {
+        ::kill(child_pid_, SIGKILL);
+        waitpid(child_pid_, nullptr, 0);
+        cleanup();
+        return false;
+    }
 
     return true;
 }
 
-void Program::reader_thread_func() {
-    constexpr size_t BUFFER_SIZE = 4096;
-    char buffer[BUFFER_SIZE];
+bool Program::watch_all() {
+    bool ok = reactor_->add(stdout_pipe_[0], EPOLLIN, [this](uint32_t) {
+        handle_output(stdout_pipe_[0], stdout_buffer_.get());
+    });
+    ok = ok && reactor_->add(stderr_pipe_[0], EPOLLIN, [this](uint32_t) {
+        handle_output(stderr_pipe_[0], stderr_buffer_.get());
+    });
+    ok = ok && reactor_->add(wake_fd_, EPOLLIN, [this](uint32_t) {
+        handle_wake();
+    });
+    int child_fd = (pid_fd_ != -1) ? pid_fd_ : poll_fd_;
+    ok = ok && reactor_->add(child_fd, EPOLLIN, [this, child_fd](uint32_t) {
+        handle_child_event(child_fd);
+    });
+    return ok;
+}
 
-    while (!stop_reader_) {
-        bool has_data = false;
+void Program::unwatch_all() {
+    if (!reactor_) {
+        return;
+    }
+    for (int fd : { stdout_pipe_[0], stderr_pipe_[0], wake_fd_, pid_fd_, poll_fd_, stdin_pipe_[1] }) {
+        if (fd != -1) {
+            reactor_->remove(fd);
+        }
+    }
+}
 
-        // Read from stdout
-        ssize_t bytes_read = read(stdout_pipe_[0], buffer, BUFFER_SIZE - 1);
-        if (bytes_read > 0) {
-            buffer[bytes_read] = '\0';
-            stdout_buffer_->append(buffer, bytes_read);
-            has_data = true;
+void Program::handle_output(int fd, StreamBuffer* buffer) {
+    if (!drain_fd(fd, buffer)) {
+        // Write end closed, stop watching to avoid a hot EPOLLHUP loop
+        reactor_->remove(fd);
+    }
+    notify_output();
+}
+
+void Program::handle_wake() {
+    uint64_t value;
+    while (read(wake_fd_, &value, sizeof(value)) > 0) {
+    }
+    flush_stdin();
+}
+
+void Program::handle_child_event(int fd) {
+    if (fd == poll_fd_) {
+        uint64_t expirations;
+        ssize_t ignored = read(poll_fd_, &expirations, sizeof(expirations));
+        (void)ignored;
+    }
+    if (try_reap_child()) {
+        unwatch_all();
+    }
+}
+
+void Program::flush_stdin() {
+    {
+        std::lock_guard<std::mutex> lock(stdin_mutex_);
+        for (auto& pending : stdin_queue_) {
+            stdin_inflight_.push_back(std::move(pending));
         }
+        stdin_queue_.clear();
+    }
 
-        // Read from stderr
-        bytes_read = read(stderr_pipe_[0], buffer, BUFFER_SIZE - 1);
-        if (bytes_read > 0) {
-            buffer[bytes_read] = '\0';
-            stderr_buffer_->append(buffer, bytes_read);
-            has_data = true;
+    // Everything queued so far goes out in as few writev() calls as possible
+    constexpr size_t MAX_IOV = IOV_MAX < 256 ? IOV_MAX : 256;
+    iovec iov[MAX_IOV];
+    bool failed = false;
+    uint64_t written_bytes = 0;
+
+    while (!stdin_inflight_.empty()) {
+        size_t count = 0;
+        for (auto it = stdin_inflight_.begin(); it != stdin_inflight_.end() && count < MAX_IOV; ++it) {
+            iov[count].iov_base = const_cast<char*>(it->data.data()) + it->offset;
+            iov[count].iov_len = it->data.size() - it->offset;
+            ++count;
         }
 
-        // Check if child process has exited
-        int status;
-        pid_t result = waitpid(child_pid_, &status, WNOHANG);
-        if (result == child_pid_) {
-            // Child has exited, read remaining data
-            while ((bytes_read = read(stdout_pipe_[0], buffer, BUFFER_SIZE - 1)) > 0) {
-                stdout_buffer_->append(buffer, bytes_read);
-            }
-            while ((bytes_read = read(stderr_pipe_[0], buffer, BUFFER_SIZE - 1)) > 0) {
-                stderr_buffer_->append(buffer, bytes_read);
+        ssize_t written = writev(stdin_pipe_[1], iov, static_cast<int>(count));
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
             }
+            // EAGAIN: pipe full, the rest waits for EPOLLOUT
+            failed = !(errno == EAGAIN || errno == EWOULDBLOCK);
+            break;
+        }
 
-            if (WIFEXITED(status)) {
-                exit_code_ = WEXITSTATUS(status);
-            } else if (WIFSIGNALED(status)) {
-                exit_code_ = -WTERMSIG(status);
+        size_t left = static_cast<size_t>(written);
+        while (!stdin_inflight_.empty()) {
+            PendingWrite& front = stdin_inflight_.front();
+            size_t remaining = front.data.size() - front.offset;
+            if (left < remaining) {
+                front.offset += left;
+                break;
             }
-            running_ = false;
-            break;
+            left -= remaining;
+            written_bytes += front.data.size();
+            front.done.set_value(true);
+            stdin_inflight_.pop_front();
         }
+    }
+
+    if (written_bytes > 0) {
+        std::lock_guard<std::mutex> lock(stdin_mutex_);
+        stdin_queued_bytes_ -= written_bytes;
+    }
+    if (failed) {
+        fail_pending_writes();
+    }
 
-        // Sleep briefly if no data to avoid busy waiting
-        if (!has_data) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    // Watch for EPOLLOUT only while the pipe is full, otherwise it would fire constantly
+    bool want_writable = !stdin_inflight_.empty();
+    if (want_writable != stdin_watched_) {
+        if (want_writable) {
+            reactor_->add(stdin_pipe_[1], EPOLLOUT, [this](uint32_t) {
+                flush_stdin();
+            });
+        } else {
+            reactor_->remove(stdin_pipe_[1]);
         }
+        stdin_watched_ = want_writable;
     }
 }
 
-bool Program::send_string(const std::string& data) {
-    if (!running_ || stdin_pipe_[1] == -1) {
-        return false;
+void Program::fail_pending_writes() {
+    std::deque<PendingWrite> dropped;
+    {
+        std::lock_guard<std::mutex> lock(stdin_mutex_);
+        dropped.swap(stdin_queue_);
+        stdin_queued_bytes_ = 0;
+    }
+    for (auto& pending : stdin_inflight_) {
+        pending.done.set_value(false);
+    }
+    stdin_inflight_.clear();
+    for (auto& pending : dropped) {
+        pending.done.set_value(false);
+    }
+}
+
+void Program::wake_reactor() {
+    if (wake_fd_ != -1) {
+        uint64_t one = 1;
+        ssize_t ignored = write(wake_fd_, &one, sizeof(one));
+        (void)ignored;
     }
+}
 
-    ssize_t total_written = 0;
-    ssize_t data_size = static_cast<ssize_t>(data.size());
+bool Program::drain_fd(int fd, StreamBuffer* buffer) {
+    constexpr size_t BUFFER_SIZE = 4096;
+    char chunk[BUFFER_SIZE];
 
-    while (total_written < data_size) {
-        ssize_t written = write(stdin_pipe_[1], data.c_str() + total_written,
-                                data_size - total_written);
-        if (written == -1) {
-            if (errno == EINTR) {
-                continue;
-            }
+    // Shared by every program; rates come from the scraper
+    static Counter& stdout_bytes = MetricsRegistry::global().counter("dreamland_program_read_bytes_total",
+        "Bytes read from child output pipes.", {{"stream", "stdout"}});
+    static Counter& stderr_bytes = MetricsRegistry::global().counter("dreamland_program_read_bytes_total",
+        "Bytes read from child output pipes.", {{"stream", "stderr"}});
+    Counter& bytes = (buffer == stdout_buffer_.get()) ? stdout_bytes : stderr_bytes;
+
+    while (true) {
+        ssize_t bytes_read = read(fd, chunk, BUFFER_SIZE);
+        if (bytes_read > 0) {
+            buffer->append(chunk, bytes_read);
+            bytes.inc(static_cast<uint64_t>(bytes_read));
+            continue;
+        }
+        if (bytes_read == 0) {
             return false;
         }
-        total_written += written;
+        if (errno == EINTR) {
+            continue;
+        }
+        // EAGAIN: pipe drained for now
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+}
+
+bool Program::try_reap_child() {
+    int status;
+    pid_t result = waitpid(child_pid_, &status, WNOHANG);
+    if (result != child_pid_) {
+        return false;
     }
 
+    // Child has exited, read remaining data
+    drain_fd(stdout_pipe_[0], stdout_buffer_.get());
+    drain_fd(stderr_pipe_[0], stderr_buffer_.get());
+
+    if (WIFEXITED(status)) {
+        exit_code_ = WEXITSTATUS(status);
+    } else if (WIFSIGNALED(status)) {
+        exit_code_ = -WTERMSIG(status);
+    }
+    {
+        std::lock_guard<std::mutex> lock(stdin_mutex_);
+        running_ = false;
+    }
+    // Nothing will ever read these commands
+    fail_pending_writes();
+    notify_output();
     return true;
 }
 
+void Program::notify_output() {
+    output_seq_.fetch_add(1);
+    // Only take the lock when somebody is actually waiting
+    if (output_waiters_.load() > 0) {
+        std::lock_guard<std::mutex> lock(output_mutex_);
+        output_cv_.notify_all();
+    }
+}
+
+uint64_t Program::output_sequence() const {
+    return output_seq_.load();
+}
+
+bool Program::wait_for_output(uint64_t last_sequence, std::chrono::milliseconds timeout) {
+    output_waiters_.fetch_add(1);
+    bool changed;
+    {
+        std::unique_lock<std::mutex> lock(output_mutex_);
+        changed = output_cv_.wait_for(lock, timeout, [&] {
+            return output_seq_.load() != last_sequence;
+        });
+    }
+    output_waiters_.fetch_sub(1);
+    return changed;
+}
+
+void Program::wake_output_waiters() {
+    notify_output();
+}
+
+bool Program::send_string(const std::string& data) {
+    std::future<bool> result = send_string_async(data);
+    // A rejected send is resolved immediately, an accepted one is still pending
+    return result.wait_for(std::chrono::seconds(0)) != std::future_status::ready || result.get();
+}
+
+std::future<bool> Program::send_string_async(std::string data) {
+    PendingWrite pending;
+    pending.data = std::move(data);
+    std::future<bool> result = pending.done.get_future();
+
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lock(stdin_mutex_);
+        if (!running_ || stdin_pipe_[1] == -1 ||
+            stdin_queued_bytes_ + pending.data.size() > MAX_STDIN_QUEUE_BYTES) {
+            pending.done.set_value(false);
+            return result;
+        }
+        stdin_queued_bytes_ += pending.data.size();
+        // The reactor takes the whole queue at once, so only the first producer has to wake it
+        wake = stdin_queue_.empty();
+        stdin_queue_.push_back(std::move(pending));
+    }
+    if (wake) {
+        wake_reactor();
+    }
+    return result;
+}
+
 std::string Program::read_string(bool read_by_line, IOStreamType type) {
-    Buffer* buffer = (type == IOStreamType::STDOUT)      ? stdout_buffer_.get()
-                     : stderr_buffer_.get();
+    StreamBuffer* buffer = buffer_of(type);
 
     if (read_by_line) {
         return buffer->read_line();
@@ -173,6 +461,10 @@ std::string Program::read_string(bool read_by_line, IOStreamType type) {
     return buffer->read_all();
 }
 
+size_t Program::drain_lines(const StreamBuffer::LineCallback& callback, IOStreamType type) {
+    return buffer_of(type)->drain_lines(callback);
+}
+
 bool Program::stop() {
     if (!running_ || child_pid_ <= 0) {
         return false;
@@ -224,8 +516,31 @@ void Program::close_pipes() {
 }
 
 void Program::cleanup() {
-    stop_reader_ = true;
+    // Release a handler blocked on a full ring buffer, then make sure no handler
+    // of this program runs any more before the descriptors are closed
+    stdout_buffer_->set_closed(true);
+    stderr_buffer_->set_closed(true);
+    unwatch_all();
+    {
+        std::lock_guard<std::mutex> lock(stdin_mutex_);
+        running_ = false;
+    }
+    fail_pending_writes();
+    stdin_watched_ = false;
+
     close_pipes();
+    if (wake_fd_ != -1) {
+        close(wake_fd_);
+        wake_fd_ = -1;
+    }
+    if (pid_fd_ != -1) {
+        close(pid_fd_);
+        pid_fd_ = -1;
+    }
+    if (poll_fd_ != -1) {
+        close(poll_fd_);
+        poll_fd_ = -1;
+    }
 }
 
 }
@@ -0,0 +1,149 @@
+#include <io/reactor.h>
+#include <cerrno>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace dl {
+
+Reactor::Reactor() {
+	epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+	wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (epoll_fd_ != -1 && wake_fd_ != -1) {
+		epoll_event ev {};
+		ev.events = EPOLLIN;
+		ev.data.u64 = 0;
+		epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev);
+	}
+	thread_ = std::thread(&Reactor::thread_func, this);
+}
+
+Reactor::~Reactor() {
+	stop_ = true;
+	if (wake_fd_ != -1) {
+		uint64_t one = 1;
+		ssize_t ignored = write(wake_fd_, &one, sizeof(one));
+		(void)ignored;
+	}
+	if (thread_.joinable()) {
+		thread_.join();
+	}
+	if (wake_fd_ != -1) {
+		close(wake_fd_);
+	}
+	if (epoll_fd_ != -1) {
+		close(epoll_fd_);
+	}
+}
+
+bool Reactor::add(int fd, uint32_t events, Handler handler) {
+	if (fd == -1 || epoll_fd_ == -1) {
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (ids_.count(fd) > 0) {
+		return false;
+	}
+	uint64_t id = next_id_++;
+	epoll_event ev {};
+	ev.events = events;
+	ev.data.u64 = id;
+	if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) == -1) {
+		return false;
+	}
+	registrations_[id] = Registration { fd, std::make_shared<Handler>(std::move(handler)) };
+	ids_[fd] = id;
+	return true;
+}
+
+void Reactor::remove(int fd) {
+	std::unique_lock<std::mutex> lock(mutex_);
+	auto it = ids_.find(fd);
+	if (it == ids_.end()) {
+		return;
+	}
+	epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+	registrations_.erase(it->second);
+	ids_.erase(it);
+
+	// Later rounds can no longer find the registration, only the current one may
+	// still be inside its handler
+	if (in_reactor_thread() || !dispatching_) {
+		return;
+	}
+	uint64_t round = rounds_;
+	round_cv_.wait(lock, [&] {
+		return rounds_ != round;
+	});
+}
+
+bool Reactor::in_reactor_thread() const {
+	return std::this_thread::get_id() == thread_.get_id();
+}
+
+size_t Reactor::size() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return registrations_.size();
+}
+
+void Reactor::thread_func() {
+	// Handlers write to child stdin pipes on this thread; with SIGPIPE blocked a
+	// child that closed its stdin shows up as EPIPE instead of killing the process
+	sigset_t sigpipe;
+	sigemptyset(&sigpipe);
+	sigaddset(&sigpipe, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &sigpipe, nullptr);
+
+	constexpr int MAX_EVENTS = 64;
+	epoll_event events[MAX_EVENTS];
+
+	while (!stop_ && epoll_fd_ != -1) {
+		int n = epoll_wait(epoll_fd_, events, MAX_EVENTS, -1);
+		if (n == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			dispatching_ = true;
+		}
+		for (int i = 0; i < n; ++i) {
+			uint64_t id = events[i].data.u64;
+			if (id == 0) {
+				uint64_t value;
+				while (read(wake_fd_, &value, sizeof(value)) > 0) {
+				}
+				continue;
+			}
+
+			std::shared_ptr<Handler> handler;
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				auto it = registrations_.find(id);
+				if (it == registrations_.end()) {
+					continue;
+				}
+				handler = it->second.handler;
+			}
+			(*handler)(events[i].events);
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			dispatching_ = false;
+			rounds_++;
+		}
+		round_cv_.notify_all();
+	}
+
+	// Consume a SIGPIPE raised by a failed write so it is not left pending
+	timespec zero {};
+	while (sigtimedwait(&sigpipe, nullptr, &zero) == SIGPIPE) {
+	}
+}
+
+}
@@ -0,0 +1,279 @@
+#include <io/ring_buffer.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+// 单生产者/单消费者无锁环形缓冲区
+// 生产者(Program读取线程)只推进head_，消费者(日志线程)只推进tail_，二者都是只增不减的绝对位置，
+// 实际下标为 位置 & mask_，因此容量必须是2的幂。数据路径上没有任何锁，只有两个原子变量的读写。
+// 溢出策略:
+//   BLOCK: 写满时生产者等待消费者腾出空间(等待时才会用到互斥锁和条件变量)，不丢数据，压力会反馈到子进程的管道上
+//   DROP_OLDEST: 写满时生产者直接把tail_向前推进到某一行的开头，丢弃最旧的完整行，被丢弃的字节数计入dropped_bytes_
+// DROP_OLDEST下生产者也会修改tail_，因此消费者读取时采用"先拷贝，再CAS提交"的方式:
+// 如果CAS失败说明拷贝期间生产者丢弃(并可能覆盖)了这段数据，此时丢掉拷贝结果重新读取即可
+
+namespace dl {
+
+static uint64_t round_up_pow2(uint64_t v) {
+	if (v < 64) {
+		v = 64;
+	}
+	--v;
+	v |= v >> 1;
+	v |= v >> 2;
+	v |= v >> 4;
+	v |= v >> 8;
+	v |= v >> 16;
+	v |= v >> 32;
+	return v + 1;
+}
+
+RingBuffer::RingBuffer(uint64_t capacity, OverflowPolicy policy) : capacity_(round_up_pow2(capacity))
+																 , mask_(capacity_ - 1)
+																 , policy_(policy)
+																 , data_(new char[capacity_]) {
+}
+
+// ============================================================================
+// 生产者
+// ============================================================================
+
+void RingBuffer::append(const std::string &data) {
+	append(data.data(), data.size());
+}
+
+void RingBuffer::append(const char *data, uint64_t len) {
+	if (data == nullptr || len == 0) {
+		return;
+	}
+
+	// head_只有生产者会修改
+	uint64_t head = head_.load(std::memory_order_relaxed);
+
+	if (policy_ == OverflowPolicy::DROP_OLDEST && len > capacity_) {
+		// 单次写入就超过容量，只保留最后capacity_个字节
+		dropped_bytes_.fetch_add(len - capacity_);
+		overflow_count_.fetch_add(1);
+		data += len - capacity_;
+		len = capacity_;
+	}
+
+	while (len > 0) {
+		if (!reserve(head, std::min(len, capacity_))) {
+			// 已关闭，放弃剩余数据
+			dropped_bytes_.fetch_add(len);
+			return;
+		}
+
+		uint64_t free_space = capacity_ - (head - tail_.load(std::memory_order_acquire));
+		uint64_t n = std::min(len, free_space);
+
+		uint64_t offset = head & mask_;
+		uint64_t first = std::min(n, capacity_ - offset);
+		std::memcpy(data_.get() + offset, data, first);
+		std::memcpy(data_.get(), data + first, n - first);
+
+		head += n;
+		head_.store(head, std::memory_order_release);
+		data += n;
+		len -= n;
+	}
+}
+
+bool RingBuffer::reserve(uint64_t head, uint64_t len) {
+	if (policy_ == OverflowPolicy::DROP_OLDEST) {
+		while (true) {
+			uint64_t tail = tail_.load(std::memory_order_acquire);
+			if (head + len - tail <= capacity_) {
+				return true;
+			}
+			// 新的tail_至少要推进到need，再对齐到下一行的开头，避免消费者读到半行
+			uint64_t need = head + len - capacity_;
+			uint64_t newline = find_newline(need, head);
+			uint64_t new_tail = (newline < head) ? newline + 1 : head;
+			if (tail_.compare_exchange_weak(tail, new_tail)) {
+				dropped_bytes_.fetch_add(new_tail - tail);
+				overflow_count_.fetch_add(1);
+				return true;
+			}
+		}
+	}
+
+	// BLOCK: 只要有空间就先写一部分，完全写满时才等待
+	auto has_space = [this, head] {
+		return head - tail_.load(std::memory_order_acquire) < capacity_;
+	};
+	if (has_space()) {
+		return true;
+	}
+
+	overflow_count_.fetch_add(1);
+	while (!closed_.load()) {
+		producer_waiting_.store(true);
+		{
+			std::unique_lock<std::mutex> lock(space_mutex_);
+			space_cv_.wait_for(lock, std::chrono::milliseconds(100), [&] {
+				return closed_.load() || has_space();
+			});
+		}
+		producer_waiting_.store(false);
+		if (has_space()) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void RingBuffer::set_closed(bool closed) {
+	closed_.store(closed);
+	if (closed) {
+		std::lock_guard<std::mutex> lock(space_mutex_);
+		space_cv_.notify_all();
+	}
+}
+
+// ============================================================================
+// 消费者
+// ============================================================================
+
+bool RingBuffer::commit_read(uint64_t expected_tail, uint64_t new_tail) {
+	if (!tail_.compare_exchange_strong(expected_tail, new_tail)) {
+		return false;
+	}
+	// 生产者正在等待空间时才需要加锁唤醒
+	if (producer_waiting_.load()) {
+		std::lock_guard<std::mutex> lock(space_mutex_);
+		space_cv_.notify_one();
+	}
+	return true;
+}
+
+std::string RingBuffer::read_line() {
+	while (true) {
+		uint64_t tail = tail_.load(std::memory_order_acquire);
+		uint64_t head = head_.load(std::memory_order_acquire);
+		uint64_t newline = find_newline(tail, head);
+		if (newline == head) {
+			return "";
+		}
+
+		std::string result;
+		copy_out(tail, newline + 1, result);
+		if (commit_read(tail, newline + 1)) {
+			return result;
+		}
+	}
+}
+
+std::string RingBuffer::read_all() {
+	while (true) {
+		uint64_t tail = tail_.load(std::memory_order_acquire);
+		uint64_t head = head_.load(std::memory_order_acquire);
+		if (tail == head) {
+			return "";
+		}
+
+		std::string result;
+		copy_out(tail, head, result);
+		if (commit_read(tail, head)) {
+			return result;
+		}
+	}
+}
+
+size_t RingBuffer::drain_lines(const LineCallback &callback) {
+	while (true) {
+		uint64_t tail = tail_.load(std::memory_order_acquire);
+		uint64_t head = head_.load(std::memory_order_acquire);
+		uint64_t last_newline = rfind_newline(tail, head);
+		if (last_newline == head) {
+			return 0;
+		}
+
+		drain_buffer_.clear();
+		copy_out(tail, last_newline + 1, drain_buffer_);
+		if (commit_read(tail, last_newline + 1)) {
+			break;
+		}
+	}
+
+	size_t count = 0;
+	std::string_view data(drain_buffer_);
+	size_t begin = 0;
+	while (begin < data.size()) {
+		size_t newline_pos = data.find('\n', begin);
+		callback(data.substr(begin, newline_pos - begin));
+		begin = newline_pos + 1;
+		++count;
+	}
+	return count;
+}
+
+void RingBuffer::clear() {
+	while (true) {
+		uint64_t tail = tail_.load(std::memory_order_acquire);
+		uint64_t head = head_.load(std::memory_order_acquire);
+		if (tail == head || commit_read(tail, head)) {
+			return;
+		}
+	}
+}
+
+bool RingBuffer::empty() const {
+	return tail_.load(std::memory_order_acquire) == head_.load(std::memory_order_acquire);
+}
+
+uint64_t RingBuffer::buffered_bytes() const {
+	return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+}
+
+uint64_t RingBuffer::dropped_bytes() const {
+	return dropped_bytes_.load();
+}
+
+uint64_t RingBuffer::overflow_count() const {
+	return overflow_count_.load();
+}
+
+// ============================================================================
+// 环形区间辅助函数
+// ============================================================================
+
+void RingBuffer::copy_out(uint64_t from, uint64_t to, std::string &out) const {
+	uint64_t len = to - from;
+	uint64_t offset = from & mask_;
+	uint64_t first = std::min(len, capacity_ - offset);
+	out.append(data_.get() + offset, first);
+	out.append(data_.get(), len - first);
+}
+
+uint64_t RingBuffer::find_newline(uint64_t from, uint64_t to) const {
+	while (from < to) {
+		uint64_t offset = from & mask_;
+		uint64_t len = std::min(to - from, capacity_ - offset);
+		const void *hit = std::memchr(data_.get() + offset, '\n', len);
+		if (hit != nullptr) {
+			return from + (static_cast<const char *>(hit) - (data_.get() + offset));
+		}
+		from += len;
+	}
+	return to;
+}
+
+uint64_t RingBuffer::rfind_newline(uint64_t from, uint64_t to) const {
+	uint64_t end = to;
+	while (from < end) {
+		// 从后往前逐段查找，每段不跨越环形缓冲区的物理末尾
+		uint64_t end_offset = ((end - 1) & mask_) + 1;
+		uint64_t len = std::min(end - from, end_offset);
+		const char *segment = data_.get() + end_offset - len;
+		const void *hit = memrchr(segment, '\n', len);
+		if (hit != nullptr) {
+			return end - len + (static_cast<const char *>(hit) - segment);
+		}
+		end -= len;
+	}
+	return to;
+}
+
+}
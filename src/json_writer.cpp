@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <json_writer.h>
+
+namespace dl {
+
+// ============================================================================
+// 辅助函数
+// ============================================================================
+
+static constexpr uint64_t ONES = 0x0101010101010101ULL;
+static constexpr uint64_t HIGHS = 0x8080808080808080ULL;
+
+// 8 个字节中是否有任一字节需要转义：小于 0x20、等于 '"' 或等于 '\\'
+// 这里只判断"有没有"，具体位置交给逐字节的慢路径
+static inline bool needs_escape(uint64_t word) {
+	uint64_t control = (word - ONES * 0x20) & ~word & HIGHS;
+	uint64_t quote = word ^ (ONES * '"');
+	uint64_t backslash = word ^ (ONES * '\\');
+	uint64_t has_quote = (quote - ONES) & ~quote & HIGHS;
+	uint64_t has_backslash = (backslash - ONES) & ~backslash & HIGHS;
+	return (control | has_quote | has_backslash) != 0;
+}
+
+static inline void escape_char(std::string &out, unsigned char c) {
+	static const char HEX[] = "0123456789abcdef";
+	switch (c) {
+	case '"':
+		out += "\\\"";
+		break;
+	case '\\':
+		out += "\\\\";
+		break;
+	case '\b':
+		out += "\\b";
+		break;
+	case '\f':
+		out += "\\f";
+		break;
+	case '\n':
+		out += "\\n";
+		break;
+	case '\r':
+		out += "\\r";
+		break;
+	case '\t':
+		out += "\\t";
+		break;
+	default:
+		if (c < 0x20) {
+			char buf[6] = { '\\', 'u', '0', '0', HEX[c >> 4], HEX[c & 0xf] };
+			out.append(buf, sizeof(buf));
+		} else {
+			out += static_cast<char>(c);
+		}
+		break;
+	}
+}
+
+static inline bool is_special(unsigned char c) {
+	return c < 0x20 || c == '"' || c == '\\';
+}
+
+// ============================================================================
+// JsonWriter 实现
+// ============================================================================
+
+void JsonWriter::escape_to(std::string &out, std::string_view s) {
+	const char *data = s.data();
+	size_t n = s.size();
+	size_t clean_begin = 0; // 尚未拷贝的无需转义片段起点
+	size_t i = 0;
+
+	while (i < n) {
+		// 快路径：整组 8 字节都不需要转义时直接跳过
+		if (i + 8 <= n) {
+			uint64_t word;
+			std::memcpy(&word, data + i, sizeof(word));
+			if (!needs_escape(word)) {
+				i += 8;
+				continue;
+			}
+		}
+
+		// 慢路径：逐字节处理这一组（或末尾不足 8 字节的部分）
+		size_t end = std::min(i + 8, n);
+		for (; i < end; i++) {
+			unsigned char c = static_cast<unsigned char>(data[i]);
+			if (is_special(c)) {
+				out.append(data + clean_begin, i - clean_begin);
+				escape_char(out, c);
+				clean_begin = i + 1;
+			}
+		}
+	}
+
+	out.append(data + clean_begin, n - clean_begin);
+}
+
+} // namespace dl
@@ -0,0 +1,243 @@
+#include <log_classifier.h>
+
+namespace dl {
+
+// ============================================================================
+// 辅助函数
+// ============================================================================
+
+namespace {
+
+// 关键字编号，与构造函数中的添加顺序一致
+enum Keyword : AhoCorasick::PatternId {
+	KW_CONTENT_BEGIN, // "]: "
+	KW_JOINED_WITH, // " joined with "
+	KW_JOINED_GAME, // " joined the game"
+	KW_LEFT_GAME, // " left the game"
+	KW_ISSUED_COMMAND, // " issued server command: /"
+	KW_COUNT
+};
+
+constexpr std::string_view KEYWORDS[KW_COUNT] = {
+	"]: ",
+	" joined with ",
+	" joined the game",
+	" left the game",
+	" issued server command: /",
+};
+
+constexpr size_t npos = std::string_view::npos;
+
+bool is_digit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+bool is_alpha(char c) {
+	return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+}
+
+std::string_view trim(std::string_view s) {
+	size_t start = s.find_first_not_of(" \t\r\n");
+	if (start == npos)
+		return {};
+	size_t end = s.find_last_not_of(" \t\r\n");
+	return s.substr(start, end - start + 1);
+}
+
+} // namespace
+
+const char *log_event_type_name(LogEventType type) {
+	switch (type) {
+	case LogEventType::PLAYER_JOIN:
+		return "join";
+	case LogEventType::PLAYER_LEAVE:
+		return "leave";
+	case LogEventType::PLAYER_COMMAND:
+		return "command";
+	case LogEventType::PLAYER_CHAT:
+		return "chat";
+	default:
+		return "";
+	}
+}
+
+// ============================================================================
+// LogClassifier 实现
+// ============================================================================
+
+LogClassifier::LogClassifier() {
+	for (auto keyword : KEYWORDS) {
+		patterns_.add_pattern(keyword);
+	}
+	patterns_.build();
+}
+
+LogLineView LogClassifier::classify(std::string_view s, std::string &scratch) const {
+	LogLineView view;
+
+	while (!s.empty() && (s.back() == '\n' || s.back() == '\r')) {
+		s.remove_suffix(1);
+	}
+
+	scratch.clear();
+	scratch.reserve(s.size());
+
+	// 各关键字在去除 ANSI 后的行中第一次出现的位置（仅统计正文部分）
+	size_t keyword_pos[KW_COUNT];
+	for (auto &p : keyword_pos) {
+		p = npos;
+	}
+	size_t content_begin = npos;
+	size_t first_colon = npos;
+	size_t first_rbracket = npos;
+	size_t first_rangle = npos;
+
+	AhoCorasick::State state = AhoCorasick::ROOT;
+	auto emit = [&](char c) {
+		size_t k = scratch.size();
+		scratch.push_back(c);
+
+		if (content_begin != npos) {
+			if (c == ':' && first_colon == npos) {
+				first_colon = k;
+			} else if (c == ']' && first_rbracket == npos) {
+				first_rbracket = k;
+			} else if (c == '>' && first_rangle == npos) {
+				first_rangle = k;
+			}
+		}
+
+		state = patterns_.step(state, static_cast<unsigned char>(c));
+		patterns_.for_each_match(state, [&](AhoCorasick::PatternId id) {
+			if (id == KW_CONTENT_BEGIN) {
+				if (content_begin == npos) {
+					content_begin = k + 1;
+				}
+				return;
+			}
+			size_t start = k + 1 - KEYWORDS[id].size();
+			if (content_begin != npos && start >= content_begin && keyword_pos[id] == npos) {
+				keyword_pos[id] = start;
+			}
+		});
+	};
+
+	// 去除 ANSI 转义序列 (终端控制符)，格式: ESC[ ... m  或  [ 数字;数字 m
+	size_t i = 0;
+	while (i < s.size()) {
+		// 检查 ESC 字符 (\x1b 或 \033，ASCII 27)
+		if (s[i] == '\x1b') {
+			if (i + 1 < s.size() && s[i + 1] == '[') {
+				// 跳过 ESC[ 以及数字和分号
+				i += 2;
+				while (i < s.size() && (is_digit(s[i]) || s[i] == ';')) {
+					i++;
+				}
+				// 跳过结束字母 (通常是 m)
+				if (i < s.size() && is_alpha(s[i])) {
+					i++;
+				}
+				continue;
+			}
+			// 单独的 ESC，跳过
+			i++;
+			continue;
+		}
+
+		// 检查可能 ESC 被过滤后只剩 [数字;数字m] 的情况
+		if (s[i] == '[' && i + 1 < s.size() && is_digit(s[i + 1])) {
+			size_t j = i + 1;
+			while (j < s.size() && (is_digit(s[j]) || s[j] == ';')) {
+				j++;
+			}
+			// 必须以 m 结尾
+			if (j < s.size() && s[j] == 'm') {
+				i = j + 1;
+				continue;
+			}
+		}
+
+		emit(s[i]);
+		i++;
+	}
+
+	std::string_view line(scratch);
+	view.line = line;
+	if (content_begin == npos) {
+		return view;
+	}
+
+	std::string_view content = line.substr(content_begin);
+	view.content = content;
+	auto rel = [content_begin](size_t pos) {
+		return pos == npos ? npos : pos - content_begin;
+	};
+
+	// 以下判断顺序与关键字优先级保持一致
+
+	// =========== 玩家加入 (Leaves/Carpet等) ===========
+	size_t pos = rel(keyword_pos[KW_JOINED_WITH]);
+	if (pos != npos) {
+		size_t player_pos = content.rfind("Player ", pos);
+		if (player_pos != npos) {
+			size_t name_start = player_pos + 7;
+			view.type = LogEventType::PLAYER_JOIN;
+			view.player = trim(content.substr(name_start, pos - name_start));
+			view.detail = trim(content.substr(pos + KEYWORDS[KW_JOINED_WITH].size()));
+			return view;
+		}
+	}
+
+	// =========== 玩家加入 (原版) ===========
+	pos = rel(keyword_pos[KW_JOINED_GAME]);
+	if (pos != npos) {
+		view.type = LogEventType::PLAYER_JOIN;
+		view.player = trim(content.substr(0, pos));
+		view.detail = "vanilla";
+		return view;
+	}
+
+	// =========== 玩家离开 ===========
+	pos = rel(keyword_pos[KW_LEFT_GAME]);
+	if (pos != npos) {
+		view.type = LogEventType::PLAYER_LEAVE;
+		view.player = trim(content.substr(0, pos));
+		return view;
+	}
+
+	// =========== 玩家执行指令 ===========
+	pos = rel(keyword_pos[KW_ISSUED_COMMAND]);
+	if (pos != npos) {
+		view.type = LogEventType::PLAYER_COMMAND;
+		view.player = trim(content.substr(0, pos));
+		view.detail = content.substr(pos + KEYWORDS[KW_ISSUED_COMMAND].size());
+		return view;
+	}
+
+	// =========== 玩家操作行（F3+F4等） ===========
+	if (!content.empty() && content[0] == '[') {
+		size_t end_bracket = rel(first_rbracket);
+		size_t colon_pos = rel(first_colon);
+		if (end_bracket != npos && colon_pos != npos && colon_pos < end_bracket) {
+			view.type = LogEventType::PLAYER_COMMAND;
+			view.is_operation = true;
+			view.detail = content.substr(1, end_bracket - 1);
+			return view;
+		}
+	}
+
+	// =========== 玩家聊天 ===========
+	if (!content.empty() && content[0] == '<') {
+		size_t end = rel(first_rangle);
+		if (end != npos) {
+			view.type = LogEventType::PLAYER_CHAT;
+			view.player = content.substr(1, end - 1);
+			view.detail = trim(content.substr(end + 1));
+			return view;
+		}
+	}
+
+	return view;
+}
+
+} // namespace dl
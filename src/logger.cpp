@@ -0,0 +1,220 @@
+#include <cerrno>
+#include <chrono>
+#include <logger.h>
+#include <unistd.h>
+
+namespace dl {
+
+// ============================================================================
+// 辅助函数
+// ============================================================================
+
+namespace {
+
+// 写完整个缓冲区，终端关闭等错误时放弃
+void write_all(int fd, const std::string &data) {
+	const char *p = data.data();
+	size_t left = data.size();
+	while (left > 0) {
+		ssize_t n = ::write(fd, p, left);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return;
+		}
+		p += n;
+		left -= static_cast<size_t>(n);
+	}
+}
+
+} // namespace
+
+bool parse_log_level(std::string_view text, LogLevel &out) {
+	if (text == "debug") {
+		out = LogLevel::DEBUG;
+	} else if (text == "info") {
+		out = LogLevel::INFO;
+	} else if (text == "warn") {
+		out = LogLevel::WARN;
+	} else if (text == "error") {
+		out = LogLevel::ERROR;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+// ============================================================================
+// Logger 实现
+// ============================================================================
+
+Logger &Logger::global() {
+	static Logger logger;
+	return logger;
+}
+
+// 计数器在注册表中，注册表先于日志器构造，因此在日志器之后析构
+Logger::Logger()
+	: head_(&stub_)
+	, tail_(&stub_)
+	, lines_(MetricsRegistry::global().counter("dreamland_console_lines_total",
+		  "Lines written to the console by the async logger."))
+	, dropped_(MetricsRegistry::global().counter("dreamland_console_dropped_total",
+		  "Console lines dropped because the writer fell behind.")) {
+	out_batch_.reserve(MAX_BATCH_BYTES);
+	err_batch_.reserve(MAX_BATCH_BYTES);
+	writer_ = std::thread(&Logger::writer_func, this);
+}
+
+Logger::~Logger() {
+	stop_ = true;
+	{
+		std::lock_guard<std::mutex> lock(wake_mutex_);
+		wake_cv_.notify_one();
+	}
+	if (writer_.joinable()) {
+		writer_.join();
+	}
+	// 写线程退出后仍未取出的（生产者恰好未完成链接）直接释放
+	while (Node *node = pop()) {
+		delete node;
+	}
+}
+
+void Logger::log(LogLevel level, std::string text) {
+	if (!enabled(level) || stop_) {
+		return;
+	}
+	if (pending_.fetch_add(1) >= MAX_PENDING) {
+		pending_.fetch_sub(1);
+		dropped_.inc();
+		return;
+	}
+
+	Node *node = new Node;
+	node->level = level;
+	node->text = std::move(text);
+	node->text += '\n';
+	submitted_.fetch_add(1);
+	push(node);
+
+	if (writer_waiting_.load()) {
+		std::lock_guard<std::mutex> lock(wake_mutex_);
+		wake_cv_.notify_one();
+	}
+}
+
+void Logger::passthrough(std::string_view line) {
+	if (passthrough_enabled()) {
+		log(LogLevel::INFO, std::string(line));
+	}
+}
+
+void Logger::flush() {
+	uint64_t target = submitted_.load();
+	std::unique_lock<std::mutex> lock(wake_mutex_);
+	wake_cv_.notify_one();
+	flushed_cv_.wait_for(lock, std::chrono::seconds(5), [this, target] {
+		return written_.load() >= target;
+	});
+}
+
+void Logger::push(Node *node) {
+	node->next.store(nullptr, std::memory_order_relaxed);
+	Node *prev = head_.exchange(node, std::memory_order_acq_rel);
+	prev->next.store(node, std::memory_order_release);
+}
+
+Logger::Node *Logger::pop() {
+	Node *tail = tail_;
+	Node *next = tail->next.load(std::memory_order_acquire);
+	if (tail == &stub_) {
+		if (!next) {
+			return nullptr;
+		}
+		tail_ = next;
+		tail = next;
+		next = next->next.load(std::memory_order_acquire);
+	}
+	if (next) {
+		tail_ = next;
+		return tail;
+	}
+	// tail 是最后一个节点，把 stub_ 放回队尾后才能取出它
+	if (tail != head_.load(std::memory_order_acquire)) {
+		return nullptr; // 生产者已交换 head_ 但尚未链接，稍后再取
+	}
+	push(&stub_);
+	next = tail->next.load(std::memory_order_acquire);
+	if (next) {
+		tail_ = next;
+		return tail;
+	}
+	return nullptr;
+}
+
+size_t Logger::write_batch() {
+	size_t count = 0;
+	auto flush_batches = [this] {
+		if (!out_batch_.empty()) {
+			write_all(STDOUT_FILENO, out_batch_);
+			out_batch_.clear();
+		}
+		if (!err_batch_.empty()) {
+			write_all(STDERR_FILENO, err_batch_);
+			err_batch_.clear();
+		}
+	};
+
+	while (Node *node = pop()) {
+		std::string &batch = node->level >= LogLevel::WARN ? err_batch_ : out_batch_;
+		batch += node->text;
+		delete node;
+		count++;
+		if (out_batch_.size() + err_batch_.size() >= MAX_BATCH_BYTES) {
+			flush_batches();
+		}
+	}
+	flush_batches();
+
+	if (count > 0) {
+		pending_.fetch_sub(count);
+		lines_.inc(count);
+		written_.fetch_add(count);
+	}
+	return count;
+}
+
+void Logger::writer_func() {
+	while (true) {
+		if (write_batch() > 0) {
+			std::lock_guard<std::mutex> lock(wake_mutex_);
+			flushed_cv_.notify_all();
+			continue;
+		}
+		if (stop_) {
+			break;
+		}
+
+		std::unique_lock<std::mutex> lock(wake_mutex_);
+		writer_waiting_ = true;
+		// 标记之后再检查一次，避免错过在标记之前入队却没有唤醒的日志
+		if (submitted_.load() != written_.load()) {
+			// 生产者已计数但尚未链接完成，让出 CPU 后再取
+			writer_waiting_ = false;
+			lock.unlock();
+			std::this_thread::yield();
+			continue;
+		}
+		if (!stop_) {
+			wake_cv_.wait_for(lock, std::chrono::milliseconds(100));
+		}
+		writer_waiting_ = false;
+	}
+	write_batch();
+	std::lock_guard<std::mutex> lock(wake_mutex_);
+	flushed_cv_.notify_all();
+}
+
+}
@@ -1,147 +1,453 @@
 #include <command_request.h>
+#include <event_archive.h>
 #include <io/program.h>
+#include <io/reactor.h>
+#include <logger.h>
 #include <player_list.h>
 #include <server_manager.h>
+#include <timer_queue.h>
 #include <web_server.h>
 
 #include <csignal>
-#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <future>
 #include <memory>
+#include <set>
+#include <vector>
 
-// 全局指针，用于信号处理
-static dl::WebServer* g_web_server = nullptr;
-static dl::ServerManager* g_server_manager = nullptr;
+// 收到 SIGINT/SIGTERM 后由主循环负责关闭
+static volatile std::sig_atomic_t g_stop_requested = 0;
 
-void signal_handler(int signal) {
-    std::cout << "\n[Main] 收到信号 " << signal << "，正在关闭..." << std::endl;
-    
-    if (g_web_server) {
-        g_web_server->stop();
+// 一个 MC 服务器实例
+struct InstanceConfig {
+    std::string name;
+    std::string ops_file;
+    std::string command;
+};
+
+// 读取实例配置文件，每行 "名称|ops.json 路径|启动命令"，# 开头的行为注释
+// 启动命令放在最后，其中可以包含 '|'
+static bool load_instances(const std::string& path, std::vector<InstanceConfig>& instances) {
+    std::ifstream file(path);
+    if (!file) {
+        dl::log_error() << "[Main] 无法打开实例配置文件: " << path;
+        return false;
     }
     
-    if (g_server_manager) {
-        g_server_manager->stop();
+    std::set<std::string> names;
+    std::string line;
+    int line_no = 0;
+    while (std::getline(file, line)) {
+        line_no++;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+        
+        size_t p1 = line.find('|');
+        size_t p2 = p1 == std::string::npos ? std::string::npos : line.find('|', p1 + 1);
+        if (p2 == std::string::npos) {
+            dl::log_error() << "[Main] 实例配置第 " << line_no << " 行格式错误";
+            return false;
+        }
+        InstanceConfig instance;
+        instance.name = line.substr(0, p1);
+        instance.ops_file = line.substr(p1 + 1, p2 - p1 - 1);
+        instance.command = line.substr(p2 + 1);
+        // 名称用于 /api/servers/<name>/... 路径
+        if (instance.name.empty() || instance.name.find('/') != std::string::npos || instance.command.empty()) {
+            dl::log_error() << "[Main] 实例配置第 " << line_no << " 行格式错误";
+            return false;
+        }
+        if (!names.insert(instance.name).second) {
+            dl::log_error() << "[Main] 实例名称重复: " << instance.name;
+            return false;
+        }
+        instances.push_back(std::move(instance));
     }
     
-    exit(0);
+    if (instances.empty()) {
+        dl::log_error() << "[Main] 实例配置文件中没有实例: " << path;
+        return false;
+    }
+    return true;
+}
+
+// 解析选项的数值参数，整个字符串都必须是非负数
+static bool parse_count(const char* text, size_t& value) {
+    char* end = nullptr;
+    unsigned long long parsed = std::strtoull(text, &end, 10);
+    if (end == text || *end != '\0' || text[0] == '-') return false;
+    value = static_cast<size_t>(parsed);
+    return true;
+}
+
+static bool parse_rate(const char* text, double& value) {
+    char* end = nullptr;
+    double parsed = std::strtod(text, &end);
+    if (end == text || *end != '\0' || !(parsed >= 0)) return false;
+    value = parsed;
+    return true;
+}
+
+static std::string format_rate(double value) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%g", value);
+    return buf;
+}
+
+static bool any_running(const std::vector<std::unique_ptr<dl::ServerManager>>& managers) {
+    for (const auto& manager : managers) {
+        if (manager->is_running()) return true;
+    }
+    return false;
+}
+
+// 缓存日志视图转换为 Web 接口的日志视图，不复制字符串
+static dl::LogEntry to_log_entry(const dl::LogView& log) {
+    dl::LogEntry entry;
+    entry.seq = log.seq;
+    entry.time = log.time;
+    entry.type = dl::log_event_type_name(log.type);
+    entry.player = log.player;
+    entry.content = log.content;
+    return entry;
+}
+
+// 为 Web 接口提供某个实例的日志与 OP 列表
+static dl::ServerEndpoints make_endpoints(dl::ServerManager& manager) {
+    dl::ServerEndpoints endpoints;
+    endpoints.get_logs = [&manager](uint64_t since, size_t limit, const dl::LogEntryVisitor& visit) {
+        manager.visit_logs_since(since, limit, [&manager, &visit](const dl::LogView& log) {
+            dl::LogEntry entry = to_log_entry(log);
+            entry.server = manager.name();
+            visit(entry);
+        });
+    };
+    // 版本号不变时 Web 接口直接返回缓存或 304
+    endpoints.logs_generation = [&manager]() {
+        return manager.log_generation();
+    };
+    endpoints.get_ops = [&manager]() {
+        return manager.get_ops();
+    };
+    endpoints.ops_generation = [&manager]() {
+        return manager.ops_generation();
+    };
+    endpoints.is_running = [&manager]() {
+        return manager.is_running();
+    };
+    return endpoints;
+}
+
+// 缓存的日志只有四种玩家事件
+static dl::EventKind to_event_kind(dl::LogEventType type) {
+    switch (type) {
+        case dl::LogEventType::PLAYER_JOIN:    return dl::EventKind::JOIN;
+        case dl::LogEventType::PLAYER_LEAVE:   return dl::EventKind::LEAVE;
+        case dl::LogEventType::PLAYER_COMMAND: return dl::EventKind::COMMAND;
+        default:                               return dl::EventKind::CHAT;
+    }
+}
+
+// 只记录信号：停止线程、写日志都不是异步信号安全的，且信号可能落在被停止的线程上；
+// 主循环退出后 main 正常返回，各对象按声明的逆序析构，journal 在析构时写完队列中的记录
+void signal_handler(int signal) {
+    g_stop_requested = signal;
+    // 关闭卡住时，再次收到信号按默认方式立即退出
+    std::signal(signal, SIG_DFL);
 }
 
 int main(int argc, char* argv[]) {
-    if (argc != 2 && argc != 3) {
-        std::cout << "用法: " << argv[0] << " <服务器启动命令> [端口]" << std::endl;
-        std::cout << "示例: " << argv[0] << " \"cd server && java -jar server.jar nogui\" 8080" << std::endl;
-        return 1;
+    // 先取出日志与 Web 服务器选项，其余为位置参数
+    std::vector<std::string> args;
+    dl::Logger& logger = dl::Logger::global();
+    dl::WebServerConfig web_config;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : "";
+        dl::LogLevel level;
+        size_t count = 0;
+        double rate = 0;
+        if (arg == "--log-level" && dl::parse_log_level(value, level)) {
+            logger.set_level(level);
+            i++;
+        } else if (arg == "--quiet-server") {
+            // 不再转发 MC 服务器中与玩家无关的输出
+            logger.set_passthrough(false);
+        } else if (arg == "--trust-proxy") {
+            // 部署在反向代理之后，按代理添加的 X-Forwarded-For / X-Real-IP 识别投票者
+            web_config.trust_proxy_headers = true;
+        } else if (arg == "--web-threads" && parse_count(value, count) && count > 0) {
+            web_config.worker_threads = count;
+            i++;
+        } else if (arg == "--web-queue" && parse_count(value, count)) {
+            web_config.max_queued_connections = count;
+            i++;
+        } else if (arg == "--keep-alive-max" && parse_count(value, count) && count > 0) {
+            web_config.keep_alive_max_count = count;
+            i++;
+        } else if (arg == "--keep-alive-timeout" && parse_count(value, count)) {
+            web_config.keep_alive_timeout_sec = static_cast<int>(count);
+            i++;
+        } else if (arg == "--vote-rate" && parse_rate(value, rate)) {
+            web_config.vote_rate_per_minute = rate;
+            i++;
+        } else if (arg == "--vote-burst" && parse_rate(value, rate) && rate >= 1) {
+            web_config.vote_rate_burst = rate;
+            i++;
+        } else {
+            args.push_back(arg);
+        }
     }
     
-    std::string server_command = argv[1];
+    std::vector<InstanceConfig> instances;
     int port = 8080;
-    if (argc == 3) {
-        port = std::atoi(argv[2]);
+    if (!args.empty() && args[0] == "--config") {
+        // 多实例模式：一个进程管理配置文件中的所有 MC 服务器
+        if (args.size() != 2 && args.size() != 3) {
+            dl::log_info() << "用法: " << argv[0] << " [选项] --config <实例配置文件> [端口]";
+            return 1;
+        }
+        if (!load_instances(args[1], instances)) {
+            return 1;
+        }
+        if (args.size() == 3) {
+            port = std::atoi(args[2].c_str());
+        }
+    } else {
+        if (args.size() != 1 && args.size() != 2) {
+            dl::log_info() << "用法: " << argv[0] << " [选项] <服务器启动命令> [端口]";
+            dl::log_info() << "      " << argv[0] << " [选项] --config <实例配置文件> [端口]";
+            dl::log_info() << "示例: " << argv[0] << " \"cd server && java -jar server.jar nogui\" 8080";
+            dl::log_info() << "实例配置文件每行为: 名称|ops.json 路径|启动命令";
+            dl::log_info() << "选项: --log-level <debug|info|warn|error>  控制台日志级别（默认 info）";
+            dl::log_info() << "      --quiet-server                     不输出 MC 服务器与玩家无关的原始输出";
+            dl::log_info() << "      --trust-proxy                      信任 X-Forwarded-For / X-Real-IP 识别投票者（默认关闭，";
+            dl::log_info() << "                                         只按连接地址识别；部署在反向代理之后时必须开启）";
+            dl::log_info() << "      --web-threads <n>                  Web 工作线程数（默认 " << web_config.worker_threads << "）";
+            dl::log_info() << "      --web-queue <n>                    等待工作线程的连接上限，0 表示不限（默认 " << web_config.max_queued_connections << "）";
+            dl::log_info() << "      --keep-alive-max <n>               单个连接最多处理的请求数（默认 " << web_config.keep_alive_max_count << "）";
+            dl::log_info() << "      --keep-alive-timeout <秒>          空闲连接的关闭时间（默认 " << web_config.keep_alive_timeout_sec << "）";
+            dl::log_info() << "      --vote-rate <次/分钟>              每个 IP 的投票速率，0 表示不限流（默认 " << format_rate(web_config.vote_rate_per_minute) << "）";
+            dl::log_info() << "      --vote-burst <n>                   每个 IP 允许连续投票的次数（默认 " << format_rate(web_config.vote_rate_burst) << "）";
+            return 1;
+        }
+        instances.push_back({"default", "server/ops.json", args[0]});
+        if (args.size() == 2) {
+            port = std::atoi(args[1].c_str());
+        }
     }
     
-    std::cout << "==================================================" << std::endl;
-    std::cout << "      MC 服务器管理系统 - DreamlandLogger       " << std::endl;
-    std::cout << "==================================================" << std::endl;
+    dl::log_info() << "==================================================";
+    dl::log_info() << "      MC 服务器管理系统 - DreamlandLogger       ";
+    dl::log_info() << "==================================================";
     
     try {
-        // 创建 PlayerList（注意：Program 引用在 ServerManager 中）
-        dl::Program program(server_command);
-        
-        dl::PlayerList player_list(
-            "data/players.list",
-            "data/banned.list",
-            "data/forbidden_commands.list",
-            program
-        );
-        
-        // 创建 ServerManager
-        dl::ServerManager server_manager(
-            &program,
-            "server/ops.json",
-            player_list
-        );
-        g_server_manager = &server_manager;
-        
-        // 创建 CommandRequestManager
-        dl::CommandRequestManager request_manager(
-            "data/requests.dat",
-            "data/uploads",
-            5,  // 投票阈值
-            [&server_manager](const std::string& command, const std::string& applicant) {
-                // 命令执行回调
-                server_manager.execute_command(command);
+        // 所有实例的子进程管道由同一个 reactor 线程监听
+        dl::Reactor reactor;
+        
+        std::vector<std::unique_ptr<dl::Program>> programs;
+        for (const auto& instance : instances) {
+            auto program = std::make_unique<dl::Program>(instance.command, &reactor);
+
+            // stdout 由日志线程消费，写满时阻塞以免丢失玩家事件（阻塞期间 reactor 上的其他实例也会暂停）；
+            // stderr 无人读取，只保留最近的输出
+            dl::Program::BufferOptions stdout_options;
+            stdout_options.backend = dl::Program::BufferOptions::Backend::RING;
+            stdout_options.ring_capacity = 4 << 20;
+            stdout_options.overflow = dl::RingBuffer::OverflowPolicy::BLOCK;
+            program->set_buffer_options(dl::Program::IOStreamType::STDOUT, stdout_options);
+
+            dl::Program::BufferOptions stderr_options;
+            stderr_options.backend = dl::Program::BufferOptions::Backend::RING;
+            stderr_options.ring_capacity = 256 << 10;
+            stderr_options.overflow = dl::RingBuffer::OverflowPolicy::DROP_OLDEST;
+            program->set_buffer_options(dl::Program::IOStreamType::STDERR, stderr_options);
+            
+            programs.push_back(std::move(program));
+        }
+        
+        // 先启动 MC 服务器，数据文件在其启动期间并行加载；日志线程开始读取之前，输出留在 stdout 缓冲区中
+        for (size_t i = 0; i < programs.size(); i++) {
+            if (!programs[i]->run()) {
+                dl::log_warn() << "[Main] MC 服务器实例提前启动失败，稍后重试: " << instances[i].name;
+            }
+        }
+        
+        // 限时封禁解封与申请过期清理共用一个定时线程
+        dl::TimerQueue timers;
+        
+        // 所有实例共用一份玩家、封禁与禁止指令数据，封禁会同时发送到每个实例
+        // 玩家数据与申请数据各在一个线程加载，ops.json 在主线程加载
+        auto player_list_loader = std::async(std::launch::async, [&programs, &timers]() {
+            return std::make_unique<dl::PlayerList>(
+                "data/players.list",
+                "data/banned.list",
+                "data/forbidden_commands.list",
+                *programs[0],
+                &timers
+            );
+        });
+        // 声明在 server_managers 之前，保证日志线程停止后才析构
+        std::unique_ptr<dl::PlayerList> player_list_owner;
+        
+        std::vector<std::unique_ptr<dl::ServerManager>> server_managers;
+        
+        // 通过投票的指令在所有实例上执行
+        // 只有投票和 execute_pending 会触发执行，二者都发生在所有实例创建并启动之后
+        auto execute_everywhere = [&server_managers](const std::string& command) {
+            for (auto& manager : server_managers) {
+                manager->execute_command(command);
             }
-        );
+        };
+        
+        auto request_manager_loader = std::async(std::launch::async, [&execute_everywhere, &timers]() {
+            return std::make_unique<dl::CommandRequestManager>(
+                "data/requests.dat",
+                "data/uploads",
+                5,  // 投票阈值
+                [&execute_everywhere](const std::string& command, const std::string& applicant) {
+                    // 命令执行回调
+                    execute_everywhere(command);
+                },
+                &timers
+            );
+        });
+        
+        player_list_owner = player_list_loader.get();
+        dl::PlayerList& player_list = *player_list_owner;
+        for (size_t i = 1; i < programs.size(); i++) {
+            player_list.add_program(*programs[i]);
+        }
         
-        // 创建 WebServer
-        dl::WebServerConfig web_config;
+        // 每个实例一个 ServerManager
+        for (size_t i = 0; i < instances.size(); i++) {
+            server_managers.push_back(std::make_unique<dl::ServerManager>(
+                programs[i].get(),
+                instances[i].ops_file,
+                player_list,
+                instances[i].name
+            ));
+        }
+        
+        std::unique_ptr<dl::CommandRequestManager> request_manager_owner = request_manager_loader.get();
+        dl::CommandRequestManager& request_manager = *request_manager_owner;
+        
+        // 游戏事件归档，保留数周的历史供 /api/history 查询
+        dl::EventArchive archive("data/events");
+        
+        // 创建 WebServer，其余设置已由命令行选项填入
         web_config.port = port;
         web_config.web_root = "web";
         web_config.upload_dir = "data/uploads";
         
         dl::WebServer web_server(web_config, player_list, request_manager);
-        g_web_server = &web_server;
-        
-        // 设置回调
-        web_server.set_get_logs_callback([&server_manager]() {
-            auto logs = server_manager.get_logs();
-            std::vector<dl::LogEntry> result;
-            for (const auto& log : logs) {
-                dl::LogEntry entry;
-                entry.timestamp = log.timestamp;
-                entry.type = log.type;
-                entry.player = log.player;
-                entry.content = log.content;
-                result.push_back(entry);
+
+        // 日志线程的回调引用了 archive 和 web_server，而它们比 server_managers 先析构，
+        // 离开作用域时（包括提前返回和异常）先停止所有实例的日志线程
+        struct ManagerStopper {
+            std::vector<std::unique_ptr<dl::ServerManager>>& managers;
+            ~ManagerStopper() {
+                for (auto& manager : managers) {
+                    manager->stop();
+                }
             }
-            return result;
+        } stop_managers { server_managers };
+        
+        // 设置回调：/api/logs 与 /api/ops 对应第一个实例，每个实例另有 /api/servers/<name>/...
+        dl::ServerManager& primary = *server_managers[0];
+        dl::ServerEndpoints primary_endpoints = make_endpoints(primary);
+        web_server.set_get_logs_callback(primary_endpoints.get_logs);
+        web_server.set_logs_generation_callback(primary_endpoints.logs_generation);
+        web_server.set_get_ops_callback(primary_endpoints.get_ops);
+        web_server.set_ops_generation_callback(primary_endpoints.ops_generation);
+        for (auto& manager : server_managers) {
+            web_server.add_server(manager->name(), make_endpoints(*manager));
+        }
+        
+        web_server.set_execute_command_callback(execute_everywhere);
+        
+        web_server.set_player_exists_callback([&player_list](const std::string& player) {
+            return player_list.has_player(player);
         });
         
-        web_server.set_get_ops_callback([&server_manager]() {
-            return server_manager.get_ops();
+        web_server.set_history_callback([&archive](const dl::HistoryQuery& query) {
+            return archive.query(query);
         });
         
-        web_server.set_execute_command_callback([&server_manager](const std::string& cmd) {
-            server_manager.execute_command(cmd);
+        // 新日志写入归档，并与其他变化一起实时推送到 /api/stream
+        // 推送的 log 事件与 /api/logs 一致，只包含第一个实例：每个实例的日志序号各自从 1 开始，
+        // 前端按同一个序号去重，混入其他实例会丢行；其他实例的日志通过 /api/servers/<name>/logs 获取
+        for (auto& manager : server_managers) {
+            dl::ServerManager* source = manager.get();
+            bool is_primary = source == &primary;
+            manager->set_log_entry_callback([&web_server, &archive, source, is_primary](const dl::LogView& log) {
+                archive.append(to_event_kind(log.type), log.time, log.player, log.content);
+                if (!is_primary) return;
+                dl::LogEntry entry = to_log_entry(log);
+                entry.server = source->name();
+                web_server.publish_log(entry);
+            });
+        }
+        
+        player_list.set_change_callback([&web_server](dl::PlayerChange change, const std::string& player, const std::string& detail) {
+            web_server.publish_player_change(change, player, detail);
         });
         
-        web_server.set_player_exists_callback([&player_list](const std::string& player) {
-            auto players = player_list.list_player();
-            return std::find(players.begin(), players.end(), player) != players.end();
+        request_manager.set_change_callback([&web_server](dl::RequestChange change, const std::string& id) {
+            web_server.publish_request_change(change, id);
         });
         
         // 注册信号处理
         std::signal(SIGINT, signal_handler);
         std::signal(SIGTERM, signal_handler);
         
-        // 启动服务器
-        if (!server_manager.start()) {
-            std::cerr << "[Main] MC 服务器启动失败" << std::endl;
+        // 启动所有实例，部分实例启动失败时其余实例照常运行
+        size_t started = 0;
+        for (auto& manager : server_managers) {
+            if (manager->start()) {
+                started++;
+            } else {
+                dl::log_warn() << "[Main] MC 服务器实例启动失败: " << manager->name();
+            }
+        }
+        if (started == 0) {
+            dl::log_error() << "[Main] MC 服务器启动失败";
             return 1;
         }
         
+        // 实例已启动，补执行上次退出前已通过但尚未执行的申请
+        request_manager.execute_pending();
+        
         // 启动 Web 服务器
         if (!web_server.start()) {
-            std::cerr << "[Main] Web 服务器启动失败" << std::endl;
-            server_manager.stop();
+            dl::log_error() << "[Main] Web 服务器启动失败";
+            for (auto& manager : server_managers) {
+                manager->stop();
+            }
             return 1;
         }
         
-        std::cout << "\n==================================================" << std::endl;
-        std::cout << "  系统启动成功！" << std::endl;
-        std::cout << "  Web 管理界面: http://localhost:" << port << std::endl;
-        std::cout << "  按 Ctrl+C 停止服务器" << std::endl;
-        std::cout << "==================================================" << std::endl;
+        dl::log_info() << "\n==================================================";
+        dl::log_info() << "  系统启动成功！共 " << started << " 个 MC 服务器实例";
+        dl::log_info() << "  Web 管理界面: http://localhost:" << port;
+        dl::log_info() << "  按 Ctrl+C 停止服务器";
+        dl::log_info() << "==================================================";
         
         // 主循环
-        while (server_manager.is_running() && web_server.is_running()) {
-            std::this_thread::sleep_for(std::chrono::seconds(1));
+        while (!g_stop_requested && any_running(server_managers) && web_server.is_running()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        }
+        if (g_stop_requested) {
+            dl::log_info() << "\n[Main] 收到信号 " << g_stop_requested << "，正在关闭...";
         }
+        web_server.stop();
         
-        std::cout << "[Main] 服务器已停止" << std::endl;
+        dl::log_info() << "[Main] 服务器已停止";
         
     } catch (const std::exception& e) {
-        std::cerr << "[Main] 异常: " << e.what() << std::endl;
+        dl::log_error() << "[Main] 异常: " << e.what();
         return 1;
     }
     
@@ -0,0 +1,281 @@
+#include <algorithm>
+#include <cstdio>
+#include <metrics.h>
+
+namespace dl {
+
+// ============================================================================
+// 辅助函数
+// ============================================================================
+
+namespace {
+
+std::atomic<size_t> next_shard { 0 };
+
+// 标签值中的反斜杠、引号和换行需要转义
+void append_escaped(std::string &out, const std::string &value) {
+	for (char c : value) {
+		switch (c) {
+		case '\\':
+			out += "\\\\";
+			break;
+		case '"':
+			out += "\\\"";
+			break;
+		case '\n':
+			out += "\\n";
+			break;
+		default:
+			out += c;
+		}
+	}
+}
+
+std::string format_labels(const MetricLabels &labels) {
+	std::string out;
+	for (const auto &label : labels) {
+		if (!out.empty()) {
+			out += ',';
+		}
+		out += label.first;
+		out += "=\"";
+		append_escaped(out, label.second);
+		out += '"';
+	}
+	return out;
+}
+
+// 整数按整数输出，避免大计数被写成科学计数法而丢失精度
+void append_number(std::string &out, double value) {
+	char buf[32];
+	int len;
+	if (value > -1e15 && value < 1e15 && value == static_cast<double>(static_cast<int64_t>(value))) {
+		len = std::snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(value));
+	} else {
+		len = std::snprintf(buf, sizeof(buf), "%.9g", value);
+	}
+	out.append(buf, static_cast<size_t>(len));
+}
+
+// name{labels,extra} value
+void append_sample(std::string &out, const std::string &name, const std::string &labels,
+	const std::string &extra, double value) {
+	out += name;
+	if (!labels.empty() || !extra.empty()) {
+		out += '{';
+		out += labels;
+		if (!labels.empty() && !extra.empty()) {
+			out += ',';
+		}
+		out += extra;
+		out += '}';
+	}
+	out += ' ';
+	append_number(out, value);
+	out += '\n';
+}
+
+const char *type_name(MetricsRegistry::Type type) {
+	switch (type) {
+	case MetricsRegistry::Type::COUNTER:
+		return "counter";
+	case MetricsRegistry::Type::GAUGE:
+		return "gauge";
+	default:
+		return "histogram";
+	}
+}
+
+} // namespace
+
+size_t metric_shard() {
+	thread_local size_t shard = next_shard.fetch_add(1, std::memory_order_relaxed) % METRIC_SHARDS;
+	return shard;
+}
+
+// ============================================================================
+// Counter / Histogram
+// ============================================================================
+
+uint64_t Counter::value() const {
+	uint64_t total = 0;
+	for (const Shard &shard : shards_) {
+		total += shard.value.load(std::memory_order_relaxed);
+	}
+	return total;
+}
+
+const std::vector<double> &Histogram::default_bounds() {
+	static const std::vector<double> bounds = {
+		1e-6, 2.5e-6, 5e-6, 1e-5, 2.5e-5, 5e-5, 1e-4, 2.5e-4, 5e-4,
+		1e-3, 2.5e-3, 5e-3, 1e-2, 2.5e-2, 5e-2, 0.1, 0.25, 0.5, 1, 2.5, 5, 10
+	};
+	return bounds;
+}
+
+Histogram::Histogram(const std::vector<double> &bounds)
+	: bounds_(bounds) {
+	bounds_ns_.reserve(bounds_.size());
+	for (double bound : bounds_) {
+		bounds_ns_.push_back(static_cast<uint64_t>(bound * 1e9));
+	}
+	for (Shard &shard : shards_) {
+		shard.buckets = std::make_unique<std::atomic<uint64_t>[]>(bounds_ns_.size() + 1);
+	}
+}
+
+void Histogram::observe(Clock::duration elapsed) {
+	auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+	observe_ns(ns > 0 ? static_cast<uint64_t>(ns) : 0);
+}
+
+void Histogram::observe_seconds(double seconds) {
+	observe_ns(seconds > 0 ? static_cast<uint64_t>(seconds * 1e9) : 0);
+}
+
+void Histogram::observe_ns(uint64_t ns) {
+	size_t bucket = static_cast<size_t>(std::lower_bound(bounds_ns_.begin(), bounds_ns_.end(), ns) - bounds_ns_.begin());
+	Shard &shard = shards_[metric_shard()];
+	shard.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+	shard.sum_ns.fetch_add(ns, std::memory_order_relaxed);
+}
+
+Histogram::Snapshot Histogram::snapshot() const {
+	Snapshot snapshot;
+	snapshot.bounds = bounds_;
+	snapshot.cumulative.assign(bounds_ns_.size() + 1, 0);
+	uint64_t sum_ns = 0;
+	for (const Shard &shard : shards_) {
+		for (size_t i = 0; i <= bounds_ns_.size(); i++) {
+			snapshot.cumulative[i] += shard.buckets[i].load(std::memory_order_relaxed);
+		}
+		sum_ns += shard.sum_ns.load(std::memory_order_relaxed);
+	}
+	for (size_t i = 1; i < snapshot.cumulative.size(); i++) {
+		snapshot.cumulative[i] += snapshot.cumulative[i - 1];
+	}
+	snapshot.count = snapshot.cumulative.back();
+	snapshot.sum = static_cast<double>(sum_ns) / 1e9;
+	return snapshot;
+}
+
+TimedMutex::TimedMutex(const std::string &name)
+	: wait_(MetricsRegistry::global().histogram("dreamland_lock_wait_seconds",
+		"Time spent waiting to acquire an instrumented mutex.", { { "lock", name } })) {
+}
+
+// ============================================================================
+// MetricsRegistry
+// ============================================================================
+
+MetricsRegistry &MetricsRegistry::global() {
+	static MetricsRegistry registry;
+	return registry;
+}
+
+MetricsRegistry::Family &MetricsRegistry::family_locked(const std::string &name, const std::string &help, Type type) {
+	Family &family = families_[name];
+	if (family.series.empty()) {
+		family.type = type;
+		family.help = help;
+	}
+	return family;
+}
+
+Counter &MetricsRegistry::counter(const std::string &name, const std::string &help, const MetricLabels &labels) {
+	std::string formatted = format_labels(labels);
+	std::lock_guard<std::mutex> lock(mutex_);
+	Family &family = family_locked(name, help, Type::COUNTER);
+	for (Series &series : family.series) {
+		if (series.counter && series.labels == formatted) {
+			return *series.counter;
+		}
+	}
+	Series series;
+	series.labels = std::move(formatted);
+	series.counter = std::make_unique<Counter>();
+	family.series.push_back(std::move(series));
+	return *family.series.back().counter;
+}
+
+Histogram &MetricsRegistry::histogram(const std::string &name, const std::string &help, const MetricLabels &labels,
+	const std::vector<double> &bounds) {
+	std::string formatted = format_labels(labels);
+	std::lock_guard<std::mutex> lock(mutex_);
+	Family &family = family_locked(name, help, Type::HISTOGRAM);
+	for (Series &series : family.series) {
+		if (series.histogram && series.labels == formatted) {
+			return *series.histogram;
+		}
+	}
+	Series series;
+	series.labels = std::move(formatted);
+	series.histogram = std::make_unique<Histogram>(bounds);
+	family.series.push_back(std::move(series));
+	return *family.series.back().histogram;
+}
+
+MetricsRegistry::CallbackId MetricsRegistry::add_callback(Type type, const std::string &name, const std::string &help,
+	const MetricLabels &labels, std::function<double()> value) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	Family &family = family_locked(name, help, type);
+	Series series;
+	series.labels = format_labels(labels);
+	series.callback_id = next_callback_id_++;
+	series.callback = std::move(value);
+	family.series.push_back(std::move(series));
+	return family.series.back().callback_id;
+}
+
+void MetricsRegistry::remove_callback(CallbackId id) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	for (auto it = families_.begin(); it != families_.end(); ++it) {
+		auto &series = it->second.series;
+		auto found = std::find_if(series.begin(), series.end(), [id](const Series &s) {
+			return s.callback_id == id;
+		});
+		if (found == series.end()) {
+			continue;
+		}
+		series.erase(found);
+		if (series.empty()) {
+			families_.erase(it);
+		}
+		return;
+	}
+}
+
+std::string MetricsRegistry::render() const {
+	std::string out;
+	std::lock_guard<std::mutex> lock(mutex_);
+	out.reserve(families_.size() * 256);
+	for (const auto &entry : families_) {
+		const std::string &name = entry.first;
+		const Family &family = entry.second;
+		out += "# HELP " + name + ' ' + family.help + '\n';
+		out += "# TYPE " + name + ' ' + type_name(family.type) + '\n';
+
+		for (const Series &series : family.series) {
+			if (series.counter) {
+				append_sample(out, name, series.labels, "", static_cast<double>(series.counter->value()));
+			} else if (series.callback) {
+				append_sample(out, name, series.labels, "", series.callback());
+			} else if (series.histogram) {
+				Histogram::Snapshot snapshot = series.histogram->snapshot();
+				std::string bucket_name = name + "_bucket";
+				for (size_t i = 0; i < snapshot.bounds.size(); i++) {
+					std::string le = "le=\"";
+					append_number(le, snapshot.bounds[i]);
+					le += '"';
+					append_sample(out, bucket_name, series.labels, le, static_cast<double>(snapshot.cumulative[i]));
+				}
+				append_sample(out, bucket_name, series.labels, "le=\"+Inf\"", static_cast<double>(snapshot.count));
+				append_sample(out, name + "_sum", series.labels, "", snapshot.sum);
+				append_sample(out, name + "_count", series.labels, "", static_cast<double>(snapshot.count));
+			}
+		}
+	}
+	return out;
+}
+
+}
@@ -0,0 +1,46 @@
+#include <name_table.h>
+
+namespace dl {
+
+NameTable::NameTable() = default;
+
+NameTable::~NameTable() = default;
+
+NameTable::Id NameTable::intern(std::string_view name) {
+	if (name.empty()) {
+		return 0;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto it = ids_.find(name);
+	if (it != ids_.end()) {
+		return it->second;
+	}
+
+	size_t index = size_.load(std::memory_order_relaxed);
+	if (index >= CHUNK_SIZE * MAX_CHUNKS) {
+		return 0;
+	}
+	auto &chunk = chunks_[index / CHUNK_SIZE];
+	if (!chunk) {
+		chunk = std::make_unique<std::string[]>(CHUNK_SIZE);
+	}
+	std::string &slot = chunk[index % CHUNK_SIZE];
+	slot.assign(name);
+
+	Id id = static_cast<Id>(index + 1);
+	ids_.emplace(std::string_view(slot), id);
+	// 发布：读者看到新的 size_ 时，块指针与名字内容都已写好
+	size_.store(index + 1, std::memory_order_release);
+	return id;
+}
+
+std::string_view NameTable::name(Id id) const {
+	if (id == 0 || id > size_.load(std::memory_order_acquire)) {
+		return {};
+	}
+	size_t index = id - 1;
+	return chunks_[index / CHUNK_SIZE][index % CHUNK_SIZE];
+}
+
+} // namespace dl
@@ -0,0 +1,163 @@
+#include <player_index.h>
+#include <atomic>
+#include <cstddef>
+
+namespace dl {
+
+static std::string to_lower_ascii(std::string_view s) {
+	std::string result(s);
+	for (char &c : result) {
+		if (c >= 'A' && c <= 'Z') {
+			c = static_cast<char>(c - 'A' + 'a');
+		}
+	}
+	return result;
+}
+
+PlayerNameIndex::PlayerNameIndex() {
+	auto snapshot = std::make_shared<Snapshot>();
+	snapshot->base = build_base({});
+	current_ = std::move(snapshot);
+}
+
+std::shared_ptr<const PlayerNameIndex::Base> PlayerNameIndex::build_base(std::vector<std::string> names) {
+	auto base = std::make_shared<Base>();
+	base->names = std::move(names);
+	base->name_set.reserve(base->names.size());
+	base->lower_name_set.reserve(base->names.size());
+	for (const auto &name : base->names) {
+		base->automaton.add_pattern(name);
+		base->name_set.insert(name);
+		base->lower_name_set.insert(to_lower_ascii(name));
+	}
+	base->automaton.build();
+	return base;
+}
+
+void PlayerNameIndex::reset(std::vector<std::string> names) {
+	auto snapshot = std::make_shared<Snapshot>();
+	snapshot->base = build_base(std::move(names));
+
+	std::lock_guard<std::mutex> lock(write_mutex_);
+	snapshot->version = std::atomic_load(&current_)->version + 1;
+	std::atomic_store(&current_, std::shared_ptr<const Snapshot>(std::move(snapshot)));
+}
+
+bool PlayerNameIndex::insert(const std::string &name) {
+	if (name.empty()) {
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(write_mutex_);
+	auto old = std::atomic_load(&current_);
+
+	auto snapshot = std::make_shared<Snapshot>();
+	snapshot->base = old->base;
+	snapshot->recent.reserve(old->recent.size() + 1);
+	snapshot->recent = old->recent;
+	snapshot->recent.push_back(name);
+	snapshot->version = old->version + 1;
+	bool need_rebuild = !rebuilding_ && snapshot->recent.size() >= REBUILD_THRESHOLD;
+	if (need_rebuild) {
+		rebuilding_ = true;
+	}
+
+	std::atomic_store(&current_, std::shared_ptr<const Snapshot>(std::move(snapshot)));
+	return need_rebuild;
+}
+
+void PlayerNameIndex::rebuild() {
+	// 快照不可变，取得后即可在锁外复制名字并构建自动机
+	std::shared_ptr<const Snapshot> old;
+	{
+		std::lock_guard<std::mutex> lock(write_mutex_);
+		rebuilding_ = true;
+		old = std::atomic_load(&current_);
+	}
+
+	std::vector<std::string> names;
+	names.reserve(old->base->names.size() + old->recent.size());
+	names = old->base->names;
+	names.insert(names.end(), old->recent.begin(), old->recent.end());
+	auto base = build_base(std::move(names));
+
+	std::lock_guard<std::mutex> lock(write_mutex_);
+	rebuilding_ = false;
+	auto current = std::atomic_load(&current_);
+	if (current->base != old->base) {
+		// 构建期间索引已被 reset()，结果已过时
+		return;
+	}
+
+	// 构建期间新增的玩家追加在增量列表末尾，继续保留在增量列表中
+	auto snapshot = std::make_shared<Snapshot>();
+	snapshot->base = std::move(base);
+	snapshot->recent.assign(current->recent.begin() + static_cast<std::ptrdiff_t>(old->recent.size()), current->recent.end());
+	snapshot->version = current->version + 1;
+	std::atomic_store(&current_, std::shared_ptr<const Snapshot>(std::move(snapshot)));
+}
+
+bool PlayerNameIndex::contains(std::string_view name, bool case_insensitive) const {
+	auto snapshot = this->snapshot();
+
+	if (!case_insensitive) {
+		if (snapshot->base->name_set.count(name) > 0) {
+			return true;
+		}
+		for (const auto &recent : snapshot->recent) {
+			if (recent == name) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	std::string lower = to_lower_ascii(name);
+	if (snapshot->base->lower_name_set.count(lower) > 0) {
+		return true;
+	}
+	// 增量列表通常不超过 REBUILD_THRESHOLD（重建期间的新增会暂时超出），线性比较即可
+	for (const auto &recent : snapshot->recent) {
+		if (to_lower_ascii(recent) == lower) {
+			return true;
+		}
+	}
+	return false;
+}
+
+std::string PlayerNameIndex::find_earliest(std::string_view text) const {
+	auto snapshot = this->snapshot();
+	const Base &base = *snapshot->base;
+
+	size_t best_pos = std::string_view::npos;
+	size_t best_len = 0;
+	const std::string *best = nullptr;
+
+	auto consider = [&](size_t pos, const std::string &name) {
+		if (pos < best_pos || (pos == best_pos && name.size() > best_len)) {
+			best_pos = pos;
+			best_len = name.size();
+			best = &name;
+		}
+	};
+
+	base.automaton.scan(text, [&](AhoCorasick::PatternId id, size_t end) {
+		consider(end - base.automaton.pattern_length(id), base.names[id]);
+		return true;
+	});
+
+	for (const auto &name : snapshot->recent) {
+		size_t pos = text.find(name);
+		if (pos != std::string_view::npos) {
+			consider(pos, name);
+		}
+	}
+
+	return best ? *best : std::string();
+}
+
+std::shared_ptr<const PlayerNameIndex::Snapshot> PlayerNameIndex::snapshot() const {
+	return std::atomic_load(&current_);
+}
+
+} // namespace dl
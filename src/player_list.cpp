@@ -1,10 +1,11 @@
 #include <player_list.h>
 #include <algorithm>
-#include <ctime>
+#include <charconv>
+#include <cstdlib>
 #include <fstream>
-#include <iomanip>
-#include <iostream>
-#include <sstream>
+#include <io/mapped_file.h>
+#include <logger.h>
+#include <time_util.h>
 
 namespace dl {
 
@@ -12,139 +13,101 @@ namespace dl {
 // 辅助函数
 // ============================================================================
 
-static std::string trim(const std::string& s) {
-    size_t start = s.find_first_not_of(" \t\r\n");
-    if (start == std::string::npos) return "";
-    size_t end = s.find_last_not_of(" \t\r\n");
-    return s.substr(start, end - start + 1);
-}
-
-static std::string to_lower(const std::string& s) {
-    std::string result = s;
-    std::transform(result.begin(), result.end(), result.begin(), ::tolower);
-    return result;
-}
+static constexpr const char* PERMANENT_TIME_STRING = "0000-00-00 00:00:00";
 
-static std::string remove_spaces(const std::string& s) {
-    std::string result;
-    result.reserve(s.size());
-    for (char c : s) {
-        if (c != ' ' && c != '\t') {
-            result += c;
-        }
+// 封禁记录中的时间，永久封禁的解封时间记为 "0000-00-00 00:00:00"
+static std::chrono::system_clock::time_point string_to_time(std::string_view s) {
+    if (s == PERMANENT_TIME_STRING) {
+        return std::chrono::system_clock::time_point::max();
     }
-    return result;
+    std::chrono::system_clock::time_point tp{};
+    parse_local_time(s, tp);
+    return tp;
 }
 
-// 去除 ANSI 转义序列 (终端控制符)
-// 格式: ESC[ ... m  或  [ 数字;数字 m
-static std::string remove_ansi(const std::string& s) {
-    std::string result;
-    result.reserve(s.size());
-    
-    size_t i = 0;
-    while (i < s.size()) {
-        // 检查 ESC 字符 (\x1b 或 \033，ASCII 27)
-        if (s[i] == '\x1b') {
-            if (i + 1 < s.size() && s[i + 1] == '[') {
-                // 跳过 ESC[
-                i += 2;
-                // 跳过数字和分号
-                while (i < s.size() && ((s[i] >= '0' && s[i] <= '9') || s[i] == ';')) {
-                    i++;
-                }
-                // 跳过结束字母 (通常是 m)
-                if (i < s.size() && ((s[i] >= 'A' && s[i] <= 'Z') || (s[i] >= 'a' && s[i] <= 'z'))) {
-                    i++;
-                }
-                continue;
-            }
-            // 单独的 ESC，跳过
-            i++;
-            continue;
-        }
-        
-        // 检查可能 ESC 被过滤后只剩 [数字;数字m] 的情况
-        if (s[i] == '[') {
-            size_t j = i + 1;
-            // 必须以数字开头才认为是 ANSI 序列
-            if (j < s.size() && s[j] >= '0' && s[j] <= '9') {
-                // 跳过数字和分号
-                while (j < s.size() && ((s[j] >= '0' && s[j] <= '9') || s[j] == ';')) {
-                    j++;
-                }
-                // 必须以 m 结尾
-                if (j < s.size() && s[j] == 'm') {
-                    i = j + 1;
-                    continue;
-                }
-            }
-        }
-        
-        result += s[i];
+static bool parse_int(std::string_view s, size_t& i, int& out) {
+    size_t begin = i;
+    out = 0;
+    while (i < s.size() && s[i] >= '0' && s[i] <= '9') {
+        out = out * 10 + (s[i] - '0');
         i++;
     }
-    
-    return result;
-}
-
-static std::string time_to_string(const std::chrono::system_clock::time_point& tp, bool permanent = false) {
-    if (permanent) return "0000-00-00 00:00:00";
-    auto t = std::chrono::system_clock::to_time_t(tp);
-    std::tm tm{};
-    localtime_r(&t, &tm);
-    std::ostringstream oss;
-    oss << std::put_time(&tm, "%Y-%m-%d %H:%M:%S");
-    return oss.str();
-}
-
-static std::chrono::system_clock::time_point string_to_time(const std::string& s) {
-    if (s == "0000-00-00 00:00:00") {
-        return std::chrono::system_clock::time_point::max();
-    }
-    std::tm tm{};
-    std::istringstream iss(s);
-    iss >> std::get_time(&tm, "%Y-%m-%d %H:%M:%S");
-    return std::chrono::system_clock::from_time_t(mktime(&tm));
+    return i > begin;
 }
 
-static std::chrono::system_clock::time_point parse_log_time(const std::string& line) {
+// 从 "[HH:MM:SS ..." 形式的行首解析日志时间（日期取当天）
+static std::chrono::system_clock::time_point parse_log_time(std::string_view line) {
     auto now = std::chrono::system_clock::now();
     size_t start = line.find('[');
+    if (start == std::string_view::npos) return now;
     size_t end = line.find(' ', start);
-    if (start == std::string::npos || end == std::string::npos) return now;
-    
-    std::string time_str = line.substr(start + 1, end - start - 1);
+    if (end == std::string_view::npos) return now;
+
+    std::string_view time_str = line.substr(start + 1, end - start - 1);
+    size_t i = 0;
     int h, m, s;
-    if (sscanf(time_str.c_str(), "%d:%d:%d", &h, &m, &s) != 3) return now;
-    
-    auto t = std::chrono::system_clock::to_time_t(now);
-    std::tm tm{};
-    localtime_r(&t, &tm);
-    tm.tm_hour = h;
-    tm.tm_min = m;
-    tm.tm_sec = s;
-    return std::chrono::system_clock::from_time_t(mktime(&tm));
+    if (!parse_int(time_str, i, h) || i >= time_str.size() || time_str[i++] != ':'
+        || !parse_int(time_str, i, m) || i >= time_str.size() || time_str[i++] != ':'
+        || !parse_int(time_str, i, s)) {
+        return now;
+    }
+
+    return local_time_today(h, m, s);
 }
 
 std::string BannedPlayerInfo::get_ban_time_string() const {
-    auto time_t_val = std::chrono::system_clock::to_time_t(ban_time);
-    std::tm tm_val{};
-    localtime_r(&time_t_val, &tm_val);
-    
-    std::ostringstream oss;
-    oss << std::put_time(&tm_val, "%Y-%m-%d %H:%M:%S");
-    return oss.str();
+    return format_local_time(ban_time);
 }
 
 std::string BannedPlayerInfo::get_unban_time_string() const {
-    auto time_t_val = std::chrono::system_clock::to_time_t(unban_time);
-    std::tm tm_val{};
-    localtime_r(&time_t_val, &tm_val);
-    
-    std::ostringstream oss;
-    oss << std::put_time(&tm_val, "%Y-%m-%d %H:%M:%S");
-    return oss.str();
+    return format_local_time(unban_time);
+}
+
+// ============================================================================
+// 日志记录（journal）编码
+// ============================================================================
+// J|name                                  玩家首次出现
+// B|name|ban_time|unban_time|reason       封禁（时间为 Unix 秒，unban_time 为 0 表示永久）
+// P|name                                  解封
+// 原因放在最后一个字段，其中的 '|' 不影响解析；换行符替换为空格，保证一条记录一行
+
+static std::string encode_ban_record(const BannedPlayerInfo& info) {
+    std::string record = "B|" + info.name + "|" +
+        std::to_string(std::chrono::system_clock::to_time_t(info.ban_time)) + "|" +
+        (info.is_permanent ? "0" : std::to_string(std::chrono::system_clock::to_time_t(info.unban_time))) + "|";
+    for (char c : info.reason) {
+        record += (c == '\n' || c == '\r') ? ' ' : c;
+    }
+    return record;
+}
+
+static bool decode_ban_record(std::string_view record, BannedPlayerInfo& info) {
+    size_t p1 = record.find('|', 2);
+    if (p1 == std::string_view::npos) return false;
+    size_t p2 = record.find('|', p1 + 1);
+    if (p2 == std::string_view::npos) return false;
+    size_t p3 = record.find('|', p2 + 1);
+    if (p3 == std::string_view::npos) return false;
+
+    info.name = std::string(record.substr(2, p1 - 2));
+    std::string ban_str(record.substr(p1 + 1, p2 - p1 - 1));
+    std::string unban_str(record.substr(p2 + 1, p3 - p2 - 1));
+    info.reason = std::string(record.substr(p3 + 1));
+    info.ban_time = std::chrono::system_clock::from_time_t(std::strtoll(ban_str.c_str(), nullptr, 10));
+    info.is_permanent = (unban_str == "0");
+    info.unban_time = info.is_permanent
+        ? std::chrono::system_clock::time_point::max()
+        : std::chrono::system_clock::from_time_t(std::strtoll(unban_str.c_str(), nullptr, 10));
+    return !info.name.empty();
+}
+
+// 复制当前快照，修改后递增版本号并原子替换（调用方需持有写锁）
+template <typename T, typename F>
+static void update_snapshot(std::shared_ptr<const T>& slot, F&& mutate) {
+    auto next = std::make_shared<T>(*std::atomic_load(&slot));
+    mutate(next->players);
+    next->version++;
+    std::atomic_store(&slot, std::shared_ptr<const T>(std::move(next)));
 }
 
 // ============================================================================
@@ -152,216 +115,232 @@ std::string BannedPlayerInfo::get_unban_time_string() const {
 // ============================================================================
 
 std::vector<BannedPlayerInfo> PlayerList::list_banned_player_info() const {
-    std::lock_guard<std::mutex> lock(mutex_);
+    auto banned = banned_snapshot();
     std::vector<BannedPlayerInfo> result;
-    result.reserve(banned_players_.size());
-    for (const auto& p : banned_players_) {
+    result.reserve(banned->players.size());
+    for (const auto& p : banned->players) {
         result.push_back(p.second);
     }
     return result;
 }
 
+std::shared_ptr<const OnlineSnapshot> PlayerList::online_snapshot() const {
+    return std::atomic_load(&online_);
+}
+
+std::shared_ptr<const BannedSnapshot> PlayerList::banned_snapshot() const {
+    // 封禁不在每次修改时复制整个名单，批量封禁时只有其后的第一次读取付出一次复制
+    if (banned_dirty_.load(std::memory_order_acquire)) {
+        std::lock_guard<TimedMutex> lock(mutex_);
+        if (banned_dirty_.load(std::memory_order_relaxed)) publish_banned_locked();
+    }
+    return std::atomic_load(&banned_);
+}
+
+void PlayerList::publish_banned_locked() const {
+    auto next = std::make_shared<BannedSnapshot>();
+    next->players = banned_players_;
+    next->version = std::atomic_load(&banned_)->version + 1;
+    std::atomic_store(&banned_, std::shared_ptr<const BannedSnapshot>(std::move(next)));
+    banned_dirty_.store(false, std::memory_order_release);
+}
+
+std::shared_ptr<const PlayerNameIndex::Snapshot> PlayerList::player_snapshot() const {
+    return name_index_.snapshot();
+}
+
 PlayerList::PlayerList(const std::string& player_file,
                        const std::string& banned_file,
                        const std::string& forbidden_cmd_file,
-                       const Program& program)
+                       const Program& program,
+                       TimerQueue* timers)
     : player_file_(player_file)
     , banned_file_(banned_file)
     , forbidden_file_(forbidden_cmd_file)
-    , program_(program) {
+    , programs_{&program}
+    , online_(std::make_shared<OnlineSnapshot>())
+    , banned_(std::make_shared<BannedSnapshot>())
+    , own_timers_(timers ? nullptr : std::make_unique<TimerQueue>())
+    , timers_(timers ? timers : own_timers_.get()) {
     load_files();
-    checker_thread_ = std::thread(&PlayerList::ban_checker_thread_func, this);
+    // 之后的每次变更只追加一条记录，由 journal 的写线程批量落盘并定期压缩回快照文件
+    journal_ = std::make_unique<Journal>(journal_file(), [this] {
+        return save_files();
+    });
+    // 每个限时封禁一个定时器，永久封禁不占用定时器
+    std::lock_guard<TimedMutex> lock(mutex_);
+    for (const auto& p : banned_players_) {
+        schedule_unban_locked(p.second);
+    }
 }
 
 PlayerList::~PlayerList() {
+    // 取消所有解封定时器，并等待可能正在执行的解封返回
     {
-        std::lock_guard<std::mutex> lock(checker_mutex_);
-        stop_checker_ = true;
-    }
-    checker_cv_.notify_all();
-    if (checker_thread_.joinable()) {
-        checker_thread_.join();
+        std::lock_guard<TimedMutex> lock(mutex_);
+        stopping_ = true;
+        for (const auto& p : unban_timers_) {
+            timers_->cancel(p.second.id);
+        }
+        unban_timers_.clear();
     }
+    timers_->wait_idle();
     
-    std::lock_guard<std::mutex> lock(mutex_);
-    online_players_.clear();
-    save_files();
+    {
+        std::lock_guard<TimedMutex> lock(mutex_);
+        update_snapshot(online_, [](auto& players) {
+            players.clear();
+        });
+    }
+    // 退出时压缩一次，快照文件即为最终状态
+    journal_->compact();
+    journal_.reset();
 }
 
 // ============================================================================
 // 日志处理
 // ============================================================================
 
-LogEvent PlayerList::process_log_line(const std::string& log_line) {
-    LogEvent event;
-    
-    // 首先清理 ANSI 转义序列
-    std::string clean_line = remove_ansi(log_line);
-    
-    event.timestamp = parse_log_time(clean_line);
-    
-    size_t content_start = clean_line.find("]: ");
-    if (content_start == std::string::npos) return event;
-    std::string content = clean_line.substr(content_start + 3);
-    
-    // =========== 玩家加入 (Leaves/Carpet等) ===========
-    size_t pos = content.find(" joined with ");
-    if (pos != std::string::npos) {
-        size_t player_pos = content.rfind("Player ", pos);
-        if (player_pos != std::string::npos) {
-            size_t name_start = player_pos + 7;
-            event.player_name = trim(content.substr(name_start, pos - name_start));
-            event.client_info = trim(content.substr(pos + 13));
-            event.type = LogEventType::PLAYER_JOIN;
-            
-            // 去除结尾 \n
-            while (!event.client_info.empty() && event.client_info.back() == '\n') {
-                event.client_info.pop_back();
-            }
-            
-            std::lock_guard<std::mutex> lock(mutex_);
-            all_players_.insert(event.player_name);
-            online_players_[event.player_name] = {event.player_name, event.timestamp, event.client_info};
-            return event;
-        }
+// 按事件类型记录 process_log_line 的耗时，类型在分类之后才确定，因此在析构时选择直方图
+class LineLatencyTimer {
+public:
+    explicit LineLatencyTimer(const LogEvent& event) : event_(event), start_(Histogram::Clock::now()) {}
+    ~LineLatencyTimer() {
+        histogram(event_.type).observe(Histogram::Clock::now() - start_);
     }
     
-    // =========== 玩家加入 (原版) ===========
-    pos = content.find(" joined the game");
-    if (pos != std::string::npos) {
-        event.player_name = trim(content.substr(0, pos));
-        event.client_info = "vanilla";
-        event.type = LogEventType::PLAYER_JOIN;
-        
-        std::lock_guard<std::mutex> lock(mutex_);
-        all_players_.insert(event.player_name);
-        online_players_[event.player_name] = {event.player_name, event.timestamp, event.client_info};
-        return event;
+private:
+    static Histogram& histogram(LogEventType type) {
+        static Histogram* histograms[] = {
+            &line_histogram("none"),
+            &line_histogram(log_event_type_name(LogEventType::PLAYER_JOIN)),
+            &line_histogram(log_event_type_name(LogEventType::PLAYER_LEAVE)),
+            &line_histogram(log_event_type_name(LogEventType::PLAYER_COMMAND)),
+            &line_histogram(log_event_type_name(LogEventType::PLAYER_CHAT)),
+        };
+        return *histograms[static_cast<size_t>(type)];
     }
-    
-    // =========== 玩家离开 ===========
-    pos = content.find(" left the game");
-    if (pos != std::string::npos) {
-        event.player_name = trim(content.substr(0, pos));
-        event.type = LogEventType::PLAYER_LEAVE;
-        
-        std::lock_guard<std::mutex> lock(mutex_);
-        online_players_.erase(event.player_name);
-        return event;
+    static Histogram& line_histogram(const char* type) {
+        return MetricsRegistry::global().histogram("dreamland_log_line_seconds",
+            "Time spent in PlayerList::process_log_line by event type.", {{"type", type}});
     }
     
-    // =========== 玩家执行指令 ===========
-    pos = content.find(" issued server command: /");
-    if (pos != std::string::npos) {
-        event.player_name = trim(content.substr(0, pos));
-        event.content = content.substr(pos + 25);
-        event.type = LogEventType::PLAYER_COMMAND;
-        
-        // 去除结尾 \n
-        while (!event.content.empty() && event.content.back() == '\n') {
-            event.content.pop_back();
-        }
-        
-        // 去掉空格并转小写后匹配关键词
-        std::string match_str = to_lower(remove_spaces(content));
-        
-        std::lock_guard<std::mutex> lock(mutex_);
-        for (const auto& fc : forbidden_commands_) {
-            std::string keyword = to_lower(remove_spaces(fc.command));
-            if (match_str.find(keyword) != std::string::npos) {
-                auto unban_time = std::chrono::system_clock::now() + std::chrono::hours(fc.ban_hours);
-                std::string time_str = time_to_string(unban_time);
-                
-                std::string reason = "执行被禁止的指令: /" + event.content + 
-                    ", 将被" + 
-                    (fc.ban_hours != 0 ? "封禁至" + time_str + "。" : "永久封禁。") + 
-                    "有异议请在服务器管理网站提出解封申请。";
-                
-                mutex_.unlock();
-                ban(event.player_name, reason, fc.ban_hours);
-                mutex_.lock();
-                break;
+    const LogEvent& event_;
+    Histogram::Clock::time_point start_;
+};
+
+LogEvent PlayerList::process_log_line(std::string_view log_line, std::string_view server) {
+    LogEvent event;
+    LineLatencyTimer timer(event);
+
+    // 单遍去除 ANSI 转义序列并定位事件类型，与玩家无关的行在这里直接返回，不产生任何分配
+    thread_local std::string scratch;
+    LogLineView view = classifier_.classify(log_line, scratch);
+    if (view.type == LogEventType::NONE) return event;
+
+    event.type = view.type;
+    event.timestamp = parse_log_time(view.line);
+
+    switch (view.type) {
+    // =========== 玩家加入 ===========
+    case LogEventType::PLAYER_JOIN: {
+        event.player_name = std::string(view.player);
+        event.client_info = std::string(view.detail);
+
+        bool rebuild_index = false;
+        {
+            std::lock_guard<TimedMutex> lock(mutex_);
+            if (all_players_.insert(event.player_name).second) {
+                rebuild_index = name_index_.insert(event.player_name);
+                journal_->append("J|" + event.player_name);
             }
+            OnlinePlayerInfo info{event.player_name, event.timestamp, event.client_info, std::string(server)};
+            update_snapshot(online_, [&info](auto& players) {
+                players[info.name] = info;
+            });
         }
-		event.content = '/' + event.content;
+        // 自动机重建耗时与玩家总数成正比，在锁外进行，不阻塞其他实例的日志处理和 Web 查询
+        if (rebuild_index) name_index_.rebuild();
+        if (change_callback_) change_callback_(PlayerChange::JOIN, event.player_name, event.client_info);
         return event;
     }
-    
-    // =========== 玩家操作行（F3+F4等） ===========
-    if (!content.empty() && content[0] == '[') {
-        size_t end_bracket = content.find(']');
-        size_t colon_pos = content.find(':');
-        if (end_bracket != std::string::npos && colon_pos != std::string::npos && colon_pos < end_bracket) {
-            std::string bracket_content = content.substr(1, end_bracket - 1);
-            
-            // 去掉空格并转小写后匹配关键词
-            std::string match_str = to_lower(remove_spaces(bracket_content));
-            
-            // 查找所有玩家中第一个出现在这行的玩家
-            std::string found_player;
-            size_t earliest_pos = std::string::npos;
-            
-            {
-                std::lock_guard<std::mutex> lock(mutex_);
-                for (const auto& player : all_players_) {
-                    size_t player_pos = content.find(player);
-                    if (player_pos != std::string::npos && player_pos < earliest_pos) {
-                        earliest_pos = player_pos;
-                        found_player = player;
-                    }
-                }
-            }
-            
-            // 无论是否匹配禁止关键词，都返回事件
-            event.type = LogEventType::PLAYER_COMMAND;
-            event.player_name = found_player;
-            event.content = bracket_content;
-            
-            // 去除结尾 \n
-            while (!event.content.empty() && event.content.back() == '\n') {
-                event.content.pop_back();
-            }
-            
-            // 检查禁止关键词并封禁
-            std::lock_guard<std::mutex> lock(mutex_);
-            for (const auto& fc : forbidden_commands_) {
-                std::string keyword = to_lower(remove_spaces(fc.command));
-                if (match_str.find(keyword) != std::string::npos && !found_player.empty()) {
-                    auto unban_time = std::chrono::system_clock::now() + std::chrono::hours(fc.ban_hours);
-                    std::string time_str = time_to_string(unban_time);
-                    
-                    std::string reason = "执行被禁止的操作: [" + event.content + "], 将被" + 
-                        (fc.ban_hours != 0 ? "封禁至" + time_str + "。" : "永久封禁。") + 
-                        "有异议请在服务器管理网站提出解封申请。";
-                    
-                    mutex_.unlock();
-                    ban(found_player, reason, fc.ban_hours);
-                    mutex_.lock();
-                    break;
-                }
+
+    // =========== 玩家离开 ===========
+    case LogEventType::PLAYER_LEAVE: {
+        event.player_name = std::string(view.player);
+
+        bool removed = false;
+        {
+            std::lock_guard<TimedMutex> lock(mutex_);
+            // 在另一个实例上重新加入的玩家，本实例的离开事件可能晚到，不能使其下线
+            auto online = online_snapshot();
+            auto it = online->players.find(event.player_name);
+            if (it != online->players.end() && it->second.server == server) {
+                update_snapshot(online_, [&event](auto& players) {
+                    players.erase(event.player_name);
+                });
+                removed = true;
             }
-			event.content = '[' + event.content + ']';
-            return event;
         }
+        if (removed && change_callback_) change_callback_(PlayerChange::LEAVE, event.player_name, "");
+        return event;
     }
-    
+
     // =========== 玩家聊天 ===========
-    if (!content.empty() && content[0] == '<') {
-        size_t end = content.find('>');
-        if (end != std::string::npos) {
-            event.player_name = content.substr(1, end - 1);
-            event.content = trim(content.substr(end + 1));
-            event.type = LogEventType::PLAYER_CHAT;
-            
-            // 去除结尾 \n
-            while (!event.content.empty() && event.content.back() == '\n') {
-                event.content.pop_back();
-            }
-            
-            return event;
+    case LogEventType::PLAYER_CHAT:
+        event.player_name = std::string(view.player);
+        event.content = std::string(view.detail);
+        return event;
+
+    default:
+        break;
+    }
+
+    // =========== 玩家执行指令 ===========
+    if (!view.is_operation) {
+        event.player_name = std::string(view.player);
+        event.content = std::string(view.detail);
+
+        // 去掉空格并转小写后匹配关键词（匹配器内部完成归一化）
+        const ForbiddenCommand* fc = forbidden_matcher_.match(view.content);
+        if (fc) {
+            auto unban_time = std::chrono::system_clock::now() + std::chrono::hours(fc->ban_hours);
+            std::string time_str = format_local_time(unban_time);
+
+            std::string reason = "执行被禁止的指令: /" + event.content +
+                ", 将被" +
+                (fc->ban_hours != 0 ? "封禁至" + time_str + "。" : "永久封禁。") +
+                "有异议请在服务器管理网站提出解封申请。";
+
+            ban(event.player_name, reason, fc->ban_hours);
         }
+        event.content = '/' + event.content;
+        return event;
     }
-    
+
+    // =========== 玩家操作行（F3+F4等） ===========
+    std::string bracket_content(view.detail);
+
+    // 查找所有玩家中第一个出现在这行的玩家（索引快照，单次扫描，不持有 mutex_）
+    std::string found_player = name_index_.find_earliest(view.content);
+
+    // 无论是否匹配禁止关键词，都返回事件
+    event.player_name = found_player;
+    event.content = bracket_content;
+
+    // 检查禁止关键词并封禁
+    const ForbiddenCommand* fc = found_player.empty() ? nullptr : forbidden_matcher_.match(view.detail);
+    if (fc) {
+        auto unban_time = std::chrono::system_clock::now() + std::chrono::hours(fc->ban_hours);
+        std::string time_str = format_local_time(unban_time);
+
+        std::string reason = "执行被禁止的操作: [" + event.content + "], 将被" +
+            (fc->ban_hours != 0 ? "封禁至" + time_str + "。" : "永久封禁。") +
+            "有异议请在服务器管理网站提出解封申请。";
+
+        ban(found_player, reason, fc->ban_hours);
+    }
+    event.content = '[' + event.content + ']';
     return event;
 }
 
@@ -383,72 +362,110 @@ bool PlayerList::ban(const std::string& player, const std::string& reason, uint6
     }
     
     {
-        std::lock_guard<std::mutex> lock(mutex_);
-        banned_players_[player] = info;
+        std::lock_guard<TimedMutex> lock(mutex_);
+        banned_players_[info.name] = info;
+        banned_dirty_.store(true, std::memory_order_release);
+        // 先修改内存状态再追加记录，且在锁内追加以保证记录顺序与修改顺序一致
+        journal_->append(encode_ban_record(info));
+        schedule_unban_locked(info);
     }
 
-	std::cout << "[PlayerList] 封禁玩家: " << player 
+	log_info() << "[PlayerList] 封禁玩家: " << player 
 			  << ", 原因: " << reason 
-			  << ", 时长: " << (banned_hours == 0 ? "永久" : std::to_string(banned_hours) + "小时") 
-			  << std::endl;
+			  << ", 时长: " << (banned_hours == 0 ? "永久" : std::to_string(banned_hours) + "小时");
     
-    const_cast<Program&>(program_).send_string("ban " + player + " " + reason + "\n");
-    save_files();
+    broadcast_command("ban " + player + " " + reason + "\n");
+    if (change_callback_) change_callback_(PlayerChange::BAN, player, reason);
     return true;
 }
 
 bool PlayerList::pardon(const std::string& player) {
     {
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (banned_players_.erase(player) == 0) return false;
+        std::lock_guard<TimedMutex> lock(mutex_);
+        if (!remove_ban_locked(player)) return false;
     }
     
-    const_cast<Program&>(program_).send_string("pardon " + player + "\n");
-    save_files();
+    broadcast_command("pardon " + player + "\n");
+    if (change_callback_) change_callback_(PlayerChange::PARDON, player, "");
+    return true;
+}
+
+void PlayerList::add_program(const Program& program) {
+    programs_.push_back(&program);
+}
+
+bool PlayerList::remove_ban_locked(const std::string& player) {
+    if (banned_players_.erase(player) == 0) return false;
+    banned_dirty_.store(true, std::memory_order_release);
+    journal_->append("P|" + player);
+    auto it = unban_timers_.find(player);
+    if (it != unban_timers_.end()) {
+        timers_->cancel(it->second.id);
+        unban_timers_.erase(it);
+    }
     return true;
 }
 
+void PlayerList::broadcast_command(const std::string& command) {
+    for (const Program* program : programs_) {
+        const_cast<Program*>(program)->send_string(command);
+    }
+}
+
 // ============================================================================
 // 查询
 // ============================================================================
 
+// 以下查询均基于不可变快照，不会与日志线程竞争 mutex_
+
 std::vector<std::string> PlayerList::list_player() const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return {all_players_.begin(), all_players_.end()};
+    auto players = player_snapshot();
+    std::vector<std::string> result;
+    result.reserve(players->base->names.size() + players->recent.size());
+    result.insert(result.end(), players->base->names.begin(), players->base->names.end());
+    result.insert(result.end(), players->recent.begin(), players->recent.end());
+    return result;
 }
 
 std::vector<std::string> PlayerList::list_banned_player() const {
-    std::lock_guard<std::mutex> lock(mutex_);
+    auto banned = banned_snapshot();
     std::vector<std::string> result;
-    for (const auto& p : banned_players_) {
+    result.reserve(banned->players.size());
+    for (const auto& p : banned->players) {
         result.push_back(p.first);
     }
     return result;
 }
 
 std::vector<OnlinePlayerInfo> PlayerList::list_online_player() const {
-    std::lock_guard<std::mutex> lock(mutex_);
+    auto online = online_snapshot();
     std::vector<OnlinePlayerInfo> result;
-    for (const auto& p : online_players_) {
+    result.reserve(online->players.size());
+    for (const auto& p : online->players) {
         result.push_back(p.second);
     }
     return result;
 }
 
+void PlayerList::set_change_callback(PlayerChangeCallback callback) {
+    change_callback_ = std::move(callback);
+}
+
+bool PlayerList::has_player(const std::string& player, bool case_insensitive) const {
+    return name_index_.contains(player, case_insensitive);
+}
+
 bool PlayerList::is_banned(const std::string& player) const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return banned_players_.count(player) > 0;
+    return banned_snapshot()->players.count(player) > 0;
 }
 
 bool PlayerList::is_online(const std::string& player) const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return online_players_.count(player) > 0;
+    return online_snapshot()->players.count(player) > 0;
 }
 
 bool PlayerList::save() const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    save_files();
-    return true;
+    // 由 journal 写线程完成压缩，不持有 mutex_
+    return journal_->compact();
 }
 
 // ============================================================================
@@ -456,110 +473,189 @@ bool PlayerList::save() const {
 // ============================================================================
 
 void PlayerList::load_files() {
-    std::lock_guard<std::mutex> lock(mutex_);
+    std::lock_guard<TimedMutex> lock(mutex_);
     
-    std::ifstream pf(player_file_);
-    if (pf) {
-        std::string line;
-        while (std::getline(pf, line)) {
-            line = trim(line);
-            if (!line.empty()) all_players_.insert(line);
-        }
+    // 文件映射到内存后直接按行解析，容器按行数一次预留，历史玩家很多时也不会反复 rehash
+    MappedFile pf;
+    if (pf.open(player_file_)) {
+        all_players_.reserve(count_lines(pf.view()));
+        for_each_line(pf.view(), [this](std::string_view line) {
+            line = trim_view(line);
+            if (!line.empty()) all_players_.emplace(line);
+        });
     } else {
         std::ofstream(player_file_);
     }
     
-    std::ifstream bf(banned_file_);
-    if (bf) {
-        std::string line;
-        while (std::getline(bf, line)) {
-            line = trim(line);
-            if (line.empty() || line[0] == '#') continue;
+    std::unordered_map<std::string, BannedPlayerInfo> banned;
+    MappedFile bf;
+    if (bf.open(banned_file_)) {
+        banned.reserve(count_lines(bf.view()));
+        for_each_line(bf.view(), [&banned](std::string_view line) {
+            line = trim_view(line);
+            if (line.empty() || line[0] == '#') return;
             
             size_t p1 = line.find('|');
             size_t p2 = line.find('|', p1 + 1);
             size_t p3 = line.find('|', p2 + 1);
-            if (p1 == std::string::npos || p2 == std::string::npos || p3 == std::string::npos) continue;
+            if (p1 == std::string_view::npos || p2 == std::string_view::npos || p3 == std::string_view::npos) return;
             
             BannedPlayerInfo info;
-            info.name = line.substr(0, p1);
-            info.reason = line.substr(p1 + 1, p2 - p1 - 1);
+            info.name = std::string(line.substr(0, p1));
+            info.reason = std::string(line.substr(p1 + 1, p2 - p1 - 1));
             info.ban_time = string_to_time(line.substr(p2 + 1, p3 - p2 - 1));
-            std::string unban_str = line.substr(p3 + 1);
-            info.is_permanent = (unban_str == "0000-00-00 00:00:00");
+            std::string_view unban_str = line.substr(p3 + 1);
+            info.is_permanent = (unban_str == PERMANENT_TIME_STRING);
             info.unban_time = string_to_time(unban_str);
-            banned_players_[info.name] = info;
-        }
+            banned[info.name] = std::move(info);
+        });
     } else {
         std::ofstream(banned_file_);
     }
+
+    // 重放上次压缩之后追加的记录，记录都是幂等的赋值，重复应用也不影响结果
+    size_t replayed = Journal::replay(journal_file(), [this, &banned](std::string_view record) {
+        if (record.size() < 2 || record[1] != '|') return;
+        switch (record[0]) {
+        case 'J':
+            all_players_.insert(std::string(record.substr(2)));
+            break;
+        case 'B': {
+            BannedPlayerInfo info;
+            if (decode_ban_record(record, info)) banned[info.name] = std::move(info);
+            break;
+        }
+        case 'P':
+            banned.erase(std::string(record.substr(2)));
+            break;
+        default:
+            break;
+        }
+    });
+    if (replayed > 0) {
+        log_info() << "[PlayerList] 从日志恢复 " << replayed << " 条记录";
+    }
+
+    name_index_.reset({all_players_.begin(), all_players_.end()});
+    banned_players_ = std::move(banned);
+    publish_banned_locked();
     
-    std::ifstream ff(forbidden_file_);
-    if (ff) {
-        std::string line;
-        while (std::getline(ff, line)) {
-            line = trim(line);
-            if (line.empty() || line[0] == '#') continue;
+    std::vector<ForbiddenCommand> forbidden_commands;
+    MappedFile ff;
+    if (ff.open(forbidden_file_)) {
+        forbidden_commands.reserve(count_lines(ff.view()));
+        for_each_line(ff.view(), [&forbidden_commands](std::string_view line) {
+            line = trim_view(line);
+            if (line.empty() || line[0] == '#') return;
             
-            std::istringstream iss(line);
-            std::string keyword;
+            // "关键词 小时数"，以空白分隔
+            size_t keyword_end = line.find_first_of(" \t");
+            if (keyword_end == std::string_view::npos) return;
+            std::string_view keyword = line.substr(0, keyword_end);
+            std::string_view hours_str = trim_view(line.substr(keyword_end));
             uint64_t hours = 0;
-            if (!(iss >> keyword >> hours)) continue;
+            if (std::from_chars(hours_str.data(), hours_str.data() + hours_str.size(), hours).ec != std::errc()) return;
             
-            if (!keyword.empty() && keyword[0] == '/') keyword = keyword.substr(1);
+            if (keyword[0] == '/') keyword.remove_prefix(1);
             
-            forbidden_commands_.push_back({keyword, hours});
-        }
+            forbidden_commands.push_back({std::string(keyword), hours});
+        });
     } else {
         std::ofstream(forbidden_file_);
     }
+
+    // 关键词只在这里归一化并编译一次
+    forbidden_matcher_ = ForbiddenCommandMatcher(std::move(forbidden_commands));
+}
+
+std::string PlayerList::journal_file() const {
+    return player_file_ + ".journal";
 }
 
-void PlayerList::save_files() const {
-    std::ofstream pf(player_file_);
-    for (const auto& p : all_players_) {
-        pf << p << "\n";
+bool PlayerList::save_files() const {
+    static Histogram& save_time = MetricsRegistry::global().histogram("dreamland_save_seconds",
+        "Time spent writing a data file.", {{"file", "players"}});
+    ScopedTimer timer(save_time);
+    
+    // 基于快照写出，不依赖调用方是否持有 mutex_；先写临时文件再 rename，中途崩溃不会留下半个文件
+    auto players = player_snapshot();
+    std::string pf;
+    for (const auto& p : players->base->names) {
+        pf += p;
+        pf += '\n';
+    }
+    for (const auto& p : players->recent) {
+        pf += p;
+        pf += '\n';
     }
     
-    std::ofstream bf(banned_file_);
-    bf << "# name|reason|ban_time|unban_time\n";
-    for (const auto& p : banned_players_) {
+    auto banned = banned_snapshot();
+    std::string bf = "# name|reason|ban_time|unban_time\n";
+    for (const auto& p : banned->players) {
         const auto& info = p.second;
-        bf << info.name << "|" << info.reason << "|"
-           << time_to_string(info.ban_time) << "|"
-           << time_to_string(info.unban_time, info.is_permanent) << "\n";
+        bf += info.name + "|" + info.reason + "|" +
+              format_local_time(info.ban_time) + "|" +
+              (info.is_permanent ? std::string(PERMANENT_TIME_STRING) : format_local_time(info.unban_time)) + "\n";
     }
+
+    bool ok = write_file_atomically(player_file_, pf);
+    ok = write_file_atomically(banned_file_, bf) && ok;
+    return ok;
 }
 
 // ============================================================================
-// 封禁检查线程
+// 限时封禁到期解封
 // ============================================================================
 
-void PlayerList::ban_checker_thread_func() {
-    while (true) {
-        std::unique_lock<std::mutex> lock(checker_mutex_);
-        checker_cv_.wait_for(lock, std::chrono::seconds(30), [this] {
-            return stop_checker_.load();
-        });
-        
-        if (stop_checker_) break;
+void PlayerList::schedule_unban_locked(const BannedPlayerInfo& info) {
+    auto it = unban_timers_.find(info.name);
+    if (it != unban_timers_.end()) {
+        timers_->cancel(it->second.id);
+        unban_timers_.erase(it);
+    }
+    if (info.is_permanent || stopping_) return;
+    
+    std::string player = info.name;
+    auto due = info.unban_time;
+    auto id = timers_->schedule_at(due, [this, player, due] {
+        auto_unban(player, due);
+    });
+    unban_timers_[player] = UnbanTimer{id, due};
+}
+
+void PlayerList::auto_unban(const std::string& player, std::chrono::system_clock::time_point due) {
+    {
+        std::lock_guard<TimedMutex> lock(mutex_);
+        // 取消只对尚未出队的定时器有效，已出队的回调可能在新封禁登记之后才拿到锁，
+        // 此时表中已是新定时器，不能删掉它，也不能解除新的封禁
+        auto timer = unban_timers_.find(player);
+        if (timer == unban_timers_.end() || timer->second.due != due) return;
+        unban_timers_.erase(timer);
         
-        std::vector<std::string> to_unban;
-        {
-            std::lock_guard<std::mutex> data_lock(mutex_);
-            auto now = std::chrono::system_clock::now();
-            for (const auto& p : banned_players_) {
-                if (!p.second.is_permanent && now >= p.second.unban_time) {
-                    to_unban.push_back(p.first);
-                }
-            }
+        auto it = banned_players_.find(player);
+        if (it == banned_players_.end() || it->second.is_permanent) return;
+        if (it->second.unban_time > std::chrono::system_clock::now()) {
+            schedule_unban_locked(it->second);
+            return;
         }
         
-        for (const auto& player : to_unban) {
-            pardon(player);
-            std::cout << "[PlayerList] 自动解封: " << player << std::endl;
+        // 没有任何 MC 服务器在运行时解封命令无法送达，稍后重试
+        bool any_running = std::any_of(programs_.begin(), programs_.end(), [](const Program* program) {
+            return program->is_running();
+        });
+        if (!any_running) {
+            BannedPlayerInfo retry = it->second;
+            retry.unban_time = std::chrono::system_clock::now() + UNBAN_RETRY_INTERVAL;
+            schedule_unban_locked(retry);
+            return;
         }
+        // 在同一次加锁内解封，避免释放锁后又被重新封禁时误解新的封禁
+        remove_ban_locked(player);
     }
+    
+    broadcast_command("pardon " + player + "\n");
+    if (change_callback_) change_callback_(PlayerChange::PARDON, player, "");
+    log_info() << "[PlayerList] 自动解封: " << player;
 }
 
 } // namespace dl
@@ -0,0 +1,62 @@
+#include <algorithm>
+#include <cmath>
+#include <rate_limiter.h>
+
+namespace dl {
+
+RateLimiter::RateLimiter(double per_minute, double burst)
+	: per_second_(std::max(per_minute, 0.0) / 60)
+	, burst_(std::max(burst, 1.0)) {
+}
+
+bool RateLimiter::allow(std::string_view key, int *retry_after) {
+	if (!enabled()) {
+		return true;
+	}
+
+	Clock::time_point now = Clock::now();
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (buckets_.size() >= prune_at_) {
+		prune_locked(now);
+	}
+
+	auto it = buckets_.find(std::string(key));
+	if (it == buckets_.end()) {
+		it = buckets_.emplace(std::string(key), Bucket { burst_, now }).first;
+	}
+	Bucket &bucket = it->second;
+	double elapsed = std::chrono::duration<double>(now - bucket.updated).count();
+	bucket.tokens = std::min(burst_, bucket.tokens + elapsed * per_second_);
+	bucket.updated = now;
+
+	if (bucket.tokens >= 1) {
+		bucket.tokens -= 1;
+		return true;
+	}
+
+	rejected_.fetch_add(1, std::memory_order_relaxed);
+	if (retry_after) {
+		*retry_after = static_cast<int>(std::ceil((1 - bucket.tokens) / per_second_));
+	}
+	return false;
+}
+
+size_t RateLimiter::tracked() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return buckets_.size();
+}
+
+void RateLimiter::prune_locked(Clock::time_point now) {
+	for (auto it = buckets_.begin(); it != buckets_.end();) {
+		double elapsed = std::chrono::duration<double>(now - it->second.updated).count();
+		if (it->second.tokens + elapsed * per_second_ >= burst_) {
+			it = buckets_.erase(it);
+		} else {
+			++it;
+		}
+	}
+	// 清理后仍然很大说明活跃的键确实很多，推迟下次清理避免每次调用都遍历
+	prune_at_ = std::max(MIN_PRUNE_SIZE, buckets_.size() * 2);
+}
+
+}
@@ -1,11 +1,11 @@
 #include <algorithm>
+#include <charconv>
 #include <chrono>
-#include <ctime>
-#include <fstream>
-#include <iomanip>
-#include <iostream>
+#include <cstring>
+#include <io/mapped_file.h>
+#include <logger.h>
 #include <server_manager.h>
-#include <sstream>
+#include <time_util.h>
 
 namespace dl {
 
@@ -13,16 +13,6 @@ namespace dl {
 // 辅助函数
 // ============================================================================
 
-static std::string get_current_time_string() {
-	auto now = std::chrono::system_clock::now();
-	auto t = std::chrono::system_clock::to_time_t(now);
-	std::tm tm {};
-	localtime_r(&t, &tm);
-	std::ostringstream oss;
-	oss << std::put_time(&tm, "%Y-%m-%d %H:%M:%S");
-	return oss.str();
-}
-
 static std::string trim(const std::string &s) {
 	size_t start = s.find_first_not_of(" \t\r\n");
 	if (start == std::string::npos)
@@ -37,27 +27,57 @@ static std::string trim(const std::string &s) {
 
 ServerManager::ServerManager(Program *program,
 	const std::string &ops_file,
-	PlayerList &player_list) : ops_file_(ops_file)
+	PlayerList &player_list,
+	const std::string &name) : name_(name)
+							 , ops_file_(ops_file)
 							 , player_list_(player_list)
-							 , program_(program) {
+							 , program_(program)
+							 , log_ring_(MAX_LOG_CACHE)
+							 , log_arena_(new char[LOG_ARENA_BYTES])
+							 , lines_read_(MetricsRegistry::global().counter("dreamland_log_lines_total",
+								   "Lines read from the MC server output.", { { "server", name } })) {
 
 	// 加载 ops.json
 	load_ops();
+
+	MetricsRegistry &registry = MetricsRegistry::global();
+	const std::pair<Program::IOStreamType, const char *> streams[] = {
+		{ Program::IOStreamType::STDOUT, "stdout" },
+		{ Program::IOStreamType::STDERR, "stderr" }
+	};
+	for (const auto &stream : streams) {
+		Program::IOStreamType type = stream.first;
+		MetricLabels labels = { { "server", name }, { "stream", stream.second } };
+		metric_callbacks_.push_back(registry.add_callback(MetricsRegistry::Type::GAUGE, "dreamland_buffer_bytes",
+			"Bytes waiting in a child output buffer.", labels, [this, type] {
+				return static_cast<double>(program_->buffered_bytes(type));
+			}));
+		metric_callbacks_.push_back(registry.add_callback(MetricsRegistry::Type::COUNTER,
+			"dreamland_buffer_dropped_bytes_total", "Bytes discarded by a child output buffer's overflow policy.",
+			labels, [this, type] {
+				return static_cast<double>(program_->dropped_bytes(type));
+			}));
+	}
 }
 
 ServerManager::~ServerManager() {
 	stop();
+	for (MetricsRegistry::CallbackId id : metric_callbacks_) {
+		MetricsRegistry::global().remove_callback(id);
+	}
 }
 
 bool ServerManager::start() {
 	if (running_)
 		return false;
 
-	std::cout << "[ServerManager] 正在启动 MC 服务器..." << std::endl;
-
-	if (!program_->run()) {
-		std::cerr << "[ServerManager] 启动失败" << std::endl;
-		return false;
+	// MC 服务器可能已由调用方提前启动（与数据加载并行），这段时间的输出留在 Program 的缓冲区中
+	if (!program_->is_running()) {
+		log_info() << "[ServerManager] 正在启动 MC 服务器...";
+		if (!program_->run()) {
+			log_error() << "[ServerManager] 启动失败";
+			return false;
+		}
 	}
 
 	running_ = true;
@@ -66,7 +86,7 @@ bool ServerManager::start() {
 	stop_log_thread_ = false;
 	log_thread_ = std::thread(&ServerManager::log_reader_thread_func, this);
 
-	std::cout << "[ServerManager] MC 服务器已启动" << std::endl;
+	log_info() << "[ServerManager] MC 服务器已启动";
 	return true;
 }
 
@@ -74,10 +94,11 @@ void ServerManager::stop() {
 	if (!running_)
 		return;
 
-	std::cout << "[ServerManager] 正在停止 MC 服务器..." << std::endl;
+	log_info() << "[ServerManager] 正在停止 MC 服务器...";
 
 	// 停止日志线程
 	stop_log_thread_ = true;
+	program_->wake_output_waiters();
 	if (log_thread_.joinable()) {
 		log_thread_.join();
 	}
@@ -86,12 +107,12 @@ void ServerManager::stop() {
 	program_->stop();
 	running_ = false;
 
-	std::cout << "[ServerManager] MC 服务器已停止" << std::endl;
+	log_info() << "[ServerManager] MC 服务器已停止";
 }
 
 void ServerManager::execute_command(const std::string &command) {
 	if (!running_) {
-		std::cerr << "[ServerManager] 服务器未运行，无法执行命令" << std::endl;
+		log_warn() << "[ServerManager] 服务器未运行，无法执行命令";
 		return;
 	}
 
@@ -102,19 +123,38 @@ void ServerManager::execute_command(const std::string &command) {
 	}
 
 	program_->send_string(cmd + "\n");
-	std::cout << "[ServerManager] 执行命令: " << cmd << std::endl;
+	log_info() << "[ServerManager] 执行命令: " << cmd;
 }
 
-std::vector<ServerLogEntry> ServerManager::get_logs(size_t limit) const {
+size_t ServerManager::visit_logs_since(uint64_t since, size_t limit, const LogVisitor &visitor) const {
 	std::lock_guard<std::mutex> lock(log_mutex_);
 
-	if (limit == 0 || limit >= log_cache_.size()) {
-		return std::vector<ServerLogEntry>(log_cache_.begin(), log_cache_.end());
+	uint64_t last = last_log_seq_.load(std::memory_order_relaxed);
+	if (since >= last) {
+		return 0;
 	}
 
-	// 返回最新的 limit 条
-	auto start_it = log_cache_.end() - limit;
-	return std::vector<ServerLogEntry>(start_it, log_cache_.end());
+	uint64_t begin = std::max(since + 1, first_log_seq_);
+	if (limit != 0 && last - begin + 1 > limit) {
+		// 返回最新的 limit 条
+		begin = last - limit + 1;
+	}
+
+	for (uint64_t seq = begin; seq <= last; seq++) {
+		visitor(view_locked(seq));
+	}
+	return last - begin + 1;
+}
+
+LogView ServerManager::view_locked(uint64_t seq) const {
+	const ServerLogEntry &entry = log_ring_[seq % MAX_LOG_CACHE];
+	LogView view;
+	view.seq = seq;
+	view.type = entry.type;
+	view.time = entry.time;
+	view.player = player_list_.names().name(entry.player_id);
+	view.content = std::string_view(log_arena_.get() + entry.content_offset % LOG_ARENA_BYTES, entry.content_len);
+	return view;
 }
 
 std::vector<std::string> ServerManager::get_ops() const {
@@ -133,9 +173,13 @@ std::vector<OpInfo> ServerManager::get_ops_info() const {
 	return ops_;
 }
 
+void ServerManager::set_log_entry_callback(LogEntryCallback callback) {
+	log_entry_callback_ = std::move(callback);
+}
+
 void ServerManager::reload_ops() {
 	load_ops();
-	std::cout << "[ServerManager] 重新加载 ops.json，共 " << ops_.size() << " 个 OP" << std::endl;
+	log_info() << "[ServerManager] 重新加载 ops.json，共 " << ops_.size() << " 个 OP";
 }
 
 // ============================================================================
@@ -144,91 +188,105 @@ void ServerManager::reload_ops() {
 
 void ServerManager::log_reader_thread_func() {
 	while (!stop_log_thread_) {
-		if (!program_->is_running()) {
-			std::this_thread::sleep_for(std::chrono::milliseconds(100));
-			continue;
+		// 先记下输出序号再读取，避免在读取与等待之间漏掉通知
+		uint64_t seq = program_->output_sequence();
+
+		// 一次取出所有完整行，逐行处理
+		size_t count = program_->drain_lines([this](std::string_view line) {
+			handle_log_line(line);
+		});
+		lines_read_.inc(count);
+
+		if (count == 0) {
+			// 没有完整的行时阻塞等待 reactor 推送新输出，超时仅用于兜底
+			program_->wait_for_output(seq, std::chrono::seconds(1));
 		}
+	}
+}
 
-		// 读取一行日志
-		std::string line = program_->read_string(true, Program::IOStreamType::STDOUT);
-
-		if (line.empty()) {
-			std::this_thread::sleep_for(std::chrono::milliseconds(10));
-			continue;
-		}
-
-		// 处理日志行
-		auto event = player_list_.process_log_line(line);
-
-		// 创建日志条目
-		ServerLogEntry entry;
-		entry.time_point = event.timestamp;
-		entry.timestamp = get_current_time_string();
-
-		switch (event.type) {
-		case LogEventType::PLAYER_JOIN:
-			entry.type = "join";
-			entry.player = event.player_name;
-			entry.content = event.client_info;
-
-			std::cout << "[" << entry.timestamp << "] 玩家 [" << event.player_name
-					  << "] 加入了服务器，客户端为 [" << event.client_info << "]" << std::endl;
-
-			add_log_entry(entry);
-			break;
-
-		case LogEventType::PLAYER_LEAVE:
-			entry.type = "leave";
-			entry.player = event.player_name;
-			entry.content = "";
-
-			std::cout << "[" << entry.timestamp << "] 玩家 [" << event.player_name
-					  << "] 退出了服务器" << std::endl;
-
-			add_log_entry(entry);
-			break;
-
-		case LogEventType::PLAYER_COMMAND:
-			entry.type = "command";
-			entry.player = event.player_name;
-			entry.content = event.content;
-
-			std::cout << "[" << entry.timestamp << "] 玩家 [" << event.player_name
-					  << "] 执行了操作 [" << event.content << "]" << std::endl;
-
-			add_log_entry(entry);
-			break;
-
-		case LogEventType::PLAYER_CHAT:
-			entry.type = "chat";
-			entry.player = event.player_name;
-			entry.content = event.content;
+void ServerManager::handle_log_line(std::string_view line) {
+	// 处理日志行
+	auto event = player_list_.process_log_line(line, name_);
+
+	switch (event.type) {
+	case LogEventType::PLAYER_JOIN:
+		log_info() << "[" << current_time_string() << "] 玩家 [" << event.player_name
+				  << "] 加入了服务器，客户端为 [" << event.client_info << "]";
+		break;
+
+	case LogEventType::PLAYER_LEAVE:
+		log_info() << "[" << current_time_string() << "] 玩家 [" << event.player_name
+				  << "] 退出了服务器";
+		break;
+
+	case LogEventType::PLAYER_COMMAND:
+		log_info() << "[" << current_time_string() << "] 玩家 [" << event.player_name
+				  << "] 执行了操作 [" << event.content << "]";
+		break;
+
+	case LogEventType::PLAYER_CHAT:
+		log_info() << "[" << current_time_string() << "] <" << event.player_name << "> "
+				  << event.content;
+		break;
+
+	default:
+		// 其他类型的日志，直接输出但不缓存
+		Logger::global().passthrough(line);
+		return;
+	}
 
-			std::cout << "[" << entry.timestamp << "] <" << event.player_name << "> "
-					  << event.content << std::endl;
+	// 加入事件的正文为客户端信息，其他为指令或聊天内容
+	std::string_view content = event.type == LogEventType::PLAYER_JOIN ? event.client_info : event.content;
+	NameTable::Id player_id = player_list_.names().intern(event.player_name);
+	uint64_t seq = add_log_entry(event.type, event.timestamp, player_id, content);
 
-			add_log_entry(entry);
-			break;
+	// 环与正文区只由日志线程写入，释放锁后在本线程读取刚写入的条目是安全的
+	if (log_entry_callback_) {
+		log_entry_callback_(view_locked(seq));
+	}
+}
 
-		default:
-			// 其他类型的日志，直接输出但不缓存
-			if (!line.empty()) {
-				std::cout << line << std::endl;
-			}
-			break;
+uint64_t ServerManager::add_log_entry(LogEventType type, std::chrono::system_clock::time_point time,
+	NameTable::Id player_id, std::string_view content) {
+	if (content.size() > MAX_LOG_CONTENT) {
+		// 截断到完整的 UTF-8 字符
+		size_t len = MAX_LOG_CONTENT;
+		while (len > 0 && (static_cast<unsigned char>(content[len]) & 0xC0) == 0x80) {
+			len--;
 		}
+		content = content.substr(0, len);
 	}
-}
 
-void ServerManager::add_log_entry(const ServerLogEntry &entry) {
 	std::lock_guard<std::mutex> lock(log_mutex_);
 
-	log_cache_.push_back(entry);
-
-	// 限制缓存大小
-	if (log_cache_.size() > MAX_LOG_CACHE) {
-		log_cache_.pop_front();
+	// 正文不跨越正文区末尾，剩余空间不够时跳到开头
+	uint64_t pos = log_arena_end_ % LOG_ARENA_BYTES;
+	if (pos + content.size() > LOG_ARENA_BYTES) {
+		log_arena_end_ += LOG_ARENA_BYTES - pos;
+		pos = 0;
+	}
+	std::memcpy(log_arena_.get() + pos, content.data(), content.size());
+
+	// 覆盖环中最旧的一条，缓存大小固定为 MAX_LOG_CACHE
+	uint64_t seq = last_log_seq_.load(std::memory_order_relaxed) + 1;
+	ServerLogEntry &entry = log_ring_[seq % MAX_LOG_CACHE];
+	entry.time = time;
+	entry.content_offset = log_arena_end_;
+	entry.content_len = static_cast<uint32_t>(content.size());
+	entry.player_id = player_id;
+	entry.type = type;
+	log_arena_end_ += content.size();
+	last_log_seq_.store(seq);
+
+	// 丢弃被环覆盖或正文已被覆盖的最早条目，正文偏移随序号递增，只需从头检查
+	if (seq >= MAX_LOG_CACHE) {
+		first_log_seq_ = std::max(first_log_seq_, seq - MAX_LOG_CACHE + 1);
+	}
+	while (first_log_seq_ < seq
+		&& log_ring_[first_log_seq_ % MAX_LOG_CACHE].content_offset + LOG_ARENA_BYTES < log_arena_end_) {
+		first_log_seq_++;
 	}
+	return seq;
 }
 
 // ============================================================================
@@ -236,94 +294,87 @@ void ServerManager::add_log_entry(const ServerLogEntry &entry) {
 // ============================================================================
 
 void ServerManager::load_ops() {
-	std::ifstream file(ops_file_);
-	if (!file) {
-		std::cerr << "[ServerManager] 无法打开 ops.json: " << ops_file_ << std::endl;
+	MappedFile file;
+	if (!file.open(ops_file_)) {
+		log_warn() << "[ServerManager] 无法打开 ops.json: " << ops_file_;
 		return;
 	}
 
-	std::ostringstream oss;
-	oss << file.rdbuf();
-	std::string json_content = oss.str();
-
-	std::lock_guard<std::mutex> lock(ops_mutex_);
-	ops_ = parse_ops_json(json_content);
+	// 在映射上直接解析，锁内只做交换
+	std::vector<OpInfo> ops = parse_ops_json(file.view());
+	size_t count = ops.size();
+	{
+		std::lock_guard<std::mutex> lock(ops_mutex_);
+		ops_ = std::move(ops);
+		ops_generation_++;
+	}
 
-	std::cout << "[ServerManager] 加载了 " << ops_.size() << " 个 OP" << std::endl;
+	log_info() << "[ServerManager] 加载了 " << count << " 个 OP";
 }
 
-std::vector<OpInfo> ServerManager::parse_ops_json(const std::string &json_content) {
-	std::vector<OpInfo> result;
+// 取出 obj 中 "key": "value" 的字符串值，不存在时返回空
+static std::string_view find_string_field(std::string_view obj, std::string_view key) {
+	size_t key_pos = obj.find(key);
+	if (key_pos == std::string_view::npos)
+		return std::string_view();
+	size_t start = obj.find('"', key_pos + key.size());
+	if (start == std::string_view::npos)
+		return std::string_view();
+	size_t end = obj.find('"', start + 1);
+	if (end == std::string_view::npos)
+		return std::string_view();
+	return obj.substr(start + 1, end - start - 1);
+}
 
+std::vector<OpInfo> ServerManager::parse_ops_json(std::string_view json_content) {
 	// 简单的 JSON 解析（仅适用于 ops.json 格式）
 	// 格式: [{"uuid":"...", "name":"...", "level":4, "bypassesPlayerLimit":false}, ...]
 
+	// 每个 OP 一个对象，按左花括号的个数预留
+	std::vector<OpInfo> result;
+	result.reserve(static_cast<size_t>(std::count(json_content.begin(), json_content.end(), '{')));
+
 	size_t pos = 0;
 	while (true) {
 		// 查找下一个对象
-		pos = json_content.find("{", pos);
-		if (pos == std::string::npos)
+		pos = json_content.find('{', pos);
+		if (pos == std::string_view::npos)
 			break;
 
-		size_t end = json_content.find("}", pos);
-		if (end == std::string::npos)
+		size_t end = json_content.find('}', pos);
+		if (end == std::string_view::npos)
 			break;
 
-		std::string obj = json_content.substr(pos, end - pos + 1);
+		std::string_view obj = json_content.substr(pos, end - pos + 1);
 
 		OpInfo info;
+		info.uuid = std::string(find_string_field(obj, "\"uuid\""));
+		info.name = std::string(find_string_field(obj, "\"name\""));
 
-		// 提取 uuid
-		size_t uuid_pos = obj.find("\"uuid\"");
-		if (uuid_pos != std::string::npos) {
-			size_t start = obj.find("\"", uuid_pos + 6);
-			size_t end_pos = obj.find("\"", start + 1);
-			if (start != std::string::npos && end_pos != std::string::npos) {
-				info.uuid = obj.substr(start + 1, end_pos - start - 1);
-			}
-		}
-
-		// 提取 name
-		size_t name_pos = obj.find("\"name\"");
-		if (name_pos != std::string::npos) {
-			size_t start = obj.find("\"", name_pos + 6);
-			size_t end_pos = obj.find("\"", start + 1);
-			if (start != std::string::npos && end_pos != std::string::npos) {
-				info.name = obj.substr(start + 1, end_pos - start - 1);
-			}
-		}
-
-		// 提取 level
+		// 提取 level：冒号之后的第一串数字
 		size_t level_pos = obj.find("\"level\"");
-		if (level_pos != std::string::npos) {
-			size_t colon = obj.find(":", level_pos);
-			if (colon != std::string::npos) {
-				std::string level_str;
-				for (size_t i = colon + 1; i < obj.size(); ++i) {
-					if (isdigit(obj[i])) {
-						level_str += obj[i];
-					} else if (!level_str.empty()) {
-						break;
-					}
-				}
-				if (!level_str.empty()) {
-					info.level = std::stoi(level_str);
+		if (level_pos != std::string_view::npos) {
+			size_t colon = obj.find(':', level_pos);
+			if (colon != std::string_view::npos) {
+				size_t digits = obj.find_first_of("0123456789", colon + 1);
+				if (digits != std::string_view::npos) {
+					std::from_chars(obj.data() + digits, obj.data() + obj.size(), info.level);
 				}
 			}
 		}
 
 		// 提取 bypassesPlayerLimit
 		size_t bypass_pos = obj.find("\"bypassesPlayerLimit\"");
-		if (bypass_pos != std::string::npos) {
+		if (bypass_pos != std::string_view::npos) {
 			size_t true_pos = obj.find("true", bypass_pos);
 			size_t false_pos = obj.find("false", bypass_pos);
-			if (true_pos != std::string::npos && (false_pos == std::string::npos || true_pos < false_pos)) {
+			if (true_pos != std::string_view::npos && (false_pos == std::string_view::npos || true_pos < false_pos)) {
 				info.bypasses_player_limit = true;
 			}
 		}
 
 		if (!info.name.empty()) {
-			result.push_back(info);
+			result.push_back(std::move(info));
 		}
 
 		pos = end + 1;
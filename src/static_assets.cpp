@@ -0,0 +1,259 @@
+#include <static_assets.h>
+#include <algorithm>
+#include <cstdint>
+#include <dirent.h>
+#include <fstream>
+#include <logger.h>
+#include <poll.h>
+#include <sstream>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#include <zlib.h>
+
+#ifdef DL_WITH_BROTLI
+#include <brotli/encode.h>
+#endif
+
+namespace dl {
+
+// ============================================================================
+// 辅助函数
+// ============================================================================
+
+std::string mime_type_for(const std::string &path) {
+	size_t pos = path.rfind('.');
+	std::string ext = pos == std::string::npos ? "" : path.substr(pos);
+	if (ext == ".html" || ext == ".htm") return "text/html; charset=utf-8";
+	if (ext == ".css") return "text/css; charset=utf-8";
+	if (ext == ".js") return "application/javascript; charset=utf-8";
+	if (ext == ".json") return "application/json; charset=utf-8";
+	if (ext == ".png") return "image/png";
+	if (ext == ".jpg" || ext == ".jpeg") return "image/jpeg";
+	if (ext == ".gif") return "image/gif";
+	if (ext == ".svg") return "image/svg+xml";
+	if (ext == ".ico") return "image/x-icon";
+	return "application/octet-stream";
+}
+
+// 已压缩格式（图片等）再压缩没有收益
+static bool is_compressible(const std::string &content_type) {
+	return content_type.compare(0, 5, "text/") == 0
+		|| content_type.find("javascript") != std::string::npos
+		|| content_type.find("json") != std::string::npos
+		|| content_type.find("svg") != std::string::npos
+		|| content_type == "image/x-icon";
+}
+
+// HTML 每次都重新验证，其余资源允许浏览器缓存一段时间
+static std::string cache_control_for(const std::string &content_type) {
+	if (content_type.compare(0, 5, "text/") == 0 || content_type.find("javascript") != std::string::npos) {
+		return "no-cache";
+	}
+	return "public, max-age=86400";
+}
+
+static std::string make_etag(const std::string &content) {
+	// FNV-1a 64
+	uint64_t hash = 14695981039346656037ULL;
+	for (unsigned char c : content) {
+		hash ^= c;
+		hash *= 1099511628211ULL;
+	}
+	std::ostringstream oss;
+	oss << '"' << std::hex << hash << '-' << content.size() << '"';
+	return oss.str();
+}
+
+static std::string gzip_compress(const std::string &data) {
+	z_stream zs {};
+	if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+		return "";
+	}
+
+	std::string out;
+	out.resize(deflateBound(&zs, data.size()));
+	zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+	zs.avail_in = static_cast<uInt>(data.size());
+	zs.next_out = reinterpret_cast<Bytef *>(&out[0]);
+	zs.avail_out = static_cast<uInt>(out.size());
+
+	int ret = deflate(&zs, Z_FINISH);
+	out.resize(zs.total_out);
+	deflateEnd(&zs);
+	return ret == Z_STREAM_END ? out : "";
+}
+
+static std::string brotli_compress(const std::string &data) {
+#ifdef DL_WITH_BROTLI
+	std::string out;
+	size_t out_size = BrotliEncoderMaxCompressedSize(data.size());
+	if (out_size == 0) {
+		return "";
+	}
+	out.resize(out_size);
+	if (!BrotliEncoderCompress(BROTLI_MAX_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT,
+			data.size(), reinterpret_cast<const uint8_t *>(data.data()),
+			&out_size, reinterpret_cast<uint8_t *>(&out[0]))) {
+		return "";
+	}
+	out.resize(out_size);
+	return out;
+#else
+	(void)data;
+	return "";
+#endif
+}
+
+static bool read_file(const std::string &path, std::string &out) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		return false;
+	}
+	std::ostringstream oss;
+	oss << file.rdbuf();
+	out = oss.str();
+	return true;
+}
+
+// ============================================================================
+// StaticAssetTable 实现
+// ============================================================================
+
+StaticAssetTable::StaticAssetTable(const std::string &root) : root_(root)
+															, table_(std::make_shared<Table>()) {
+}
+
+StaticAssetTable::~StaticAssetTable() {
+	stop_watching();
+}
+
+bool StaticAssetTable::has_brotli() {
+#ifdef DL_WITH_BROTLI
+	return true;
+#else
+	return false;
+#endif
+}
+
+size_t StaticAssetTable::reload() {
+	auto table = std::make_shared<Table>();
+
+	DIR *dir = opendir(root_.c_str());
+	if (!dir) {
+		log_error() << "[StaticAssets] 无法打开目录: " << root_;
+		std::atomic_store(&table_, std::shared_ptr<const Table>(std::move(table)));
+		return 0;
+	}
+
+	size_t raw_bytes = 0;
+	size_t sent_bytes = 0;
+	while (dirent *entry = readdir(dir)) {
+		std::string name = entry->d_name;
+		if (name.empty() || name[0] == '.') {
+			continue;
+		}
+
+		std::string path = root_ + "/" + name;
+		struct stat st {};
+		if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+			continue;
+		}
+
+		auto asset = std::make_shared<StaticAsset>();
+		if (!read_file(path, asset->identity)) {
+			continue;
+		}
+		asset->content_type = mime_type_for(name);
+		asset->cache_control = cache_control_for(asset->content_type);
+		asset->etag = make_etag(asset->identity);
+
+		// 只保留确实更小的压缩版本
+		if (is_compressible(asset->content_type)) {
+			asset->gzip = gzip_compress(asset->identity);
+			if (asset->gzip.size() >= asset->identity.size()) {
+				asset->gzip.clear();
+			}
+			asset->brotli = brotli_compress(asset->identity);
+			if (asset->brotli.size() >= asset->identity.size()) {
+				asset->brotli.clear();
+			}
+		}
+
+		raw_bytes += asset->identity.size();
+		size_t best = asset->identity.size();
+		if (!asset->gzip.empty()) best = std::min(best, asset->gzip.size());
+		if (!asset->brotli.empty()) best = std::min(best, asset->brotli.size());
+		sent_bytes += best;
+
+		(*table)["/" + name] = std::move(asset);
+	}
+	closedir(dir);
+
+	size_t count = table->size();
+	std::atomic_store(&table_, std::shared_ptr<const Table>(std::move(table)));
+	log_info() << "[StaticAssets] 加载 " << count << " 个文件，" << raw_bytes
+			  << " 字节（压缩后 " << sent_bytes << " 字节）";
+	return count;
+}
+
+std::shared_ptr<const StaticAsset> StaticAssetTable::find(std::string_view url_path) const {
+	auto table = std::atomic_load(&table_);
+	auto it = table->find(std::string(url_path));
+	if (it == table->end()) {
+		return nullptr;
+	}
+	return it->second;
+}
+
+bool StaticAssetTable::start_watching() {
+	if (watch_thread_.joinable()) {
+		return true;
+	}
+
+	int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd == -1) {
+		return false;
+	}
+	if (inotify_add_watch(fd, root_.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE) == -1) {
+		close(fd);
+		return false;
+	}
+
+	stop_watch_ = false;
+	watch_thread_ = std::thread(&StaticAssetTable::watch_thread_func, this, fd);
+	return true;
+}
+
+void StaticAssetTable::stop_watching() {
+	stop_watch_ = true;
+	if (watch_thread_.joinable()) {
+		watch_thread_.join();
+	}
+}
+
+void StaticAssetTable::watch_thread_func(int inotify_fd) {
+	char events[4096];
+	bool dirty = false;
+
+	while (!stop_watch_) {
+		pollfd pfd { inotify_fd, POLLIN, 0 };
+		// 有未处理的变化时只等一小段时间，把编辑器保存时的一连串事件合并成一次重新加载
+		int ret = poll(&pfd, 1, dirty ? 200 : 500);
+		if (ret > 0) {
+			while (read(inotify_fd, events, sizeof(events)) > 0) {
+			}
+			dirty = true;
+			continue;
+		}
+		if (ret == 0 && dirty) {
+			dirty = false;
+			reload();
+		}
+	}
+
+	close(inotify_fd);
+}
+
+} // namespace dl
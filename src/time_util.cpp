@@ -0,0 +1,206 @@
+#include <cstring>
+#include <ctime>
+#include <time_util.h>
+
+namespace dl {
+
+// ============================================================================
+// 辅助函数
+// ============================================================================
+
+namespace {
+
+constexpr time_t SECONDS_PER_DAY = 24 * 60 * 60;
+
+// 一个本地日期的缓存
+struct DayCache {
+	bool valid = false; // [begin, end) 内 UTC 偏移不变，可以直接由秒数推算时分秒
+	time_t begin = 0; // 当天零点
+	time_t end = 0; // 次日零点
+	char prefix[11] = {}; // "YYYY-MM-DD "
+};
+
+// 最近一次格式化的秒
+struct SecondCache {
+	bool valid = false;
+	time_t second = 0;
+	char text[TIME_STRING_LENGTH] = {};
+};
+
+thread_local DayCache day_cache;
+thread_local SecondCache second_cache;
+
+void write2(char *p, int v) {
+	p[0] = static_cast<char>('0' + v / 10);
+	p[1] = static_cast<char>('0' + v % 10);
+}
+
+// "YYYY-MM-DD"
+void write_date(char *p, const std::tm &tm) {
+	int year = tm.tm_year + 1900;
+	if (year < 0 || year > 9999) {
+		year = 0;
+	}
+	write2(p, year / 100);
+	write2(p + 2, year % 100);
+	p[4] = '-';
+	write2(p + 5, tm.tm_mon + 1);
+	p[7] = '-';
+	write2(p + 8, tm.tm_mday);
+}
+
+// "HH:MM:SS"
+void write_clock(char *p, int hour, int minute, int second) {
+	write2(p, hour);
+	p[2] = ':';
+	write2(p + 3, minute);
+	p[5] = ':';
+	write2(p + 6, second);
+}
+
+bool same_date(const std::tm &a, const std::tm &b) {
+	return a.tm_year == b.tm_year && a.tm_mon == b.tm_mon && a.tm_mday == b.tm_mday;
+}
+
+// 让 day_cache 指向 t 所在的本地日期，返回 t 能否走快速路径
+// 只有当天零点到 23:59:59 的 UTC 偏移不变（没有夏令时切换）时才缓存
+bool refresh_day(time_t t) {
+	if (day_cache.valid && t >= day_cache.begin && t < day_cache.end) {
+		return true;
+	}
+
+	std::tm tm {};
+	if (!localtime_r(&t, &tm)) {
+		return false;
+	}
+	time_t begin = t - (tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec);
+	time_t last = begin + SECONDS_PER_DAY - 1;
+
+	std::tm first_tm {};
+	std::tm last_tm {};
+	if (!localtime_r(&begin, &first_tm) || !localtime_r(&last, &last_tm)) {
+		return false;
+	}
+	bool uniform = same_date(first_tm, tm) && same_date(last_tm, tm)
+		&& first_tm.tm_hour == 0 && first_tm.tm_min == 0 && first_tm.tm_sec == 0
+		&& last_tm.tm_hour == 23 && last_tm.tm_min == 59 && last_tm.tm_sec == 59
+		&& first_tm.tm_gmtoff == last_tm.tm_gmtoff;
+	if (!uniform) {
+		return false;
+	}
+
+	day_cache.valid = true;
+	day_cache.begin = begin;
+	day_cache.end = last + 1;
+	write_date(day_cache.prefix, tm);
+	day_cache.prefix[10] = ' ';
+	return true;
+}
+
+// 解析固定宽度的十进制数字
+bool parse_digits(std::string_view s, size_t pos, size_t len, int &out) {
+	out = 0;
+	for (size_t i = pos; i < pos + len; i++) {
+		if (s[i] < '0' || s[i] > '9') {
+			return false;
+		}
+		out = out * 10 + (s[i] - '0');
+	}
+	return true;
+}
+
+} // namespace
+
+// ============================================================================
+// 格式化与解析
+// ============================================================================
+
+size_t format_local_time(std::chrono::system_clock::time_point tp, char *out) {
+	time_t t = std::chrono::system_clock::to_time_t(tp);
+	if (second_cache.valid && second_cache.second == t) {
+		std::memcpy(out, second_cache.text, TIME_STRING_LENGTH);
+		return TIME_STRING_LENGTH;
+	}
+
+	if (refresh_day(t)) {
+		int seconds = static_cast<int>(t - day_cache.begin);
+		std::memcpy(out, day_cache.prefix, sizeof(day_cache.prefix));
+		write_clock(out + 11, seconds / 3600, seconds / 60 % 60, seconds % 60);
+	} else {
+		std::tm tm {};
+		if (!localtime_r(&t, &tm)) {
+			std::memcpy(out, "0000-00-00 00:00:00", TIME_STRING_LENGTH);
+			return TIME_STRING_LENGTH;
+		}
+		write_date(out, tm);
+		out[10] = ' ';
+		write_clock(out + 11, tm.tm_hour, tm.tm_min, tm.tm_sec);
+	}
+
+	second_cache.valid = true;
+	second_cache.second = t;
+	std::memcpy(second_cache.text, out, TIME_STRING_LENGTH);
+	return TIME_STRING_LENGTH;
+}
+
+std::string format_local_time(std::chrono::system_clock::time_point tp) {
+	char buf[TIME_STRING_LENGTH];
+	return std::string(buf, format_local_time(tp, buf));
+}
+
+std::string current_time_string() {
+	return format_local_time(std::chrono::system_clock::now());
+}
+
+bool parse_local_time(std::string_view s, std::chrono::system_clock::time_point &out) {
+	if (s.size() < TIME_STRING_LENGTH || s[4] != '-' || s[7] != '-' || s[10] != ' '
+		|| s[13] != ':' || s[16] != ':') {
+		return false;
+	}
+	int year, month, day, hour, minute, second;
+	if (!parse_digits(s, 0, 4, year) || !parse_digits(s, 5, 2, month) || !parse_digits(s, 8, 2, day)
+		|| !parse_digits(s, 11, 2, hour) || !parse_digits(s, 14, 2, minute) || !parse_digits(s, 17, 2, second)) {
+		return false;
+	}
+	if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60) {
+		return false;
+	}
+
+	// 与缓存的日期相同时直接由当天零点推算
+	if (day_cache.valid && std::memcmp(s.data(), day_cache.prefix, 10) == 0) {
+		out = std::chrono::system_clock::from_time_t(day_cache.begin + hour * 3600 + minute * 60 + second);
+		return true;
+	}
+
+	std::tm tm {};
+	tm.tm_year = year - 1900;
+	tm.tm_mon = month - 1;
+	tm.tm_mday = day;
+	tm.tm_hour = hour;
+	tm.tm_min = minute;
+	tm.tm_sec = second;
+	tm.tm_isdst = -1;
+	time_t t = mktime(&tm);
+	out = std::chrono::system_clock::from_time_t(t);
+
+	// 文件中的记录往往集中在少数几天，缓存这一天供后续解析
+	refresh_day(t);
+	return true;
+}
+
+std::chrono::system_clock::time_point local_time_today(int hour, int minute, int second) {
+	time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+	if (refresh_day(now)) {
+		return std::chrono::system_clock::from_time_t(day_cache.begin + hour * 3600 + minute * 60 + second);
+	}
+
+	std::tm tm {};
+	localtime_r(&now, &tm);
+	tm.tm_hour = hour;
+	tm.tm_min = minute;
+	tm.tm_sec = second;
+	tm.tm_isdst = -1;
+	return std::chrono::system_clock::from_time_t(mktime(&tm));
+}
+
+} // namespace dl
@@ -0,0 +1,83 @@
+#include <timer_queue.h>
+
+namespace dl {
+
+TimerQueue::TimerQueue() {
+	thread_ = std::thread(&TimerQueue::thread_func, this);
+}
+
+TimerQueue::~TimerQueue() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+	}
+	cv_.notify_all();
+	if (thread_.joinable()) {
+		thread_.join();
+	}
+}
+
+TimerQueue::TimerId TimerQueue::schedule_at(Clock::time_point when, Task task) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	TimerId id = next_id_++;
+	tasks_.emplace(id, std::move(task));
+	// 只有新定时器成为最早到期的一个时才需要唤醒
+	bool earliest = heap_.empty() || when < heap_.top().first;
+	heap_.emplace(when, id);
+	if (earliest) {
+		cv_.notify_one();
+	}
+	return id;
+}
+
+bool TimerQueue::cancel(TimerId id) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return tasks_.erase(id) > 0;
+}
+
+void TimerQueue::wait_idle() {
+	std::unique_lock<std::mutex> lock(mutex_);
+	idle_cv_.wait(lock, [this] {
+		return !running_task_;
+	});
+}
+
+size_t TimerQueue::size() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return tasks_.size();
+}
+
+void TimerQueue::thread_func() {
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (!stop_) {
+		// 丢弃已取消的过时条目
+		while (!heap_.empty() && tasks_.count(heap_.top().second) == 0) {
+			heap_.pop();
+		}
+
+		if (heap_.empty()) {
+			cv_.wait(lock);
+			continue;
+		}
+
+		Entry top = heap_.top();
+		if (Clock::now() < top.first) {
+			cv_.wait_until(lock, top.first);
+			continue;
+		}
+
+		heap_.pop();
+		auto it = tasks_.find(top.second);
+		Task task = std::move(it->second);
+		tasks_.erase(it);
+
+		running_task_ = true;
+		lock.unlock();
+		task();
+		lock.lock();
+		running_task_ = false;
+		idle_cv_.notify_all();
+	}
+}
+
+} // namespace dl
@@ -2,15 +2,20 @@
 #include <web_server.h>
 #include <player_list.h>
 #include <command_request.h>
+#include <json_writer.h>
+#include <logger.h>
+#include <time_util.h>
 
 #include <httplib.h>
 
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
 #include <chrono>
-#include <ctime>
-#include <fstream>
-#include <iomanip>
-#include <iostream>
+#include <cstdlib>
 #include <sstream>
+#include <unistd.h>
+#include <unordered_map>
 
 namespace dl {
 
@@ -25,33 +30,102 @@ static std::string trim(const std::string& s) {
     return s.substr(start, end - start + 1);
 }
 
-static std::string get_current_time_string() {
-    auto now = std::chrono::system_clock::now();
-    auto t = std::chrono::system_clock::to_time_t(now);
-    std::tm tm{};
-    localtime_r(&t, &tm);
-    std::ostringstream oss;
-    oss << std::put_time(&tm, "%Y-%m-%d %H:%M:%S");
-    return oss.str();
-}
-
 static std::string get_file_extension(const std::string& filename) {
     size_t pos = filename.rfind('.');
     if (pos == std::string::npos) return "";
     return filename.substr(pos);
 }
 
-static std::string get_mime_type(const std::string& ext) {
-    if (ext == ".html" || ext == ".htm") return "text/html; charset=utf-8";
-    if (ext == ".css") return "text/css; charset=utf-8";
-    if (ext == ".js") return "application/javascript; charset=utf-8";
-    if (ext == ".json") return "application/json; charset=utf-8";
-    if (ext == ".png") return "image/png";
-    if (ext == ".jpg" || ext == ".jpeg") return "image/jpeg";
-    if (ext == ".gif") return "image/gif";
-    if (ext == ".svg") return "image/svg+xml";
-    if (ext == ".ico") return "image/x-icon";
-    return "application/octet-stream";
+// 根据上传文件名或 Content-Type 确定图片扩展名，扩展名只允许字母数字
+static std::string image_extension(const std::string& filename, const std::string& content_type) {
+    std::string ext = get_file_extension(filename);
+    bool valid = ext.size() > 1 && ext.size() <= 8;
+    for (size_t i = 1; valid && i < ext.size(); i++) {
+        valid = std::isalnum(static_cast<unsigned char>(ext[i])) != 0;
+    }
+    if (valid) return ext;
+    
+    if (content_type.find("png") != std::string::npos) return ".png";
+    if (content_type.find("jpeg") != std::string::npos || content_type.find("jpg") != std::string::npos) return ".jpg";
+    if (content_type.find("gif") != std::string::npos) return ".gif";
+    return ".png";
+}
+
+// 上传临时目录中的临时文件，未被取走时析构自动删除
+class TempUpload {
+public:
+    ~TempUpload() {
+        if (fd_ != -1) close(fd_);
+        if (!path_.empty()) unlink(path_.c_str());
+    }
+    
+    bool open(const std::string& dir) {
+        std::string tmpl = dir + "/.upload-XXXXXX";
+        fd_ = mkstemp(&tmpl[0]);
+        if (fd_ == -1) return false;
+        path_ = tmpl;
+        return true;
+    }
+    
+    bool write(const char* data, size_t len) {
+        while (len > 0) {
+            ssize_t n = ::write(fd_, data, len);
+            if (n == -1) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            data += n;
+            len -= static_cast<size_t>(n);
+            size_ += static_cast<size_t>(n);
+        }
+        return true;
+    }
+    
+    bool is_open() const { return fd_ != -1; }
+    size_t size() const { return size_; }
+    
+    // 关闭文件并交出路径，之后由调用方负责（重命名或删除）
+    std::string release() {
+        if (fd_ != -1) close(fd_);
+        fd_ = -1;
+        std::string path = std::move(path_);
+        path_.clear();
+        return path;
+    }
+    
+private:
+    std::string path_;
+    int fd_ = -1;
+    size_t size_ = 0;
+};
+
+// Accept-Encoding 中是否接受 encoding（忽略 q=0）
+static bool accepts_encoding(const std::string& accept_encoding, const std::string& encoding) {
+    size_t pos = 0;
+    while (pos < accept_encoding.size()) {
+        size_t end = accept_encoding.find(',', pos);
+        if (end == std::string::npos) end = accept_encoding.size();
+        std::string item = trim(accept_encoding.substr(pos, end - pos));
+        pos = end + 1;
+        
+        size_t semi = item.find(';');
+        std::string token = trim(item.substr(0, semi));
+        if (token != encoding && token != "*") continue;
+        if (semi != std::string::npos) {
+            std::string params = item.substr(semi + 1);
+            size_t q = params.find("q=");
+            if (q != std::string::npos && std::strtod(params.c_str() + q + 2, nullptr) <= 0) continue;
+        }
+        return true;
+    }
+    return false;
+}
+
+// If-None-Match 可能是 "*"、单个 ETag 或逗号分隔的列表（可带 W/ 前缀）
+static bool etag_matches(const std::string& if_none_match, const std::string& etag) {
+    if (if_none_match.empty()) return false;
+    if (trim(if_none_match) == "*") return true;
+    return if_none_match.find(etag) != std::string::npos;
 }
 
 // ============================================================================
@@ -64,21 +138,99 @@ WebServer::WebServer(const WebServerConfig& config,
     : config_(config)
     , player_list_(player_list)
     , request_manager_(request_manager)
-    , server_(std::make_unique<httplib::Server>()) {
+    , server_(std::make_unique<httplib::Server>())
+    , event_hub_(config.max_stream_clients, MAX_STREAM_QUEUE)
+    , vote_limiter_(config.vote_rate_per_minute, config.vote_rate_burst)
+    , assets_(config.web_root) {
+    
+    // 推送连接长期占用工作线程，至少留出两个线程处理普通请求
+    config_.worker_threads = std::max(config_.worker_threads, config_.max_stream_clients + 2);
+    
+    auto boot = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    std::ostringstream prefix;
+    prefix << std::hex << boot;
+    etag_prefix_ = prefix.str();
+    
+    // 静态资源启动时一次性载入内存
+    assets_.reload();
+    if (config_.watch_web_root && !assets_.start_watching()) {
+        log_warn() << "[WebServer] 无法监控静态文件目录: " << config_.web_root;
+    }
     
     setup_routes();
+    register_metrics();
 }
 
 WebServer::~WebServer() {
     stop();
+    for (MetricsRegistry::CallbackId id : metric_callbacks_) {
+        MetricsRegistry::global().remove_callback(id);
+    }
+}
+
+void WebServer::register_metrics() {
+    MetricsRegistry& registry = MetricsRegistry::global();
+    auto gauge = [this, &registry](const char* name, const char* help, std::function<double()> value) {
+        metric_callbacks_.push_back(registry.add_callback(MetricsRegistry::Type::GAUGE, name, help, {}, std::move(value)));
+    };
+    auto counter = [this, &registry](const char* name, const char* help, std::function<double()> value) {
+        metric_callbacks_.push_back(registry.add_callback(MetricsRegistry::Type::COUNTER, name, help, {}, std::move(value)));
+    };
+    auto setting = [&gauge](const char* name, const char* help, double value) {
+        gauge(name, help, [value] { return value; });
+    };
+    
+    // 线程池与连接配置
+    setting("dreamland_http_worker_threads", "Configured HTTP worker threads.",
+            static_cast<double>(config_.worker_threads));
+    setting("dreamland_http_max_queued_connections", "Connections allowed to wait for a worker (0 = unbounded).",
+            static_cast<double>(config_.max_queued_connections));
+    setting("dreamland_http_keep_alive_max_count", "Requests served per keep-alive connection.",
+            static_cast<double>(config_.keep_alive_max_count));
+    setting("dreamland_http_keep_alive_timeout_seconds", "Idle time before a keep-alive connection is closed.",
+            config_.keep_alive_timeout_sec);
+    setting("dreamland_http_read_timeout_seconds", "Request read timeout.", config_.read_timeout_sec);
+    setting("dreamland_http_write_timeout_seconds", "Response write timeout.", config_.write_timeout_sec);
+    setting("dreamland_http_max_stream_clients", "Maximum /api/stream clients.",
+            static_cast<double>(config_.max_stream_clients));
+    setting("dreamland_vote_rate_per_minute", "Votes per minute allowed per IP (0 = unlimited).",
+            vote_limiter_.per_minute());
+    setting("dreamland_vote_rate_burst", "Consecutive votes allowed per IP.", vote_limiter_.burst());
+    
+    // 运行状态
+    gauge("dreamland_http_workers_running", "HTTP worker threads currently running.", [this] {
+        return static_cast<double>(worker_stats_.threads.load());
+    });
+    gauge("dreamland_http_workers_active", "HTTP workers currently serving a connection.", [this] {
+        return static_cast<double>(worker_stats_.active.load());
+    });
+    gauge("dreamland_http_connections_queued", "Connections waiting for a worker.", [this] {
+        return static_cast<double>(worker_stats_.queued.load());
+    });
+    counter("dreamland_http_connections_completed_total", "Connections served to completion.", [this] {
+        return static_cast<double>(worker_stats_.completed.load());
+    });
+    counter("dreamland_http_connections_rejected_total", "Connections closed because the queue was full.", [this] {
+        return static_cast<double>(worker_stats_.rejected.load());
+    });
+    gauge("dreamland_http_stream_clients", "Connected /api/stream clients.", [this] {
+        return static_cast<double>(event_hub_.subscriber_count());
+    });
+    gauge("dreamland_vote_rate_tracked_ips", "IPs with a partially drained vote bucket.", [this] {
+        return static_cast<double>(vote_limiter_.tracked());
+    });
+    counter("dreamland_vote_rate_limited_total", "Votes rejected with 429.", [this] {
+        return static_cast<double>(vote_limiter_.rejected());
+    });
 }
 
 void WebServer::set_get_logs_callback(GetLogsCallback callback) {
-    get_logs_callback_ = std::move(callback);
+    default_server_.endpoints.get_logs = std::move(callback);
 }
 
 void WebServer::set_get_ops_callback(GetOpsCallback callback) {
-    get_ops_callback_ = std::move(callback);
+    default_server_.endpoints.get_ops = std::move(callback);
 }
 
 void WebServer::set_execute_command_callback(ExecuteCommandCallback callback) {
@@ -89,14 +241,33 @@ void WebServer::set_player_exists_callback(PlayerExistsCallback callback) {
     player_exists_callback_ = std::move(callback);
 }
 
+void WebServer::set_history_callback(HistoryCallback callback) {
+    history_callback_ = std::move(callback);
+}
+
+void WebServer::add_server(const std::string& name, ServerEndpoints endpoints) {
+    auto route = std::make_unique<ServerRoute>();
+    route->name = name;
+    route->endpoints = std::move(endpoints);
+    servers_.push_back(std::move(route));
+}
+
+void WebServer::set_logs_generation_callback(GenerationCallback callback) {
+    default_server_.endpoints.logs_generation = std::move(callback);
+}
+
+void WebServer::set_ops_generation_callback(GenerationCallback callback) {
+    default_server_.endpoints.ops_generation = std::move(callback);
+}
+
 bool WebServer::start() {
     if (running_) return false;
     
     running_ = true;
     server_thread_ = std::thread([this]() {
-        std::cout << "[WebServer] 启动在端口 " << config_.port << std::endl;
+        log_info() << "[WebServer] 启动在端口 " << config_.port;
         if (!server_->listen("0.0.0.0", config_.port)) {
-            std::cerr << "[WebServer] 启动失败" << std::endl;
+            log_error() << "[WebServer] 启动失败";
             running_ = false;
         }
     });
@@ -111,30 +282,75 @@ void WebServer::stop() {
     if (!running_) return;
     
     running_ = false;
+    // 先断开所有推送连接，否则工作线程会阻塞在等待事件上
+    event_hub_.close();
     server_->stop();
     
     if (server_thread_.joinable()) {
         server_thread_.join();
     }
     
-    std::cout << "[WebServer] 已停止" << std::endl;
+    log_info() << "[WebServer] 已停止";
 }
 
 void WebServer::add_system_log(const std::string& message) {
     std::lock_guard<std::mutex> lock(system_logs_mutex_);
     
-    LogEntry entry;
-    entry.timestamp = get_current_time_string();
-    entry.type = "system";
-    entry.player = "";
-    entry.content = message;
+    SystemLogEntry entry;
+    entry.seq = system_logs_generation_.load() + 1;
+    entry.time = std::chrono::system_clock::now();
+    entry.message = message;
     
-    system_logs_.push_back(entry);
+    system_logs_.push_back(std::move(entry));
     
     // 限制日志数量
     if (system_logs_.size() > MAX_SYSTEM_LOGS) {
         system_logs_.erase(system_logs_.begin());
     }
+    const SystemLogEntry& added = system_logs_.back();
+    system_logs_generation_.store(added.seq);
+    
+    // 在锁内推送，保证推送顺序与序号一致
+    publish_log(to_log_entry(added));
+}
+
+void WebServer::publish_log(const LogEntry& entry) {
+    JsonWriter json(128 + entry.content.size());
+    write_log_entry(json, entry);
+    event_hub_.publish("log", json.str());
+}
+
+void WebServer::publish_player_change(PlayerChange change, const std::string& player, const std::string& detail) {
+    const char* name = "join";
+    switch (change) {
+        case PlayerChange::JOIN:   name = "join"; break;
+        case PlayerChange::LEAVE:  name = "leave"; break;
+        case PlayerChange::BAN:    name = "ban"; break;
+        case PlayerChange::PARDON: name = "pardon"; break;
+    }
+    JsonWriter json;
+    json.begin_object()
+        .field("change", name)
+        .field("player", player)
+        .field("detail", detail)
+        .end_object();
+    event_hub_.publish("player", json.str());
+}
+
+void WebServer::publish_request_change(RequestChange change, const std::string& request_id) {
+    const char* name = "create";
+    switch (change) {
+        case RequestChange::CREATE:  name = "create"; break;
+        case RequestChange::VOTE:    name = "vote"; break;
+        case RequestChange::EXECUTE: name = "execute"; break;
+        case RequestChange::REMOVE:  name = "remove"; break;
+    }
+    JsonWriter json;
+    json.begin_object()
+        .field("change", name)
+        .field("id", request_id)
+        .end_object();
+    event_hub_.publish("request", json.str());
 }
 
 // ============================================================================
@@ -142,293 +358,480 @@ void WebServer::add_system_log(const std::string& message) {
 // ============================================================================
 
 void WebServer::setup_routes() {
-    // 静态文件服务 - 主页
-    server_->Get("/", [this](const httplib::Request&, httplib::Response& res) {
-        std::ifstream file(config_.web_root + "/index.html");
-        if (file) {
-            std::ostringstream oss;
-            oss << file.rdbuf();
-            res.set_content(oss.str(), "text/html; charset=utf-8");
-        } else {
-            res.status = 404;
-            res.set_content("Not Found", "text/plain");
-        }
-    });
-    
-    // 静态文件服务 - CSS/JS
-    server_->Get(R"(/(.+\.(css|js|html|ico)))", [this](const httplib::Request& req, httplib::Response& res) {
-        std::string path = config_.web_root + "/" + req.matches[1].str();
-        std::ifstream file(path, std::ios::binary);
-        if (file) {
-            std::ostringstream oss;
-            oss << file.rdbuf();
-            std::string ext = get_file_extension(path);
-            res.set_content(oss.str(), get_mime_type(ext));
-        } else {
-            res.status = 404;
-            res.set_content("Not Found", "text/plain");
-        }
-    });
-    
-    // 上传文件访问
-    server_->Get(R"(/uploads/(.+))", [this](const httplib::Request& req, httplib::Response& res) {
-        std::string filename = req.matches[1].str();
-        std::string path = config_.upload_dir + "/" + filename;
-        std::ifstream file(path, std::ios::binary);
-        if (file) {
-            std::ostringstream oss;
-            oss << file.rdbuf();
-            std::string ext = get_file_extension(path);
-            res.set_content(oss.str(), get_mime_type(ext));
-        } else {
-            res.status = 404;
-            res.set_content("Not Found", "text/plain");
-        }
-    });
+    // 上传文件访问：交给 httplib 的挂载点处理，文件经 mmap 按需发送，内存占用与文件大小无关；
+    // 同时支持 Range/If-Range 以及基于 ETag(mtime+大小)/Last-Modified 的条件请求，并拒绝 ".." 等非法路径。
+    // 挂载点在路由之前匹配，不存在的文件会落到下面的静态资源路由返回 404
+    // 文件名由申请 ID 生成，内容不会改变，允许浏览器长期缓存
+    if (!server_->set_mount_point("/uploads/", config_.upload_dir,
+                                  {{"Cache-Control", "public, max-age=86400"}})) {
+        log_warn() << "[WebServer] 无法挂载上传目录: " << config_.upload_dir;
+    }
     
     // API 路由
-    server_->Get("/api/logs", [this](const httplib::Request& req, httplib::Response& res) {
-        handle_get_logs(req, res);
-    });
+    server_->Get("/api/logs", timed("GET", "/api/logs", [this](const httplib::Request& req, httplib::Response& res) {
+        handle_get_logs(req, res, default_server_);
+    }));
     
-    server_->Get("/api/online", [this](const httplib::Request& req, httplib::Response& res) {
+    server_->Get("/api/online", timed("GET", "/api/online", [this](const httplib::Request& req, httplib::Response& res) {
         handle_get_online(req, res);
-    });
+    }));
     
-    server_->Get("/api/ops", [this](const httplib::Request& req, httplib::Response& res) {
-        handle_get_ops(req, res);
-    });
+    server_->Get("/api/ops", timed("GET", "/api/ops", [this](const httplib::Request& req, httplib::Response& res) {
+        handle_get_ops(req, res, default_server_);
+    }));
     
-    server_->Get("/api/banned", [this](const httplib::Request& req, httplib::Response& res) {
+    server_->Get("/api/banned", timed("GET", "/api/banned", [this](const httplib::Request& req, httplib::Response& res) {
         handle_get_banned(req, res);
-    });
+    }));
     
-    server_->Get("/api/players", [this](const httplib::Request& req, httplib::Response& res) {
+    server_->Get("/api/players", timed("GET", "/api/players", [this](const httplib::Request& req, httplib::Response& res) {
         handle_get_players(req, res);
-    });
+    }));
     
-    server_->Get("/api/requests", [this](const httplib::Request& req, httplib::Response& res) {
+    server_->Get("/api/requests", timed("GET", "/api/requests", [this](const httplib::Request& req, httplib::Response& res) {
         handle_get_requests(req, res);
-    });
+    }));
     
-    server_->Post("/api/requests", [this](const httplib::Request& req, httplib::Response& res) {
-        handle_post_request(req, res);
-    });
+    server_->Post("/api/requests", timed("POST", "/api/requests", [this](const httplib::Request& req, httplib::Response& res,
+                                          const httplib::ContentReader& content_reader) {
+        handle_post_request(req, res, content_reader);
+    }));
     
-    server_->Post(R"(/api/requests/([^/]+)/vote)", [this](const httplib::Request& req, httplib::Response& res) {
+    server_->Post(R"(/api/requests/([^/]+)/vote)", timed("POST", "/api/requests/:id/vote", [this](const httplib::Request& req, httplib::Response& res) {
         handle_post_vote(req, res);
-    });
+    }));
+    
+    server_->Get("/api/servers", timed("GET", "/api/servers", [this](const httplib::Request& req, httplib::Response& res) {
+        handle_get_servers(req, res);
+    }));
+    
+    server_->Get(R"(/api/servers/([^/]+)/(logs|ops))", timed("GET", "/api/servers/:name", [this](const httplib::Request& req, httplib::Response& res) {
+        handle_get_server(req, res);
+    }));
+    
+    server_->Get("/api/history", timed("GET", "/api/history", [this](const httplib::Request& req, httplib::Response& res) {
+        handle_get_history(req, res);
+    }));
+    
+    server_->Get("/api/stream", timed("GET", "/api/stream", [this](const httplib::Request& req, httplib::Response& res) {
+        handle_get_stream(req, res);
+    }));
+    
+    server_->Get("/metrics", timed("GET", "/metrics", [this](const httplib::Request& req, httplib::Response& res) {
+        handle_get_metrics(req, res);
+    }));
+    
+    // 静态文件服务（内存资源表），必须最后注册，匹配所有其他路由未处理的 GET
+    server_->Get(R"(/(.*))", timed("GET", "static", [this](const httplib::Request& req, httplib::Response& res) {
+        std::string path = req.matches[1].str();
+        auto asset = assets_.find(path.empty() ? "/index.html" : "/" + path);
+        if (!asset) {
+            res.status = 404;
+            res.set_content("Not Found", "text/plain");
+            return;
+        }
+        serve_asset(req, res, asset);
+    }));
     
     // 配置
     server_->set_payload_max_length(1024 * 1024 * 10); // 10MB
+    server_->new_task_queue = [this]() -> httplib::TaskQueue* {
+        return new WorkerPool(config_.worker_threads, config_.max_queued_connections, worker_stats_);
+    };
+    server_->set_keep_alive_max_count(config_.keep_alive_max_count);
+    server_->set_keep_alive_timeout(config_.keep_alive_timeout_sec);
+    server_->set_read_timeout(config_.read_timeout_sec);
+    server_->set_write_timeout(config_.write_timeout_sec);
+    // 响应头与响应体分两次写出，开启 Nagle 时响应体要等客户端延迟确认（约 40ms）才发出
+    server_->set_tcp_nodelay(true);
 }
 
 // ============================================================================
-// API 处理函数
+// 静态资源
 // ============================================================================
 
-void WebServer::handle_get_logs(const httplib::Request&, httplib::Response& res) {
-    std::ostringstream json;
-    json << "{\"logs\":[";
-    
-    bool first = true;
-    
-    // 获取游戏日志
-    if (get_logs_callback_) {
-        auto logs = get_logs_callback_();
-        for (const auto& log : logs) {
-            if (!first) json << ",";
-            first = false;
-            json << "{";
-            json << "\"timestamp\":\"" << escape_json(log.timestamp) << "\",";
-            json << "\"type\":\"" << escape_json(log.type) << "\",";
-            json << "\"player\":\"" << escape_json(log.player) << "\",";
-            json << "\"content\":\"" << escape_json(log.content) << "\"";
-            json << "}";
-        }
+void WebServer::serve_asset(const httplib::Request& req, httplib::Response& res,
+                            const std::shared_ptr<const StaticAsset>& asset) {
+    // 按客户端支持的编码选择最小的预压缩版本，不同编码使用不同的 ETag
+    std::string accept = req.get_header_value("Accept-Encoding");
+    const std::string* body = &asset->identity;
+    std::string etag = asset->etag;
+    const char* encoding = nullptr;
+    if (!asset->brotli.empty() && accepts_encoding(accept, "br")) {
+        body = &asset->brotli;
+        encoding = "br";
+    } else if (!asset->gzip.empty() && accepts_encoding(accept, "gzip")) {
+        body = &asset->gzip;
+        encoding = "gzip";
+    }
+    if (encoding) {
+        etag.insert(etag.size() - 1, std::string("-") + encoding);
     }
     
-    // 获取系统日志
-    {
-        std::lock_guard<std::mutex> lock(system_logs_mutex_);
-        for (const auto& log : system_logs_) {
-            if (!first) json << ",";
-            first = false;
-            json << "{";
-            json << "\"timestamp\":\"" << escape_json(log.timestamp) << "\",";
-            json << "\"type\":\"" << escape_json(log.type) << "\",";
-            json << "\"player\":\"" << escape_json(log.player) << "\",";
-            json << "\"content\":\"" << escape_json(log.content) << "\"";
-            json << "}";
-        }
+    res.set_header("ETag", etag);
+    res.set_header("Cache-Control", asset->cache_control);
+    if (!asset->gzip.empty() || !asset->brotli.empty()) {
+        res.set_header("Vary", "Accept-Encoding");
+    }
+    if (etag_matches(req.get_header_value("If-None-Match"), etag)) {
+        res.status = 304;
+        return;
     }
     
-    json << "]}";
+    if (encoding) {
+        res.set_header("Content-Encoding", encoding);
+    }
+    // 直接从资源表中的内存发送，持有 asset 保证发送期间内容不会因重新加载而释放
+    res.set_content_provider(body->size(), asset->content_type,
+        [asset, body](size_t offset, size_t length, httplib::DataSink& sink) {
+            return sink.write(body->data() + offset, length);
+        });
+}
+
+// ============================================================================
+// 响应缓存
+// ============================================================================
+
+void WebServer::send_cached(const httplib::Request& req, httplib::Response& res,
+                            ResponseCache& cache, uint64_t generation,
+                            const std::function<std::string()>& build) {
+    auto cached = std::atomic_load(&cache.current);
+    if (!cached || cached->generation != generation) {
+        std::lock_guard<std::mutex> lock(cache.build_mutex);
+        cached = std::atomic_load(&cache.current);
+        if (!cached || cached->generation != generation) {
+            auto fresh = std::make_shared<CachedResponse>();
+            fresh->generation = generation;
+            fresh->etag = "\"" + etag_prefix_ + "-" + std::to_string(generation) + "\"";
+            fresh->body = build();
+            cached = fresh;
+            std::atomic_store(&cache.current, cached);
+        }
+    }
     
-    res.set_content(json.str(), "application/json; charset=utf-8");
+    // 要求浏览器每次都带 If-None-Match 重新验证
+    res.set_header("ETag", cached->etag);
+    res.set_header("Cache-Control", "no-cache");
+    if (etag_matches(req.get_header_value("If-None-Match"), cached->etag)) {
+        res.status = 304;
+        return;
+    }
+    res.set_content(cached->body, "application/json; charset=utf-8");
 }
 
-void WebServer::handle_get_online(const httplib::Request&, httplib::Response& res) {
-    auto online = player_list_.list_online_player();
+// ============================================================================
+// API 处理函数
+// ============================================================================
+
+// GET /api/logs[?since=<seq>&system_since=<seq>&limit=<n>]
+// 只返回序号大于 since 的游戏日志和序号大于 system_since 的系统日志，
+// 响应中的 next/system_next 供客户端下次请求使用
+void WebServer::handle_get_logs(const httplib::Request& req, httplib::Response& res, ServerRoute& server) {
+    const ServerEndpoints& endpoints = server.endpoints;
+    uint64_t log_last = endpoints.logs_generation ? endpoints.logs_generation() : 0;
+    uint64_t system_last = system_logs_generation_.load();
     
-    std::ostringstream json;
-    json << "{\"players\":[";
+    auto build = [this, &endpoints, log_last, system_last](uint64_t since, uint64_t system_since, size_t limit) {
+        // 客户端的序号比服务端还新，说明服务端重启过，从头开始返回
+        if (endpoints.logs_generation && since > log_last) since = 0;
+        if (system_since > system_last) system_since = 0;
+        
+        // 游戏日志最多返回最新的 MAX_LOG_RESPONSE 条
+        size_t log_limit = (limit == 0 || limit > MAX_LOG_RESPONSE) ? MAX_LOG_RESPONSE : limit;
+        size_t expected = static_cast<size_t>(std::min<uint64_t>(log_last - std::min(since, log_last), log_limit));
+        
+        // 每条日志约 128 字节，一次预留到位
+        JsonWriter json(64 + (expected + MAX_SYSTEM_LOGS) * 128);
+        json.begin_object().key("logs").begin_array();
+        
+        uint64_t next = log_last;
+        uint64_t system_next = system_last;
+        
+        // 游戏日志，直接从缓存序列化
+        if (endpoints.get_logs) {
+            endpoints.get_logs(since, log_limit, [&json, &next](const LogEntry& log) {
+                write_log_entry(json, log);
+                next = std::max(next, log.seq);
+            });
+        }
+        
+        // 系统日志
+        {
+            std::lock_guard<std::mutex> lock(system_logs_mutex_);
+            auto it = std::upper_bound(system_logs_.begin(), system_logs_.end(), system_since,
+                [](uint64_t seq, const SystemLogEntry& log) { return seq < log.seq; });
+            if (limit != 0 && static_cast<size_t>(system_logs_.end() - it) > limit) {
+                it = system_logs_.end() - limit;
+            }
+            for (; it != system_logs_.end(); ++it) {
+                write_log_entry(json, to_log_entry(*it));
+                system_next = std::max(system_next, it->seq);
+            }
+        }
+        
+        json.end_array()
+            .field("next", next)
+            .field("system_next", system_next)
+            .end_object();
+        
+        return json.take();
+    };
     
-    bool first = true;
-    for (const auto& p : online) {
-        if (!first) json << ",";
-        first = false;
-        json << "{";
-        json << "\"name\":\"" << escape_json(p.name) << "\",";
-        json << "\"client\":\"" << escape_json(p.client_info) << "\"";
-        json << "}";
+    bool incremental = req.has_param("since") || req.has_param("system_since") || req.has_param("limit");
+    if (incremental) {
+        // 增量请求只序列化新增部分，开销与新增日志数成正比，无需缓存
+        uint64_t since = std::strtoull(req.get_param_value("since").c_str(), nullptr, 10);
+        uint64_t system_since = std::strtoull(req.get_param_value("system_since").c_str(), nullptr, 10);
+        size_t limit = std::strtoull(req.get_param_value("limit").c_str(), nullptr, 10);
+        res.set_content(build(since, system_since, limit), "application/json; charset=utf-8");
+        return;
     }
     
-    json << "]}";
-    
-    res.set_content(json.str(), "application/json; charset=utf-8");
+    auto build_all = [&build]() {
+        return build(0, 0, 0);
+    };
+    if (!endpoints.logs_generation) {
+        res.set_content(build_all(), "application/json; charset=utf-8");
+        return;
+    }
+    // 两个序号都只增不减，相加后仍然是任一来源变化就变化
+    send_cached(req, res, server.logs_cache, log_last + system_last, build_all);
 }
 
-void WebServer::handle_get_ops(const httplib::Request&, httplib::Response& res) {
-    std::ostringstream json;
-    json << "{\"ops\":[";
+void WebServer::handle_get_online(const httplib::Request& req, httplib::Response& res) {
+    // 直接读取不可变快照，不加锁也不拷贝；快照版本号即缓存版本号
+    auto online = player_list_.online_snapshot();
     
-    if (get_ops_callback_) {
-        auto ops = get_ops_callback_();
-        bool first = true;
-        for (const auto& op : ops) {
-            if (!first) json << ",";
-            first = false;
-            json << "\"" << escape_json(op) << "\"";
+    auto build = [&online]() {
+        JsonWriter json(32 + online->players.size() * 64);
+        json.begin_object().key("players").begin_array();
+        for (const auto& entry : online->players) {
+            const auto& p = entry.second;
+            json.begin_object()
+                .field("name", p.name)
+                .field("client", p.client_info)
+                .field("server", p.server)
+                .end_object();
         }
-    }
-    
-    json << "]}";
+        json.end_array().end_object();
+        return json.take();
+    };
     
-    res.set_content(json.str(), "application/json; charset=utf-8");
+    send_cached(req, res, online_cache_, online->version, build);
 }
 
-void WebServer::handle_get_banned(const httplib::Request&, httplib::Response& res) {
-    auto banned = player_list_.list_banned_player_info();
-    
-    std::ostringstream json;
-    json << "{\"players\":[";
+void WebServer::handle_get_ops(const httplib::Request& req, httplib::Response& res, ServerRoute& server) {
+    const ServerEndpoints& endpoints = server.endpoints;
+    auto build = [&endpoints]() {
+        std::vector<std::string> ops;
+        if (endpoints.get_ops) {
+            ops = endpoints.get_ops();
+        }
+        
+        JsonWriter json(32 + ops.size() * 24);
+        json.begin_object().key("ops").begin_array();
+        for (const auto& op : ops) {
+            json.value(op);
+        }
+        json.end_array().end_object();
+        return json.take();
+    };
     
-    bool first = true;
-    for (const auto& p : banned) {
-        if (!first) json << ",";
-        first = false;
-        json << "{";
-        json << "\"name\":\"" << escape_json(p.name) << "\",";
-        json << "\"reason\":\"" << escape_json(p.reason) << "\",";
-        json << "\"ban_time\":\"" << escape_json(p.get_ban_time_string()) << "\",";
-        json << "\"unban_time\":\"" << escape_json(p.get_unban_time_string()) << "\",";
-        json << "\"permanent\":" << (p.is_permanent ? "true" : "false");
-        json << "}";
+    if (!endpoints.ops_generation) {
+        res.set_content(build(), "application/json; charset=utf-8");
+        return;
     }
-    
-    json << "]}";
-    
-    res.set_content(json.str(), "application/json; charset=utf-8");
+    send_cached(req, res, server.ops_cache, endpoints.ops_generation(), build);
 }
 
-void WebServer::handle_get_players(const httplib::Request&, httplib::Response& res) {
-    auto players = player_list_.list_player();
-    
-    std::ostringstream json;
-    json << "{\"players\":[";
-    
-    bool first = true;
-    for (const auto& p : players) {
-        if (!first) json << ",";
-        first = false;
-        json << "\"" << escape_json(p) << "\"";
+// GET /api/servers
+void WebServer::handle_get_servers(const httplib::Request&, httplib::Response& res) {
+    JsonWriter json(32 + servers_.size() * 64);
+    json.begin_object().key("servers").begin_array();
+    for (const auto& server : servers_) {
+        const ServerEndpoints& endpoints = server->endpoints;
+        json.begin_object()
+            .field("name", server->name)
+            .field("running", endpoints.is_running ? endpoints.is_running() : false)
+            .field("last_seq", endpoints.logs_generation ? endpoints.logs_generation() : 0)
+            .end_object();
+    }
+    json.end_array().end_object();
+    res.set_content(json.take(), "application/json; charset=utf-8");
+}
+
+// GET /api/servers/<name>/logs 与 /api/servers/<name>/ops，参数与 /api/logs、/api/ops 相同
+void WebServer::handle_get_server(const httplib::Request& req, httplib::Response& res) {
+    std::string name = req.matches[1].str();
+    auto it = std::find_if(servers_.begin(), servers_.end(), [&name](const auto& server) {
+        return server->name == name;
+    });
+    if (it == servers_.end()) {
+        res.status = 404;
+        res.set_content("{\"error\":\"Unknown server\"}", "application/json");
+        return;
+    }
+    if (req.matches[2].str() == "logs") {
+        handle_get_logs(req, res, **it);
+    } else {
+        handle_get_ops(req, res, **it);
     }
+}
+
+void WebServer::handle_get_banned(const httplib::Request& req, httplib::Response& res) {
+    auto banned = player_list_.banned_snapshot();
     
-    json << "]}";
+    auto build = [&banned]() {
+        JsonWriter json(32 + banned->players.size() * 256);
+        json.begin_object().key("players").begin_array();
+        for (const auto& entry : banned->players) {
+            const auto& p = entry.second;
+            json.begin_object()
+                .field("name", p.name)
+                .field("reason", p.reason)
+                .field("ban_time", p.get_ban_time_string())
+                .field("unban_time", p.get_unban_time_string())
+                .field("permanent", p.is_permanent)
+                .end_object();
+        }
+        json.end_array().end_object();
+        return json.take();
+    };
     
-    res.set_content(json.str(), "application/json; charset=utf-8");
+    send_cached(req, res, banned_cache_, banned->version, build);
 }
 
-void WebServer::handle_get_requests(const httplib::Request&, httplib::Response& res) {
-    auto requests = request_manager_.list_requests();
-    size_t threshold = request_manager_.get_threshold();
+void WebServer::handle_get_players(const httplib::Request& req, httplib::Response& res) {
+    auto players = player_list_.player_snapshot();
     
-    std::ostringstream json;
-    json << "{\"threshold\":" << threshold << ",\"requests\":[";
+    auto build = [&players]() {
+        JsonWriter json(32 + (players->base->names.size() + players->recent.size()) * 24);
+        json.begin_object().key("players").begin_array();
+        for (const auto& p : players->base->names) {
+            json.value(p);
+        }
+        for (const auto& p : players->recent) {
+            json.value(p);
+        }
+        json.end_array().end_object();
+        return json.take();
+    };
     
-    bool first = true;
-    for (const auto& r : requests) {
-        if (!first) json << ",";
-        first = false;
-        json << "{";
-        json << "\"id\":\"" << escape_json(r.id) << "\",";
-        json << "\"applicant\":\"" << escape_json(r.applicant) << "\",";
-        json << "\"command\":\"" << escape_json(r.command) << "\",";
-        json << "\"reason\":\"" << escape_json(r.reason) << "\",";
-        json << "\"image\":\"" << escape_json(r.image_path) << "\",";
-        json << "\"votes\":" << r.vote_count() << ",";
-        json << "\"executed\":" << (r.executed ? "true" : "false") << ",";
-        json << "\"created_at\":\"" << escape_json(r.get_created_time_string()) << "\"";
-        json << "}";
-    }
+    send_cached(req, res, players_cache_, players->version, build);
+}
+
+void WebServer::handle_get_requests(const httplib::Request& req, httplib::Response& res) {
+    // 先取版本号再取数据，保证缓存内容不会比版本号旧
+    uint64_t generation = request_manager_.generation();
     
-    json << "]}";
+    auto build = [this]() {
+        size_t threshold = request_manager_.get_threshold();
+        
+        JsonWriter json(4096);
+        json.begin_object()
+            .field("threshold", threshold)
+            .key("requests").begin_array();
+        // 申请已按创建时间排好序，直接在锁内序列化，不复制投票列表
+        request_manager_.visit_requests([&json](const RequestInfo& r) {
+            json.begin_object()
+                .field("id", r.id)
+                .field("applicant", r.applicant)
+                .field("command", r.command)
+                .field("reason", r.reason)
+                .field("image", r.image_path)
+                .field("votes", r.vote_count())
+                .field("executed", r.executed)
+                .field("created_at", r.get_created_time_string())
+                .end_object();
+        });
+        json.end_array().end_object();
+        return json.take();
+    };
     
-    res.set_content(json.str(), "application/json; charset=utf-8");
+    send_cached(req, res, requests_cache_, generation, build);
 }
 
-void WebServer::handle_post_request(const httplib::Request& req, httplib::Response& res) {
+// POST /api/requests
+// 请求体通过 ContentReader 流式读取：图片直接写入上传临时目录中的临时文件，申请创建后重命名到上传目录，
+// 文本字段逐块追加，整个上传过程中内存占用与图片大小无关
+void WebServer::handle_post_request(const httplib::Request& req, httplib::Response& res,
+                                    const httplib::ContentReader& content_reader) {
     std::string applicant, command, reason;
-    std::string image_data;
+    TempUpload image;
     std::string image_ext;
     
     // 检查是否为 multipart/form-data
     if (req.is_multipart_form_data()) {
+        std::unordered_map<std::string, std::string> fields;
+        std::string* current_field = nullptr;
+        bool current_is_image = false;
+        bool ok = content_reader(
+            [&](const httplib::FormData& part) {
+                current_field = nullptr;
+                current_is_image = false;
+                if (part.name == "image" && !part.filename.empty()) {
+                    // 只接收第一张图片
+                    if (image.is_open()) return true;
+                    if (!image.open(request_manager_.get_upload_temp_dir())) return false;
+                    image_ext = image_extension(part.filename, part.content_type);
+                    current_is_image = true;
+                } else if (part.filename.empty()) {
+                    current_field = &fields[part.name];
+                }
+                return true;
+            },
+            [&](const char* data, size_t len) {
+                if (current_is_image) return image.write(data, len);
+                if (current_field) {
+                    if (current_field->size() + len > MAX_FORM_FIELD_SIZE) return false;
+                    current_field->append(data, len);
+                }
+                return true;
+            });
+        if (!ok) {
+            res.status = 400;
+            res.set_content("{\"error\":\"Invalid form data\"}", "application/json");
+            return;
+        }
+        
         // 获取表单字段
-        if (!req.form.has_field("applicant") || !req.form.has_field("command") || !req.form.has_field("reason")) {
+        if (!fields.count("applicant") || !fields.count("command") || !fields.count("reason")) {
             res.status = 400;
             res.set_content("{\"error\":\"Missing required fields\"}", "application/json");
             return;
         }
         
-        applicant = req.form.get_field("applicant");
-        command = req.form.get_field("command");
-        reason = req.form.get_field("reason");
-        
-        // 检查是否有图片
-        if (req.form.has_file("image")) {
-            auto image_file = req.form.get_file("image");
-            if (!image_file.content.empty()) {
-                image_data = image_file.content;
-                image_ext = get_file_extension(image_file.filename);
-                if (image_ext.empty()) {
-                    if (image_file.content_type.find("png") != std::string::npos) {
-                        image_ext = ".png";
-                    } else if (image_file.content_type.find("jpeg") != std::string::npos || 
-                               image_file.content_type.find("jpg") != std::string::npos) {
-                        image_ext = ".jpg";
-                    } else if (image_file.content_type.find("gif") != std::string::npos) {
-                        image_ext = ".gif";
-                    } else {
-                        image_ext = ".png";
-                    }
-                }
-            }
-        }
+        applicant = fields["applicant"];
+        command = fields["command"];
+        reason = fields["reason"];
     } else {
-		std::cout << "[WebServer] 处理普通 POST 请求" << std::endl;
-        // 处理普通 POST 数据
-        if (!req.has_param("applicant")) {
-			std::cout << "[WebServer] 缺少必要字段" << std::endl;
+		log_info() << "[WebServer] 处理普通 POST 请求";
+        // 处理普通 POST 数据（application/x-www-form-urlencoded）
+        std::string body;
+        bool ok = content_reader([&](const char* data, size_t len) {
+            if (body.size() + len > MAX_FORM_FIELD_SIZE * 3) return false;
+            body.append(data, len);
+            return true;
+        });
+        httplib::Params params = req.params;
+        if (ok) {
+            httplib::detail::parse_query_text(body, params);
+        }
+        
+        auto get_param = [&params](const std::string& key) {
+            auto it = params.find(key);
+            return it == params.end() ? std::string() : it->second;
+        };
+        if (!ok || params.find("applicant") == params.end()) {
+			log_info() << "[WebServer] 缺少必要字段";
             res.status = 400;
             res.set_content("{\"error\":\"Missing required fields\"}", "application/json");
             return;
         }
         
-        applicant = req.get_param_value("applicant");
-        command = req.get_param_value("command");
-        reason = req.get_param_value("reason");
+        applicant = get_param("applicant");
+        command = get_param("command");
+        reason = get_param("reason");
     }
     
     // 去除首尾空白
@@ -444,20 +847,22 @@ void WebServer::handle_post_request(const httplib::Request& req, httplib::Respon
     }
     
     // 检查是否需要检讨书
+    bool has_image = image.is_open() && image.size() > 0;
     bool is_self_pardon = CommandRequestManager::is_self_pardon(applicant, command);
-    if (is_self_pardon && image_data.empty()) {
+    if (is_self_pardon && !has_image) {
         res.status = 400;
         res.set_content("{\"error\":\"Self-pardon requires confession image\"}", "application/json");
         return;
     }
     
-    std::string id = request_manager_.create_request(applicant, command, reason, image_data, image_ext);
+    std::string image_path = has_image ? image.release() : "";
+    std::string id = request_manager_.create_request_with_file(applicant, command, reason, image_path, image_ext);
     
-    std::ostringstream json;
-    json << "{\"id\":\"" << escape_json(id) << "\"}";
-    res.set_content(json.str(), "application/json");
+    JsonWriter json(64);
+    json.begin_object().field("id", id).end_object();
+    res.set_content(json.take(), "application/json");
     
-    std::cout << "[WebServer] 新命令申请: " << command << " (申请人: " << applicant << ")" << std::endl;
+    log_info() << "[WebServer] 新命令申请: " << command << " (申请人: " << applicant << ")";
     
     // 添加到系统日志
     add_system_log("新命令申请: " + command + " (申请人: " + applicant + ")");
@@ -467,79 +872,200 @@ void WebServer::handle_post_vote(const httplib::Request& req, httplib::Response&
     std::string request_id = req.matches[1].str();
     std::string ip = get_client_ip(req);
     
+    int retry_after = 0;
+    if (!vote_limiter_.allow(ip, &retry_after)) {
+        res.status = 429;
+        res.set_header("Retry-After", std::to_string(retry_after));
+        res.set_content("{\"success\":false,\"error\":\"Too many requests\"}", "application/json");
+        return;
+    }
+    
     int result = request_manager_.vote(request_id, ip);
     
-    std::ostringstream json;
+    const char* body;
     switch (result) {
         case 0:
-            json << "{\"success\":true,\"message\":\"Vote recorded\"}";
-            std::cout << "[WebServer] 投票成功: " << request_id << " (IP: " << ip << ")" << std::endl;
+            body = "{\"success\":true,\"message\":\"Vote recorded\"}";
+            log_info() << "[WebServer] 投票成功: " << request_id << " (IP: " << ip << ")";
             break;
         case 1:
             res.status = 400;
-            json << "{\"success\":false,\"error\":\"Already voted\"}";
+            body = "{\"success\":false,\"error\":\"Already voted\"}";
             break;
         case 2:
             res.status = 404;
-            json << "{\"success\":false,\"error\":\"Request not found\"}";
+            body = "{\"success\":false,\"error\":\"Request not found\"}";
             break;
         case 3:
             res.status = 400;
-            json << "{\"success\":false,\"error\":\"Request already executed\"}";
+            body = "{\"success\":false,\"error\":\"Request already executed\"}";
             break;
         default:
             res.status = 500;
-            json << "{\"success\":false,\"error\":\"Unknown error\"}";
+            body = "{\"success\":false,\"error\":\"Unknown error\"}";
             break;
     }
     
-    res.set_content(json.str(), "application/json");
+    res.set_content(body, "application/json");
+}
+
+// GET /api/stream: SSE 推送通道
+// 事件: hello（连接建立，客户端应补拉一次增量日志）、log、player、request
+void WebServer::handle_get_stream(const httplib::Request&, httplib::Response& res) {
+    auto subscriber = event_hub_.subscribe("retry: 3000\n" + EventHub::format("hello", "{}"));
+    if (!subscriber) {
+        // 连接数已满，客户端回退到轮询
+        res.status = 503;
+        res.set_content("{\"error\":\"Too many stream clients\"}", "application/json");
+        return;
+    }
+    
+    res.set_header("Cache-Control", "no-cache");
+    res.set_header("X-Accel-Buffering", "no");
+    res.set_chunked_content_provider("text/event-stream",
+        [subscriber](size_t, httplib::DataSink& sink) {
+            std::string payload;
+            if (!subscriber->wait(payload, STREAM_KEEPALIVE)) return false;
+            if (payload.empty()) payload = ": keepalive\n\n";
+            return sink.write(payload.data(), payload.size());
+        },
+        [this, subscriber](bool) {
+            event_hub_.unsubscribe(subscriber);
+        });
+}
+
+// GET /api/history?player=&type=&from=&to=&before=&limit=
+// from/to 为 Unix 秒，before 为上一页最后一条的 seq；结果按 seq 从新到旧，
+// 由归档的分段时间范围与玩家/类型倒排表直接定位，不扫描全部事件
+void WebServer::handle_get_history(const httplib::Request& req, httplib::Response& res) {
+    if (!history_callback_) {
+        res.status = 503;
+        res.set_content("{\"error\":\"History is not available\"}", "application/json");
+        return;
+    }
+    
+    HistoryQuery query;
+    query.player = trim(req.get_param_value("player"));
+    if (req.has_param("type")) {
+        if (!parse_event_kind(req.get_param_value("type"), query.kind)) {
+            res.status = 400;
+            res.set_content("{\"error\":\"Invalid type\"}", "application/json");
+            return;
+        }
+        query.has_kind = true;
+    }
+    if (req.has_param("from")) {
+        query.from = std::chrono::system_clock::from_time_t(
+            std::strtoll(req.get_param_value("from").c_str(), nullptr, 10));
+    }
+    if (req.has_param("to")) {
+        query.to = std::chrono::system_clock::from_time_t(
+            std::strtoll(req.get_param_value("to").c_str(), nullptr, 10));
+    }
+    query.before_seq = std::strtoull(req.get_param_value("before").c_str(), nullptr, 10);
+    if (req.has_param("limit")) {
+        query.limit = std::strtoull(req.get_param_value("limit").c_str(), nullptr, 10);
+    }
+    query.limit = std::min(std::max<size_t>(query.limit, 1), MAX_HISTORY_LIMIT);
+    
+    auto events = history_callback_(query);
+    
+    JsonWriter json(64 + events.size() * 160);
+    json.begin_object().key("events").begin_array();
+    char timestamp[TIME_STRING_LENGTH];
+    for (const auto& event : events) {
+        json.begin_object()
+            .field("seq", event.seq)
+            .field("timestamp", std::string_view(timestamp, format_local_time(event.time, timestamp)))
+            .field("type", event_kind_name(event.kind))
+            .field("player", event.player)
+            .field("content", event.content)
+            .end_object();
+    }
+    json.end_array();
+    // 本页已满时给出下一页的 before，否则为 0 表示没有更多
+    json.field("next_before", events.size() == query.limit ? events.back().seq : 0);
+    json.end_object();
+    
+    res.set_content(json.take(), "application/json; charset=utf-8");
+}
+
+// GET /metrics
+// Prometheus 文本格式，输出全局注册表中的所有指标
+void WebServer::handle_get_metrics(const httplib::Request&, httplib::Response& res) {
+    res.set_header("Cache-Control", "no-store");
+    res.set_content(MetricsRegistry::global().render(), "text/plain; version=0.0.4; charset=utf-8");
+}
+
+httplib::Server::Handler WebServer::timed(const char* method, const char* route, httplib::Server::Handler handler) {
+    Histogram& latency = MetricsRegistry::global().histogram("dreamland_http_request_seconds",
+        "Time spent in HTTP route handlers.", {{"method", method}, {"route", route}});
+    return [&latency, handler = std::move(handler)](const httplib::Request& req, httplib::Response& res) {
+        ScopedTimer timer(latency);
+        handler(req, res);
+    };
+}
+
+httplib::Server::HandlerWithContentReader WebServer::timed(const char* method, const char* route,
+                                                           httplib::Server::HandlerWithContentReader handler) {
+    Histogram& latency = MetricsRegistry::global().histogram("dreamland_http_request_seconds",
+        "Time spent in HTTP route handlers.", {{"method", method}, {"route", route}});
+    return [&latency, handler = std::move(handler)](const httplib::Request& req, httplib::Response& res,
+                                                    const httplib::ContentReader& content_reader) {
+        ScopedTimer timer(latency);
+        handler(req, res, content_reader);
+    };
 }
 
 // ============================================================================
 // 辅助函数
 // ============================================================================
 
-std::string WebServer::get_client_ip(const httplib::Request& req) {
-    // 优先使用 X-Forwarded-For 头（反向代理情况）
-    if (req.has_header("X-Forwarded-For")) {
-        std::string xff = req.get_header_value("X-Forwarded-For");
-        size_t comma = xff.find(',');
-        if (comma != std::string::npos) {
-            return xff.substr(0, comma);
+std::string WebServer::get_client_ip(const httplib::Request& req) const {
+    if (config_.trust_proxy_headers) {
+        // X-Forwarded-For 头（反向代理情况），前面的条目可能是客户端自己带上的，
+        // 只有最后一个是受信任的代理看到的对端地址
+        if (req.has_header("X-Forwarded-For")) {
+            std::string xff = req.get_header_value("X-Forwarded-For");
+            size_t comma = xff.rfind(',');
+            if (comma != std::string::npos) {
+                return trim(xff.substr(comma + 1));
+            }
+            return trim(xff);
+        }
+        
+        // 使用 X-Real-IP 头
+        if (req.has_header("X-Real-IP")) {
+            return req.get_header_value("X-Real-IP");
         }
-        return xff;
-    }
-    
-    // 使用 X-Real-IP 头
-    if (req.has_header("X-Real-IP")) {
-        return req.get_header_value("X-Real-IP");
     }
     
     // 使用远程地址
     return req.remote_addr;
 }
 
-std::string WebServer::escape_json(const std::string& s) {
-    std::ostringstream oss;
-    for (char c : s) {
-        switch (c) {
-            case '"':  oss << "\\\""; break;
-            case '\\': oss << "\\\\"; break;
-            case '\b': oss << "\\b"; break;
-            case '\f': oss << "\\f"; break;
-            case '\n': oss << "\\n"; break;
-            case '\r': oss << "\\r"; break;
-            case '\t': oss << "\\t"; break;
-            default:
-                if ('\x00' <= c && c <= '\x1f') {
-                    oss << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)c;
-                } else {
-                    oss << c;
-                }
-        }
+LogEntry WebServer::to_log_entry(const SystemLogEntry& log) {
+    LogEntry entry;
+    entry.seq = log.seq;
+    entry.time = log.time;
+    entry.type = "system";
+    entry.content = log.message;
+    return entry;
+}
+
+void WebServer::write_log_entry(JsonWriter& json, const LogEntry& log) {
+    char buf[TIME_STRING_LENGTH];
+    std::string_view timestamp(buf, format_local_time(log.time, buf));
+    json.begin_object()
+        .field("seq", log.seq)
+        .field("timestamp", timestamp)
+        .field("type", log.type)
+        .field("player", log.player)
+        .field("content", log.content);
+    if (!log.server.empty()) {
+        json.field("server", log.server);
     }
-    return oss.str();
+    json.end_object();
 }
 
 } // namespace dl
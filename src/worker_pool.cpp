@@ -0,0 +1,75 @@
+#include <worker_pool.h>
+
+namespace dl {
+
+WorkerPool::WorkerPool(size_t threads, size_t max_queued, WorkerPoolStats &stats)
+	: max_queued_(max_queued)
+	, stats_(stats) {
+	if (threads == 0) {
+		threads = 1;
+	}
+	threads_.reserve(threads);
+	for (size_t i = 0; i < threads; i++) {
+		threads_.emplace_back(&WorkerPool::worker_func, this);
+	}
+	stats_.threads = threads;
+}
+
+WorkerPool::~WorkerPool() {
+	shutdown();
+}
+
+bool WorkerPool::enqueue(std::function<void()> fn) {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (shutdown_ || (max_queued_ > 0 && jobs_.size() >= max_queued_)) {
+			stats_.rejected++;
+			return false;
+		}
+		jobs_.push_back(std::move(fn));
+		stats_.queued = jobs_.size();
+	}
+	cv_.notify_one();
+	return true;
+}
+
+void WorkerPool::shutdown() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		shutdown_ = true;
+	}
+	cv_.notify_all();
+	for (auto &thread : threads_) {
+		if (thread.joinable()) {
+			thread.join();
+		}
+	}
+	threads_.clear();
+	stats_.threads = 0;
+}
+
+void WorkerPool::worker_func() {
+	for (;;) {
+		std::function<void()> fn;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			cv_.wait(lock, [this] {
+				return shutdown_ || !jobs_.empty();
+			});
+			if (jobs_.empty()) {
+				return;
+			}
+			fn = std::move(jobs_.front());
+			jobs_.pop_front();
+			stats_.queued = jobs_.size();
+			stats_.active++;
+		}
+
+		fn();
+
+		stats_.active--;
+		stats_.completed++;
+	}
+}
+
+}
@@ -1,6 +1,8 @@
 // 全局状态
 const state = {
     logs: [],
+    logSeq: 0,        // 已获取的最新游戏日志序号
+    systemLogSeq: 0,  // 已获取的最新系统日志序号
     online: [],
     ops: [],
     banned: [],
@@ -12,18 +14,93 @@ const state = {
 // API 基础 URL
 const API_BASE = '/api';
 
+// 本地最多保留的日志条数
+const MAX_LOGS = 1000;
+
 // 初始化
 document.addEventListener('DOMContentLoaded', () => {
     console.log('页面加载完成，开始初始化...');
     initEventListeners();
     loadAllData();
     
-    // 定时刷新
-    setInterval(loadLogs, 2000);
-    setInterval(loadOnline, 5000);
-    setInterval(loadRequests, 3000);
+    // 优先使用服务器推送，不可用时回退到定时刷新
+    connectStream();
 });
 
+// 定时刷新（推送不可用时的回退方案）
+let pollTimers = [];
+
+function startPolling() {
+    if (pollTimers.length > 0) return;
+    pollTimers = [
+        setInterval(loadLogs, 2000),
+        setInterval(loadOnline, 5000),
+        setInterval(loadRequests, 3000)
+    ];
+}
+
+function stopPolling() {
+    pollTimers.forEach(timer => clearInterval(timer));
+    pollTimers = [];
+}
+
+// 连接 /api/stream 推送通道
+function connectStream() {
+    if (!window.EventSource) {
+        startPolling();
+        return;
+    }
+    
+    const source = new EventSource(`${API_BASE}/stream`);
+    // 补拉日志期间收到的推送先暂存，补拉完成后再合并，避免丢失或重复
+    let pending = null;
+    
+    source.addEventListener('hello', async () => {
+        stopPolling();
+        pending = [];
+        await Promise.all([loadLogs(), loadOnline(), loadRequests(), loadBanned()]);
+        const logs = pending;
+        pending = null;
+        appendLogs(logs);
+    });
+    
+    source.addEventListener('log', e => {
+        const log = JSON.parse(e.data);
+        if (pending) {
+            pending.push(log);
+        } else {
+            appendLogs([log]);
+        }
+    });
+    
+    source.addEventListener('player', e => {
+        const data = JSON.parse(e.data);
+        switch (data.change) {
+            case 'join':
+                state.online = state.online.filter(p => p.name !== data.player);
+                state.online.push({ name: data.player, client: data.detail });
+                renderOnline();
+                break;
+            case 'leave':
+                state.online = state.online.filter(p => p.name !== data.player);
+                renderOnline();
+                break;
+            default:
+                loadBanned();
+        }
+    });
+    
+    source.addEventListener('request', () => loadRequests());
+    
+    source.onerror = () => {
+        // 断线期间先轮询，EventSource 会自动重连；连接被拒绝（如连接数已满）时稍后重新尝试
+        startPolling();
+        if (source.readyState === EventSource.CLOSED) {
+            setTimeout(connectStream, 10000);
+        }
+    };
+}
+
 // 事件监听
 function initEventListeners() {
     // 表单提交
@@ -64,18 +141,46 @@ async function loadAllData() {
     ]);
 }
 
-// 加载日志
+// 加载日志（增量：只获取上次之后的新日志）
 async function loadLogs() {
     try {
-        const response = await fetch(`${API_BASE}/logs`);
+        const response = await fetch(`${API_BASE}/logs?since=${state.logSeq}&system_since=${state.systemLogSeq}&limit=${MAX_LOGS}`);
         const data = await response.json();
-        state.logs = data.logs || [];
-        renderLogs();
+        
+        // 服务端重启后序号会变小，丢弃本地日志重新获取
+        if (data.next < state.logSeq || data.system_next < state.systemLogSeq) {
+            state.logs = [];
+            state.logSeq = 0;
+            state.systemLogSeq = 0;
+            return loadLogs();
+        }
+        appendLogs(data.logs || []);
+        state.logSeq = Math.max(state.logSeq, data.next || 0);
+        state.systemLogSeq = Math.max(state.systemLogSeq, data.system_next || 0);
     } catch (error) {
         console.error('加载日志失败:', error);
     }
 }
 
+// 追加新日志，按序号去掉已有的日志
+function appendLogs(logs) {
+    const fresh = logs.filter(log => {
+        if (log.type === 'system') {
+            if (log.seq <= state.systemLogSeq) return false;
+            state.systemLogSeq = log.seq;
+        } else {
+            if (log.seq <= state.logSeq) return false;
+            state.logSeq = log.seq;
+        }
+        return true;
+    });
+    
+    if (fresh.length > 0 || state.logs.length === 0) {
+        state.logs = state.logs.concat(fresh).slice(-MAX_LOGS);
+        renderLogs();
+    }
+}
+
 // 加载在线玩家
 async function loadOnline() {
     try {